@@ -26,18 +26,37 @@
 #endif
 #include <ZW_TransportEndpoint.h>
 #include <ZW_application_transport_interface.h>
-#include <em_core_generic.h>    // CORE_ATOMIC
+#if defined(GPS_ENABLED) && defined(GEOLOC_LIFELINE_REPORTS)
+#include <ZW_TransportMulticast.h>
+#endif
+#ifdef GPS_ENABLED
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
+#if defined(GPS_ENABLED) && defined(GEOLOC_TRACK_LOG)
+#include "TrackLog.h"
+#endif
+#if defined(GPS_ENABLED) && defined(GEOLOC_GPS_POWER)
+#include "GPS_Power.h"
+#endif
+#if defined(GPS_ENABLED) && defined(GEOLOC_ASSIST)
+#include "GPS_Assist.h"
+#endif
 
 // uncomment to enable debugging info
 //#define DEBUGPRINT
 #include "DebugPrint.h"
 #include <string.h>
-
-#include <stdlib.h>
+#include <stddef.h>
 
 #ifndef GPS_ENABLED
+#include <AppTimer.h>
 // NVM structures to hold the GPS coordinates if GPS is NOT present
-static SgpsCoordinates gpsCoords;
+static SgpsCoordinates gpsCoords;       // coordinates of the last SET
+static SgpsCoordinates gpsCoordsStored; // what is in NVM
+static bool gpsCoordsDirty;             // a SET is waiting for geo_nvmTimer
+static SSwTimer geo_nvmTimer;
+static void geo_nvmTimerCallback(SSwTimer *pTimer);
 
 // File handle must be 16 bits (Z-Wave Stack NVM is 0x10000 and up)
 #define FILE_ID_GPS_COORDINATES (4200)
@@ -52,12 +71,162 @@ static uint8_t gps_quality=0;
 //static uint8_t gps_time[]="HH:MM:SS";
 //static uint8_t gps_satelites=0;
 
+/* The fix and the Report frame built from it are published as a double buffered seqlock.
+ * The writer (the parser or a SET) fills the snapshot that is not current then increments geo_seq to make it current.
+ * Readers copy the current snapshot and retry if geo_seq changed meanwhile so they never see half of one fix and half of the next
+ * without disabling interrupts. There is only one writer at a time.
+ */
+typedef struct {
+#ifdef GPS_ENABLED
+    GPS_fix_t fix;
+#endif
+    ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME report; // encoded big-endian ready to send
+} geo_snapshot_t;
+static geo_snapshot_t geo_snapshot[2];
+static uint32_t geo_seq; // geo_snapshot[geo_seq&1] is the current one
+
+/* @brief encode the Report frame of the coordinates into the next snapshot and make it current
+ * the fix is copied in too when GPS_ENABLED
+ */
+static void geo_publish(const void * fix, int32_t lat, int32_t lon, int32_t alt, uint8_t quality) {
+    uint32_t seq = geo_seq;
+    geo_snapshot_t * next = &geo_snapshot[(seq+1)&1];
+#ifdef GPS_ENABLED
+    next->fix = *(const GPS_fix_t *)fix;
+#else
+    (void)fix;
+#endif
+    next->report.cmdClass   = COMMAND_CLASS_GEOGRAPHIC_LOCATION_V2;
+    next->report.cmd        = GEOGRAPHIC_LOCATION_REPORT_V2;
+    next->report.longitude1 = (uint8_t)((lon>>24)&0xFF);
+    next->report.longitude2 = (uint8_t)((lon>>16)&0xFF);
+    next->report.longitude3 = (uint8_t)((lon>>8)&0xFF);
+    next->report.longitude4 = (uint8_t)((lon>>0)&0xFF);
+    next->report.latitude1  = (uint8_t)((lat>>24)&0xFF);
+    next->report.latitude2  = (uint8_t)((lat>>16)&0xFF);
+    next->report.latitude3  = (uint8_t)((lat>>8)&0xFF);
+    next->report.latitude4  = (uint8_t)((lat>>0)&0xFF);
+    next->report.altitude1  = (uint8_t)((alt>>16)&0xFF);
+    next->report.altitude2  = (uint8_t)((alt>>8)&0xFF);
+    next->report.altitude3  = (uint8_t)((alt>>0)&0xFF);
+    next->report.status     = ((quality<<4)|(GEO_READ_ONLY<<3));
+    __atomic_store_n(&geo_seq, seq+1, __ATOMIC_RELEASE); // the snapshot is complete before it becomes current
+}
+
+/* @brief copy len bytes at offset of the current snapshot into dst - tear free without disabling interrupts
+ */
+static void geo_read(void * dst, size_t offset, size_t len) {
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&geo_seq, __ATOMIC_ACQUIRE);
+        memcpy(dst, (const uint8_t *)&geo_snapshot[seq&1] + offset, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq != __atomic_load_n(&geo_seq, __ATOMIC_RELAXED)); // the writer published twice during the copy
+}
+
+#ifdef GPS_ENABLED
+/* @brief copy the current snapshot - returns the age of its fix in seconds at the time it is sent, 0xFFFF if it is not a fix
+ * With GEOLOC_FIX_MAX_AGE_S a fix older than it is reported with Qual=0 - the receiver stopped sending or is asleep.
+ */
+static uint16_t geo_readAged(geo_snapshot_t * snap) {
+    uint32_t age = 0xFFFF; // not a fix - the defaults or a checksum failure
+    geo_read(snap, 0, sizeof(*snap)); // the tick of the fix comes from the same snapshot as the Report
+    if (0!=snap->fix.have) {
+        uint32_t ms = xTaskGetTickCount()*portTICK_PERIOD_MS - snap->fix.tick;
+#ifdef GEOLOC_FIX_MAX_AGE_S
+        if (ms > GEOLOC_FIX_MAX_AGE_S*1000UL) snap->report.status &= 0x0F; // stale
+#endif
+        age = ms/1000;
+        if (age>0xFFFF) age = 0xFFFF;
+    }
+    return((uint16_t)age);
+}
+
+/* @brief the Report of the current coordinates followed by the age and the UTC time of the fix
+ */
+static void GetAgeReport(ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME * frame) {
+    geo_snapshot_t snap;
+    uint16_t age = geo_readAged(&snap);
+    uint32_t utc = ((0==snap.fix.have) || (GPS_UTC_INVALID==snap.fix.utc)) ? 0xFFFFFF : snap.fix.utc/1000; // a checksum failure is not a fix
+    memcpy(frame, &snap.report, sizeof(snap.report)); // the same fields as the Report up to the status
+    frame->cmd   = GEOGRAPHIC_LOCATION_AGE_REPORT_V2;
+    frame->age1  = (uint8_t)(age>>8);
+    frame->age2  = (uint8_t)(age&0xFF);
+    frame->time1 = (uint8_t)((utc>>16)&0xFF);
+    frame->time2 = (uint8_t)((utc>>8)&0xFF);
+    frame->time3 = (uint8_t)((utc>>0)&0xFF);
+}
+#endif
+
+void GetReport(ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME * report) {
+#if defined(GPS_ENABLED) && defined(GEOLOC_FIX_MAX_AGE_S)
+    geo_snapshot_t snap;
+    geo_readAged(&snap); // Qual=0 if the fix is stale
+    *report = snap.report;
+#else
+    geo_read(report, offsetof(geo_snapshot_t, report), sizeof(*report));
+#endif
+}
+
 #ifdef GPS_ENABLED
 // Max length is 255
 #define SENTENCE_BUF_LENGTH 100
 static uint8_t SentenceBufRaw[SENTENCE_BUF_LENGTH]; // holds the GPS sentence for later parsing
 static uint8_t NMEA_index; // index pointer into the buffer
 
+// Field index of the sentence in SentenceBufRaw - filled in by NMEA_build() as each byte arrives
+// Field 0 is the talker+type (GPGGA), field 1 is the first one after the 1st comma and so on.
+#define NMEA_MAX_FIELDS 20
+typedef struct {
+    uint8_t offset; // index in SentenceBufRaw of the first character of the field
+    uint8_t length; // number of characters up to the next , or *
+} NMEA_field_t;
+static NMEA_field_t NMEA_field[NMEA_MAX_FIELDS];
+static uint8_t NMEA_fieldCount; // number of valid entries in NMEA_field
+
+// GGA field numbers
+#define GGA_TIME 1
+#define GGA_LAT  2
+#define GGA_NS   3
+#define GGA_LON  4
+#define GGA_EW   5
+#define GGA_QUAL 6
+#define GGA_SATS 7
+#define GGA_HDOP 8
+#define GGA_ALT  9
+
+// RMC field numbers
+#define RMC_TIME   1
+#define RMC_SPEED  7
+#define RMC_COURSE 8
+#define RMC_DATE   9
+
+// VTG field numbers
+#define VTG_COURSE 1
+#define VTG_KMH    7
+
+// GSA field numbers
+#define GSA_PDOP 15
+#define GSA_HDOP 16
+#define GSA_VDOP 17
+
+static GPS_fix_t gps_fix = {LAT_DEFAULT, LON_DEFAULT, ALT_DEFAULT, GPS_UTC_INVALID}; // last published fix
+static uint32_t gps_fixCount; // number of fixes published
+static uint32_t geo_bootTick;   // ms tick of init()
+static uint32_t geo_ttff;       // ms from init() to the first locked fix - 0 until then
+static GPS_stats_t geo_stats;   // counters since init() - GetStats() fills in the rest
+#ifdef GEOLOC_HOT_START
+static GPS_aid_t geo_aid;       // the last locked fix ...
+static bool geo_aidValid;
+static bool geo_aidDirty;       // ... is not in NVM yet
+static bool geo_aidSaved;       // one has been saved since init()
+static uint32_t geo_aidTick;    // ms tick it was saved at
+#endif
+#ifdef GEOLOC_TRACK_LOG
+static TrackLog_cursor_t geo_batchCursor;   // first logged point not received by the controller
+static TrackLog_cursor_t geo_batchNext;     // first point after the last Batch Report - becomes geo_batchCursor when it is acknowledged
+#endif
+
 //int32_t NMEA_getAltitude(void);
 
 int32_t GetLatitude(void) {
@@ -72,6 +241,105 @@ int32_t GetAltitude(void) {
 int32_t GetStatus(void) {
     return((gps_quality<<4)|(GEO_READ_ONLY<<3));
 }
+void GetFix(GPS_fix_t * fix) {
+    geo_read(fix, offsetof(geo_snapshot_t, fix), sizeof(*fix));
+}
+uint32_t GetFixCount(void) {
+    return(gps_fixCount);
+}
+uint32_t GetTTFF(void) {
+    return(geo_ttff);
+}
+uint32_t GetFixAge(void) {
+    return((0==geo_stats.fixes) ? 0xFFFFFFFF : xTaskGetTickCount()*portTICK_PERIOD_MS - gps_fix.tick);
+}
+void GetStats(GPS_stats_t * stats) {
+    *stats = geo_stats;
+    stats->age = GetFixAge();
+#ifdef GEOLOCCC_INTERFACE_UART
+    EUSART_RxStats_t rx;
+    EUSART_GetRxStats(EUSART1, &rx);
+    stats->busErrors += rx.framing;
+    stats->drops = rx.drops + rx.overruns;
+#endif
+}
+void GPS_StatsBusError(bool nack) {
+    geo_stats.busErrors++;
+    if (nack) geo_stats.nacks++;
+}
+void GPS_StatsChecksumError(void) {
+    geo_stats.checksum++;
+}
+
+static void geo_put32(uint8_t * p, uint32_t v) { // MSB first
+    p[0] = (uint8_t)(v>>24);
+    p[1] = (uint8_t)(v>>16);
+    p[2] = (uint8_t)(v>>8);
+    p[3] = (uint8_t)(v&0xFF);
+}
+
+/* @brief the counters of the parser and the driver - to see what the receiver and the bus are doing in the field
+ */
+static uint8_t GetStatisticsReport(ZW_GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2_FRAME * frame) {
+    GPS_stats_t stats;
+    GetStats(&stats);
+    uint32_t age = stats.age/1000;
+    if (age>0xFFFF) age = 0xFFFF; // none yet or over 18 hours ago
+    frame->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION_V2;
+    frame->cmd      = GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2;
+    geo_put32(&frame->sentences1, stats.sentences);
+    geo_put32(&frame->accepted1, stats.accepted);
+    geo_put32(&frame->rejected1, stats.rejected);
+    geo_put32(&frame->checksum1, stats.checksum);
+    geo_put32(&frame->overruns1, stats.overruns);
+    geo_put32(&frame->fixes1, stats.fixes);
+    geo_put32(&frame->busErrors1, stats.busErrors);
+    geo_put32(&frame->nacks1, stats.nacks);
+    geo_put32(&frame->drops1, stats.drops);
+    frame->age1     = (uint8_t)(age>>8);
+    frame->age2     = (uint8_t)(age&0xFF);
+    return(sizeof(*frame));
+}
+#ifdef GEOLOC_HOT_START
+bool GPS_GetAiding(GPS_aid_t * aid) {
+    if (geo_aidValid) *aid = geo_aid;
+    return(geo_aidValid);
+}
+
+/* @brief save the last locked fix so the receiver can be started hot after a reset
+ */
+static void geo_aidSave(void) {
+    if (!geo_aidDirty) return;
+    zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_GPS_AID, &geo_aid, sizeof(geo_aid));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITENVM %X", tmp);
+        return;
+    }
+    geo_aidDirty = false;
+    geo_aidSaved = true;
+    geo_aidTick = xTaskGetTickCount()*portTICK_PERIOD_MS;
+}
+#endif
+#ifdef GEOLOC_ASSIST
+/* @brief the state of the assistance data transfer - the controller sends the next chunk at the offset
+ */
+static uint8_t GetAssistReport(ZW_GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2_FRAME * frame) {
+    GPS_AssistInfo_t info;
+    GPS_AssistState(&info);
+    frame->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION_V2;
+    frame->cmd      = GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2;
+    frame->status   = info.status;
+    frame->size1    = (uint8_t)(info.size>>8);
+    frame->size2    = (uint8_t)(info.size&0xFF);
+    frame->crc1     = (uint8_t)(info.crc>>8);
+    frame->crc2     = (uint8_t)(info.crc&0xFF);
+    frame->offset1  = (uint8_t)(info.received>>8);
+    frame->offset2  = (uint8_t)(info.received&0xFF);
+    frame->max1     = (uint8_t)(GPS_ASSIST_MAX>>8);
+    frame->max2     = (uint8_t)(GPS_ASSIST_MAX&0xFF);
+    return(sizeof(*frame));
+}
+#endif
 
 #endif
 
@@ -82,41 +350,72 @@ static received_frame_status_t CC_GeographicLoc_handler(
     cc_handler_input_t * input,
     cc_handler_output_t * output)
 {
-    CORE_DECLARE_IRQ_STATE; // save irqstate when in CORE_ATOMIC
-
     switch (input->frame->ZW_Common.cmd)
     {
         case GEOGRAPHIC_LOCATION_GET_V2:
             if (true == Check_not_legal_response_job(input->rx_options)) {   // check for multicast etc.
                 return RECEIVED_FRAME_STATUS_FAIL;
             }
-            // send the report
-            output->frame->ZW_GeographicLocationReportV2Frame.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION_V2;
-            output->frame->ZW_GeographicLocationReportV2Frame.cmd      = GEOGRAPHIC_LOCATION_REPORT_V2;
-#ifdef CORE_ENTER_ATOMIC
-            CORE_ENTER_ATOMIC(); /* prevent values from changing while assembling the frame to avoid corruption */
-#endif
-            output->frame->ZW_GeographicLocationReportV2Frame.longitude1 = (uint8_t)((longitude>>24)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.longitude2 = (uint8_t)((longitude>>16)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.longitude3 = (uint8_t)((longitude>>8)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.longitude4 = (uint8_t)((longitude>>0)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.latitude1  = (uint8_t)((latitude>>24)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.latitude2  = (uint8_t)((latitude>>16)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.latitude3  = (uint8_t)((latitude>>8)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.latitude4  = (uint8_t)((latitude>>0)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.altitude1  = (uint8_t)((altitude>>16)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.altitude2  = (uint8_t)((altitude>>8)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.altitude3  = (uint8_t)((altitude>>0)&0xFF);
-            output->frame->ZW_GeographicLocationReportV2Frame.status    = ((gps_quality<<4)|(GEO_READ_ONLY<<3));
+            // send the report - it was encoded when the coordinates were published so this is just a copy of a consistent snapshot
+            GetReport(&output->frame->ZW_GeographicLocationReportV2Frame);
             output->length = sizeof(ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME); /* triggers the send */
-#ifdef CORE_EXIT_ATOMIC
-            CORE_EXIT_ATOMIC();
+#if defined(GPS_ENABLED) && defined(GEOLOC_GPS_POWER)
+            GPS_PowerDemand(); // this Report may be old if the receiver is asleep - get a fresh fix for the next one
 #endif
 #define GEOLOC_BEEP
 #ifdef GEOLOC_BEEP
             TIMER0->CMD = 0x01; // start BEEP timer to beep each time a GeoLoc Report is sent indicating you are still in range
 #endif
             break;
+#ifdef GPS_ENABLED
+        case GEOGRAPHIC_LOCATION_STATISTICS_GET_V2: // counters of the parser and the driver
+            if (true == Check_not_legal_response_job(input->rx_options)) {   // check for multicast etc.
+                return RECEIVED_FRAME_STATUS_FAIL;
+            }
+            output->length = GetStatisticsReport(&output->frame->ZW_GeographicLocationStatisticsReportV2Frame);
+            break;
+        case GEOGRAPHIC_LOCATION_AGE_GET_V2: // the Report with the age and UTC time of the fix
+            if (true == Check_not_legal_response_job(input->rx_options)) {   // check for multicast etc.
+                return RECEIVED_FRAME_STATUS_FAIL;
+            }
+            GetAgeReport(&output->frame->ZW_GeographicLocationAgeReportV2Frame);
+            output->length = sizeof(ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME);
+#ifdef GEOLOC_GPS_POWER
+            GPS_PowerDemand(); // as for a GET
+#endif
+            break;
+#endif
+#if defined(GPS_ENABLED) && defined(GEOLOC_TRACK_LOG)
+        case GEOGRAPHIC_LOCATION_BATCH_GET_V2: // the logged fixes - the ACK bit says the previous Batch Report was received
+            if (true == Check_not_legal_response_job(input->rx_options)) {   // check for multicast etc.
+                return RECEIVED_FRAME_STATUS_FAIL;
+            }
+            output->length = GetBatchReport(&output->frame->ZW_GeographicLocationBatchReportV2Frame,
+                (input->length > 2) && (input->frame->ZW_GeographicLocationBatchGetV2Frame.properties1 & GEOGRAPHIC_LOCATION_BATCH_GET_PROPERTIES1_ACK_BIT_MASK_V2));
+            break;
+#endif
+#if defined(GPS_ENABLED) && defined(GEOLOC_ASSIST)
+        case GEOGRAPHIC_LOCATION_ASSIST_GET_V2: // where the transfer of the assistance data is up to
+            if (true == Check_not_legal_response_job(input->rx_options)) {   // check for multicast etc.
+                return RECEIVED_FRAME_STATUS_FAIL;
+            }
+            output->length = GetAssistReport(&output->frame->ZW_GeographicLocationAssistReportV2Frame);
+            break;
+        case GEOGRAPHIC_LOCATION_ASSIST_DATA_V2: // a chunk of assistance data - FAIL (Supervision) if it is not the one expected
+            if ((true == Check_not_legal_response_job(input->rx_options)) ||
+                (input->length < offsetof(ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME, data))) {
+                return RECEIVED_FRAME_STATUS_FAIL;
+            }
+            {
+                const ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME * data = &input->frame->ZW_GeographicLocationAssistDataV2Frame;
+                if (!GPS_AssistData(((uint16_t)data->size1<<8) | data->size2, ((uint16_t)data->crc1<<8) | data->crc2,
+                        ((uint16_t)data->offset1<<8) | data->offset2, data->data,
+                        input->length - offsetof(ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME, data))) {
+                    return RECEIVED_FRAME_STATUS_FAIL;
+                }
+            }
+            break;
+#endif
 #ifndef GPS_ENABLED
         case GEOGRAPHIC_LOCATION_SET_V2: // only supported if no GPS present
             if (true == Check_not_legal_response_job(input->rx_options)) {   // check for multicast etc.
@@ -137,12 +436,13 @@ static received_frame_status_t CC_GeographicLoc_handler(
             (int32_t)input->frame->ZW_GeographicLocationReportV2Frame.altitude3<<8;
             altitude = altitude >> 8; // this sign extends the 24 bit number
             gps_quality=0;
+            geo_publish(NULL, latitude, longitude, altitude, gps_quality);
             gpsCoords.latitude = latitude;
             gpsCoords.longitude = longitude;
             gpsCoords.altitude = altitude;
-            zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_GPS_COORDINATES, &gpsCoords, sizeof(gpsCoords));
-            if (ZPAL_STATUS_OK != tmp) {
-                DPRINTF("FAILED TO WRITENVM %X", tmp);
+            if (!gpsCoordsDirty && memcmp(&gpsCoords, &gpsCoordsStored, sizeof(gpsCoords))) { // written when the timer expires - not in the frame handler
+                gpsCoordsDirty = true;
+                TimerStart(&geo_nvmTimer, GEOLOC_NVM_COMMIT_MS);
             }
             break;
 #endif
@@ -157,7 +457,14 @@ static uint8_t lifeline_reporting(ccc_pair_t * p_ccc_pair)
 {
   p_ccc_pair->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
   p_ccc_pair->cmd      = GEOGRAPHIC_LOCATION_REPORT_V2;
+#if defined(GPS_ENABLED) && defined(GEOLOC_LIFELINE_REPORTS) && defined(GEOLOC_TRACK_LOG)
+  p_ccc_pair++;
+  p_ccc_pair->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+  p_ccc_pair->cmd      = GEOGRAPHIC_LOCATION_BATCH_REPORT_V2;
+  return 2;
+#else
   return 1;
+#endif
 }
 
 // called by ZAF_Init() - Anything that needs initialization on reset - pick up values out of NVM or init the hardware interface
@@ -165,8 +472,26 @@ static void init(void)
 {
 #ifdef GPS_ENABLED
   NMEA_Init(SentenceBufRaw); // initialize the pointer to the NMEA buffer which the GPS interface will fill in
+  geo_publish(&gps_fix, latitude, longitude, altitude, gps_quality); // the defaults until the first fix
+  geo_bootTick = xTaskGetTickCount()*portTICK_PERIOD_MS;
+  geo_ttff = 0;
+  memset(&geo_stats, 0, sizeof(geo_stats));
+#ifdef GEOLOC_HOT_START
+  geo_aidValid = (ZPAL_STATUS_OK == ZAF_nvm_app_read(FILE_ID_GPS_AID, &geo_aid, sizeof(geo_aid))) && (LAT_DEFAULT != geo_aid.latitude);
+  geo_aidDirty = false;
+  geo_aidSaved = false;
+#endif
+#ifdef GEOLOC_ASSIST
+  GPS_AssistInit();
+#endif
+#ifdef GEOLOC_TRACK_LOG
+  TrackLog_Init();
+  TrackLog_Open(&geo_batchCursor);
+  geo_batchNext = geo_batchCursor;
+#endif
 #else
     
+    AppTimerRegister(&geo_nvmTimer, false, geo_nvmTimerCallback);
     if (ZPAL_STATUS_OK == ZAF_nvm_app_read(FILE_ID_GPS_COORDINATES, &gpsCoords, sizeof(gpsCoords))) { // pull values out of NVM
     latitude = gpsCoords.latitude;  // assign them to RAM variables
     longitude = gpsCoords.longitude;
@@ -175,25 +500,87 @@ static void init(void)
     latitude = LAT_DEFAULT; // if the NVM has never been written, assign the default values
     longitude = LON_DEFAULT;
     altitude = ALT_DEFAULT;
+    gpsCoords.latitude = latitude;
+    gpsCoords.longitude = longitude;
+    gpsCoords.altitude = altitude;
     }
+    gpsCoordsStored = gpsCoords;
+    gpsCoordsDirty = false;
+    geo_publish(NULL, latitude, longitude, altitude, gps_quality);
 #endif
 }
 
-// called when a factory reset is performed
+// called when a factory reset is performed - the SET goes back to the defaults, the saved fix, the assistance data and the track log are erased
 static void reset(void)
 {
 #ifndef GPS_ENABLED
     gpsCoords.latitude = LAT_DEFAULT;
     gpsCoords.longitude = LON_DEFAULT;
     gpsCoords.altitude = ALT_DEFAULT;
+    gpsCoordsDirty = true;
+    geo_publish(NULL, LAT_DEFAULT, LON_DEFAULT, ALT_DEFAULT, gps_quality);
+    GeoLoc_Flush(); // the defaults are written now - not left to the commit timer
+#else
+#ifdef GEOLOC_HOT_START
+    geo_aid.latitude = LAT_DEFAULT; // an empty file - init() does not take it
+    geo_aidDirty = true;
+    geo_aidSave();
+    geo_aidValid = false;
+    geo_aidSaved = false; // the next locked fix is saved right away
+#endif
+#ifdef GEOLOC_ASSIST
+    GPS_AssistErase();
+#endif
+#ifdef GEOLOC_TRACK_LOG
+    TrackLog_Erase();
+    TrackLog_Open(&geo_batchCursor);
+    geo_batchNext = geo_batchCursor;
+#endif
 #endif
 }
 
+/* @brief write what is waiting for NVM now - the pending SET, the last locked fix, the partial block of the assistance data or of the track log
+ * Called when the commit timer expires and by a factory reset for the SET defaults. Call it before the device goes to sleep (EM4) as RAM is lost.
+ */
+void GeoLoc_Flush(void)
+{
+#ifndef GPS_ENABLED
+    if (!gpsCoordsDirty) return;
+    gpsCoordsDirty = false;
+    if (0==memcmp(&gpsCoords, &gpsCoordsStored, sizeof(gpsCoords))) return; // SET back to the value in NVM
+    zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_GPS_COORDINATES, &gpsCoords, sizeof(gpsCoords));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITENVM %X", tmp);
+        return;
+    }
+    gpsCoordsStored = gpsCoords;
+#else
+#ifdef GEOLOC_HOT_START
+    geo_aidSave();
+#endif
+#ifdef GEOLOC_ASSIST
+    GPS_AssistFlush();
+#endif
+#ifdef GEOLOC_TRACK_LOG
+    TrackLog_Flush();
+#endif
+#endif
+}
+
+#ifndef GPS_ENABLED
+static void geo_nvmTimerCallback(SSwTimer *pTimer)
+{
+    (void)pTimer;
+    GeoLoc_Flush();
+}
+#endif
+
 #ifdef GPS_ENABLED
 
 typedef enum {  // NMEA state machine states
     NMEA_search,
-    NMEA_GNGGA,
+    NMEA_talker,
+    NMEA_type,
     NMEA_fetch,
     NMEA_checksum1,
     NMEA_checksum2,
@@ -201,9 +588,83 @@ typedef enum {  // NMEA state machine states
 } NMEA_state_e;
 
 static uint8_t NMEAState = NMEA_search; // state machine that assembles the Sentance from a UART
+static uint8_t NMEA_sum;    // running XOR of the characters between the $ and *
+static uint8_t NMEA_check;  // checksum digits received after the *
+static bool NMEA_sumOK;     // verdict of the last complete sentence
+
+static void NMEA_decodeGGA(GPS_fix_t * fix);
+#ifdef NMEA_USE_RMC
+ #define NMEA_HAVE_RMC GPS_FIX_HAVE_RMC
+static void NMEA_decodeRMC(GPS_fix_t * fix);
+#else
+ #define NMEA_HAVE_RMC 0
+#endif
+#ifdef NMEA_USE_VTG
+ #define NMEA_HAVE_VTG GPS_FIX_HAVE_VTG
+static void NMEA_decodeVTG(GPS_fix_t * fix);
+#else
+ #define NMEA_HAVE_VTG 0
+#endif
+#ifdef NMEA_USE_GSA
+ #define NMEA_HAVE_GSA GPS_FIX_HAVE_GSA
+static void NMEA_decodeGSA(GPS_fix_t * fix);
+#else
+ #define NMEA_HAVE_GSA 0
+#endif
+
+// The sentence types that are wanted - everything else is dropped as soon as a character of the type does not match
+typedef struct {
+    char type[3];                       // sentence type following the 2 character talker ID
+    uint8_t timeField;                  // field number of the UTC time, 0 if the sentence has no time
+    uint8_t have;                       // GPS_FIX_HAVE_xxx bit for this sentence
+    void (*decode)(GPS_fix_t * fix);    // decodes the fields of the sentence into the epoch fix
+} NMEA_sentence_t;
+
+static const NMEA_sentence_t NMEA_sentences[] = {
+    {{'G','G','A'}, GGA_TIME, GPS_FIX_HAVE_GGA, NMEA_decodeGGA},
+#ifdef NMEA_USE_RMC
+    {{'R','M','C'}, RMC_TIME, GPS_FIX_HAVE_RMC, NMEA_decodeRMC},
+#endif
+#ifdef NMEA_USE_VTG
+    {{'V','T','G'}, 0,        GPS_FIX_HAVE_VTG, NMEA_decodeVTG},
+#endif
+#ifdef NMEA_USE_GSA
+    {{'G','S','A'}, 0,        GPS_FIX_HAVE_GSA, NMEA_decodeGSA},
+#endif
+};
+#define NMEA_SENTENCE_COUNT (sizeof(NMEA_sentences)/sizeof(NMEA_sentences[0]))
+
+// all the sentences of an epoch have arrived when the fix has all of these bits
+#define NMEA_HAVE_ALL (GPS_FIX_HAVE_GGA | NMEA_HAVE_RMC | NMEA_HAVE_VTG | NMEA_HAVE_GSA)
+
+static uint8_t NMEA_candidates; // bit mask of the entries in NMEA_sentences[] whose type still matches the sentence being built
+
+/* @brief start a new sentence - called when the $ is received
+ */
+static void NMEA_start(void) {
+    geo_stats.sentences++;
+    NMEA_index=0;
+    SentenceBufRaw[NMEA_index++]='$';
+    NMEA_sum=0;
+    NMEA_fieldCount=1;
+    NMEA_field[0].offset=1; // talker+type starts just after the $
+    NMEA_candidates=(1<<NMEA_SENTENCE_COUNT)-1;
+    NMEAState=NMEA_talker;
+}
+
+/* @brief return the value of a hex digit or 0xFF if c is not a hex digit
+ */
+static uint8_t hexNibble(char c) {
+    if (c >= '0' && c <='9') return(c - '0');
+    if (c >= 'A' && c <= 'F') return(c - 'A' +10);
+    if (c >= 'a' && c <= 'f') return(c - 'a' +10);
+    return(0xFF);
+}
 
 /* @brief Add the character C to the "sentence" buffer as each byte arrives via a UART or I2C
- * returns true when a complete buffer has been filled otherwise false
+ * returns NMEA_BUILD_OK or NMEA_BUILD_BAD_CHECKSUM when a complete sentence is in the buffer otherwise NMEA_BUILD_BUSY
+ * The checksum is computed and the field table is filled in as each byte arrives so NMEA_parse() does not scan the sentence again.
+ * Sentences not in NMEA_sentences[] are rejected as soon as a character of the type does not match so they cost only a few compares.
  * Typical NMEA sentence: 
  * $GPGGA,121017.00,4310.24176,N,07052.27544,W,1,08,1.10,00048,M,-032,M,,*52
  *       ,TIME     , Latitude   , Longitude   ,Q,SAT,    , Alt   ,       ,Checksum
@@ -218,45 +679,94 @@ static uint8_t NMEAState = NMEA_search; // state machine that assembles the Sent
  * When SAT=0, ignore the rest of the message
  * 
  */
-bool NMEA_build(char c) {
-    bool rtn = false;
+NMEA_build_e NMEA_build(char c) {
+    NMEA_build_e rtn = NMEA_BUILD_BUSY;
+    uint8_t nibble;
 //    if (c<0x20 || c>0x7e) DPRINTF("x%02X",c);
 //    else DPRINTF("%c",c); // print every character from the GPS module for debugging only
     switch(NMEAState) {
         case NMEA_search: // search for the $
             if ('$'==c) {
-                NMEA_index=0;
+                NMEA_start();
+            }
+            break;
+        case NMEA_talker: // 2 character talker ID - GP, GN, GL etc
+            if (c>='A' && c<='Z') {
                 SentenceBufRaw[NMEA_index++]=c;
-                NMEAState=NMEA_GNGGA;
+                NMEA_sum ^= c;
+                if (3==NMEA_index) NMEAState=NMEA_type;
+            } else if ('$'==c) { // resync on a $
+                NMEA_start();
+            } else {
+                geo_stats.rejected++;
+                NMEAState=NMEA_search;
             }
             break;
-        case NMEA_GNGGA: // check for the desired sentence - GPGGA or GNGGA
-            if ('G'==c || 'P'==c || 'N'==c || 'A'==c || ','==c) { 
+        case NMEA_type: // check for the desired sentence types followed by a comma
+            if (NMEA_index<6) {
+                uint8_t match=0;
+                for (uint8_t i=0; i<NMEA_SENTENCE_COUNT; i++) {
+                    if (NMEA_sentences[i].type[NMEA_index-3]==c) match |= 1<<i;
+                }
+                NMEA_candidates &= match;
+            } else if (','!=c) {
+                NMEA_candidates = 0;
+            }
+            if (0!=NMEA_candidates) {
                 SentenceBufRaw[NMEA_index++]=c;
+                NMEA_sum ^= c;
                 if (','==c) {
+                    NMEA_field[0].length = NMEA_index-2;
+                    NMEA_field[NMEA_fieldCount++].offset = NMEA_index;
                     NMEAState=NMEA_fetch;
                 }
+            } else if ('$'==c) {
+                NMEA_start();
             } else { // ignore the other sentences
+                geo_stats.rejected++;
                 NMEAState=NMEA_search;
             }
             break;
         case NMEA_fetch: // collect the sentence to the *
             if (NMEA_index>=SENTENCE_BUF_LENGTH-3) { // don't overrun the buffer
+                geo_stats.overruns++;
                 NMEAState=NMEA_search;
-            } else if ('*'==c) { // start of checksum
-                NMEAState=NMEA_checksum1;
-            } 
+                break;
+            }
             SentenceBufRaw[NMEA_index++]=c;
+            if ('*'==c) { // start of checksum
+                NMEA_field[NMEA_fieldCount-1].length = NMEA_index-1 - NMEA_field[NMEA_fieldCount-1].offset; // if the table is full the last field holds the rest of the sentence
+                NMEAState=NMEA_checksum1;
+            } else {
+                NMEA_sum ^= c;
+                if (','==c && NMEA_fieldCount<NMEA_MAX_FIELDS) {
+                    NMEA_field[NMEA_fieldCount-1].length = NMEA_index-1 - NMEA_field[NMEA_fieldCount-1].offset;
+                    NMEA_field[NMEA_fieldCount++].offset = NMEA_index;
+                }
+            }
             break;
         case NMEA_checksum1: // capture checksum 1st digit
+            nibble = hexNibble(c);
+            NMEA_sumOK = (nibble<0x10);
+            NMEA_check = nibble<<4;
             NMEAState=NMEA_checksum2;
             SentenceBufRaw[NMEA_index++]=c;
             break;
         case NMEA_checksum2: // capture checksum 2nd digit
+            nibble = hexNibble(c);
+            NMEA_check |= nibble;
+            NMEA_sumOK = NMEA_sumOK && (nibble<0x10) && (NMEA_check==NMEA_sum);
             NMEAState=NMEA_search;
             SentenceBufRaw[NMEA_index++]=c;
-        DPRINT("\r\n!");
-            rtn=true;
+            SentenceBufRaw[NMEA_index]='\0'; // NULL the end of the string
+            DPRINTF("\r\n!%s ",SentenceBufRaw); // print out the NMEA Sentence for debugging purposes
+            if (NMEA_sumOK) {
+                geo_stats.accepted++;
+                rtn = NMEA_BUILD_OK;
+            } else {
+                geo_stats.checksum++;
+                rtn = NMEA_BUILD_BAD_CHECKSUM;
+            }
             break;
         default:
             NMEAState=NMEA_search;
@@ -267,214 +777,469 @@ bool NMEA_build(char c) {
 
 /* set values to the invalid value when the gps is not locked
  */
-static void gps_notLocked(void) {
-    gps_quality=0;
-    altitude=ALT_DEFAULT;
-    longitude=LON_DEFAULT;
-    latitude=LAT_DEFAULT;
+static void gps_notLocked(GPS_fix_t * fix) {
+    fix->quality=0;
+    fix->altitude=ALT_DEFAULT;
+    fix->longitude=LON_DEFAULT;
+    fix->latitude=LAT_DEFAULT;
 }
 
-/* @brief convert hex string of up to 8 chars to an integer. Zero if non-hex chars are found.
+/* @brief return TRUE if the checksum of the sentence in the buffer is OK
+ * The checksum is computed by NMEA_build() as each byte arrives so this is just the verdict.
  */
-static uint32_t hextoi(uint8_t * ptr) {
-    uint32_t rtn = 0;
-    for (uint8_t i=0; i<8; i++) {
-        uint8_t c = ptr[i];
-        if ('\0' == c) break; // end of string = done
-        if (c >= '0' && c <='9') c = c - '0';
-        else if (c >= 'A' && c <= 'F') c = c - 'A' +10;
-        else if (c >= 'a' && c <= 'f') c = c - 'a' +10;
-        else { // non hex digit - return 0
-            c=0;
-            rtn=0;
-            break;
-        }
-        rtn = (rtn<<4) | (c &0x0f); // shift in the nibble
-    }
-    return(rtn);
+bool NMEA_checksum(void) {
+    return(NMEA_sumOK);
 }
 
-/* @brief return TRUE if the sentence checksum is OK
+/* @brief return a pointer to field number n of the sentence and its length in len - len=0 if the field is empty or missing
  */
-bool NMEA_checksum(void) {
-    uint32_t i;
-    uint8_t sum=0;
-    for (i=1; ((i<SENTENCE_BUF_LENGTH) && ('*'!=SentenceBufRaw[i])); i++) {
-        sum ^= SentenceBufRaw[i];
-        DPRINTF("%c",SentenceBufRaw[i]); // print out the NMEA Sentence for debugging purposes
+static const uint8_t * NMEA_getField(uint8_t n, uint8_t * len) {
+    if (n>=NMEA_fieldCount) {
+        *len=0;
+        return(&SentenceBufRaw[0]);
     }
-    SentenceBufRaw[i+3]='\0'; // NULL the end of the string
-    int check = hextoi(&SentenceBufRaw[i+1]);
-    //DPRINTF("\nSum=%x, Check=%x ",sum,check);
-    if (check == sum) return(true);
-    else return(false);
+    *len=NMEA_field[n].length;
+    return(&SentenceBufRaw[NMEA_field[n].offset]);
 }
 
-/* @brief parse the NMEA sentence and if checksum is OK, update the GPS coordinates 
+/* @brief convert the decimal number in a field to an integer scaled by 10^scale - "-86.9" with scale=2 returns -8690
+ * Digits past scale are truncated toward zero, the same as the (int32_t) cast of the float value used to give.
+ * Returns def if the field is empty or contains anything other than an optional sign, digits and one decimal point.
  */
-void NMEA_parse(void) {
-    if (NMEA_checksum()) { // checksum is good so compute the coordinates
-        NMEA_getStatus(); // sets the status bits
-        DPRINTF("Sats=%d ",gps_quality);
-        if (gps_quality >=4) {  // need at least 4 satellites to be locked on
-            latitude  = NMEA_getLatitude();
-            longitude = NMEA_getLongitude();
-            altitude  = NMEA_getAltitude();
+static int32_t NMEA_decToInt(const uint8_t * ptr, uint8_t len, uint8_t scale, int32_t def) {
+    int32_t rtn = 0;
+    bool negative = false;
+    bool point = false;
+    uint8_t i = 0;
+    if (len>0 && '-'==ptr[0]) {
+        negative = true;
+        i++;
+    }
+    if (i>=len) return(def);
+    for (; i<len; i++) {
+        uint8_t c = ptr[i];
+        if ('.'==c && !point) {
+            point = true;
+        } else if (c>='0' && c<='9') {
+            if (!point || scale>0) {
+                if (rtn>(INT32_MAX/10)-1) return(def); // too big
+                rtn = rtn*10 + (c-'0');
+                if (point) scale--;
+            }
         } else {
-            gps_notLocked();
+            return(def);
         }
-    } else {
-        gps_notLocked();
-        gps_quality = 1; // debugging value indicating the checksum has failed
     }
+    for (; scale>0; scale--) { // fewer fraction digits than scale
+        if (rtn>(INT32_MAX/10)-1) return(def);
+        rtn *= 10;
+    }
+    return(negative ? -rtn : rtn);
 }
 
-/* @brief search thru the NMEA sentence and return the 32 bit longitude a signed fixed point decimal degress with 23 bits of fraction
- * Returns 0 if errors
+// Number of digits of fractional minutes that are used - more are ignored. 9 digits is 2e-11 degrees which is way below 1 bit of the 23 bit fraction.
+#define NMEA_MAX_FRACTION 9
+
+/* @brief convert a ddmm.mmmm (degDigits=2) or dddmm.mmmm (degDigits=3) field to signed fixed point decimal degrees with 23 bits of fraction
+ * Integer only - no float or double. The result is exactly trunc((degrees + minutes/60) * 2^23) which is bit exact with the previous double math.
+ * Handles any number of fractional minute digits (ZED-F9P sends 7) - only the first NMEA_MAX_FRACTION are used.
+ * Returns def if the field is not well formed or is more than 90 (latitude) or 180 (longitude) degrees.
  */
-int32_t NMEA_getLongitude(void) {
-    int32_t i;
-    int32_t fieldNum = 0;
-    int32_t rtn = 0;
-    int32_t k;
-    double t;
-    char tmp[10];
-    for (i=0;i<SENTENCE_BUF_LENGTH;i++) { // search for the longitude field which is the 2nd one
-        if (','==SentenceBufRaw[i]) {
-            fieldNum++;
-            if (fieldNum==4) {
-                i++;
-                break;
-            }
-        }
+static int32_t NMEA_degToFixed(const uint8_t * ptr, uint8_t len, uint8_t degDigits, bool negative, int32_t def) {
+    uint32_t deg = 0;
+    uint64_t min = 0;   // minutes * 10^frac
+    uint64_t div = 60;  // 60 * 10^frac
+    uint8_t frac = 0;
+    uint8_t i;
+    if (len<degDigits+2) return(def);
+    for (i=0; i<degDigits; i++) {
+        if (ptr[i]<'0' || ptr[i]>'9') return(def);
+        deg = deg*10 + (ptr[i]-'0');
     }
-    if (SENTENCE_BUF_LENGTH<=i) return(LON_DEFAULT); // didn't find the field
-    tmp[0]=SentenceBufRaw[i++];     // first 3 digits are degrees
-    tmp[1]=SentenceBufRaw[i++]; 
-    tmp[2]=SentenceBufRaw[i++]; 
-    tmp[3]='\0';
-    rtn = atoi(tmp); // decimal degrees (0-180)
-    for (k=0;((k+i)<SENTENCE_BUF_LENGTH) && (','!=SentenceBufRaw[k+i]);k++) {
-        tmp[k]=SentenceBufRaw[k+i];     // copy to tmp buffer
+    for (; i<len && '.'!=ptr[i]; i++) { // whole minutes
+        if (ptr[i]<'0' || ptr[i]>'9' || min>=60) return(def);
+        min = min*10 + (ptr[i]-'0');
     }
-    tmp[k+1] = '\0';
-    t = atof(tmp);  // note floating point!
-    t = rtn + (t/(float)60.0); // convert from minutes to degrees
-    if ('W'==SentenceBufRaw[k+i+1]) t=0-t; // West=negative
-    else if ('E'!=SentenceBufRaw[k+i+1]) DPRINTF("Err1=%c", SentenceBufRaw[k+i+1]);
-    //DPRINTF("LON=%f ",t);
-    rtn = t*(1<<23); // convert to a fixed point integer
-    //DPRINTF("hex=%X\r\n",rtn);
-    return(rtn);
+    if (i<len) i++; // skip the decimal point
+    for (; i<len; i++) { // fraction of minutes
+        if (ptr[i]<'0' || ptr[i]>'9') return(def);
+        if (frac<NMEA_MAX_FRACTION) {
+            min = min*10 + (ptr[i]-'0');
+            div *= 10;
+            frac++;
+        }
+    }
+    if (min>=div) return(def); // 60 minutes or more
+    uint32_t maxDeg = (2==degDigits) ? 90 : 180;
+    if ((deg>maxDeg) || ((deg==maxDeg) && (min>0))) return(def); // off the globe - 999 degrees would also overflow the shift
+    int32_t rtn = (int32_t)((deg<<23) + (uint32_t)((min<<23)/div)); // minutes/60 is always <1 degree so it fits in the 23 bit fraction
+    return(negative ? -rtn : rtn);
 }
 
-/* @brief search thru the NMEA sentence and return the 32 bit latitude a signed fixed point decimal degress with 23 bits of fraction
- * Returns 0 if errors
+/* @brief return the 32 bit longitude from the field table as a signed fixed point decimal degress with 23 bits of fraction
+ * Returns LON_DEFAULT if errors
+ */
+int32_t NMEA_getLongitude(void) {
+    const uint8_t * ptr;
+    uint8_t len;
+    uint8_t hemi;
+    ptr = NMEA_getField(GGA_EW, &len);
+    hemi = (len>0) ? ptr[0] : '\0';
+    if ('E'!=hemi && 'W'!=hemi) DPRINTF("Err1=%c", hemi);
+    ptr = NMEA_getField(GGA_LON, &len);
+    return(NMEA_degToFixed(ptr, len, 3, 'W'==hemi, LON_DEFAULT)); // first 3 digits are degrees (0-180), West=negative
+}
+
+/* @brief return the 32 bit latitude from the field table as a signed fixed point decimal degress with 23 bits of fraction
+ * Returns LAT_DEFAULT if errors
  */
 int32_t NMEA_getLatitude(void) {
-    int32_t i;
-    int32_t fieldNum = 0;
-    int32_t rtn = 0;
-    int32_t k;
-    double t;
-    char tmp[10];
-    for (i=0;i<SENTENCE_BUF_LENGTH;i++) { // search for the latitude field which is the 2nd one
-        if (','==SentenceBufRaw[i]) {
-            fieldNum++;
-            if (fieldNum==2) {
-                i++;
-                break;
-            }
-        }
-    }
-    if (SENTENCE_BUF_LENGTH<=i) return(LAT_DEFAULT); // didn't find the field
-    tmp[0]=SentenceBufRaw[i++];     // first 2 digits are degrees
-    tmp[1]=SentenceBufRaw[i++]; 
-    tmp[2]='\0';
-    rtn = atoi(tmp); // decimal degrees (0-90)
-    for (k=0;((k+i)<SENTENCE_BUF_LENGTH) && (','!=SentenceBufRaw[k+i]);k++) {
-        tmp[k]=SentenceBufRaw[k+i];     // copy to tmp buffer
-    }
-    tmp[k+1] = '\0';
-    t = atof(tmp); // float!
-    t = rtn + (t/(float)60.0); // convert from minutes to degrees
-    if ('S'==SentenceBufRaw[k+i+1]) t=0-t; // South=negative
-    else if ('N'!=SentenceBufRaw[k+i+1]) DPRINTF("Err2=%c", SentenceBufRaw[k+i+1]);
-    //DPRINTF("LAT=%f ",t);
-    rtn = t*(1<<23); // convert to a fixed point integer
-    //DPRINTF("hex=%X ",rtn);
-    return(rtn);
+    const uint8_t * ptr;
+    uint8_t len;
+    uint8_t hemi;
+    ptr = NMEA_getField(GGA_NS, &len);
+    hemi = (len>0) ? ptr[0] : '\0';
+    if ('N'!=hemi && 'S'!=hemi) DPRINTF("Err2=%c", hemi);
+    ptr = NMEA_getField(GGA_LAT, &len);
+    return(NMEA_degToFixed(ptr, len, 2, 'S'==hemi, LAT_DEFAULT)); // first 2 digits are degrees (0-90), South=negative
 }
 
-/* @brief search thru the NMEA sentence and return the signed 32 bit altitude in cm
- * Returns 0 if errors
+/* @brief return the signed 32 bit altitude in cm from the field table
+ * Returns ALT_DEFAULT if errors or if it does not fit in 24 bits
  */
 int32_t NMEA_getAltitude(void) {
-    int32_t i;
-    int32_t fieldNum = 0;
-    int32_t rtn = 0;
-    int32_t k;
-    float t;
-    char tmp[10];
-    for (i=0;i<SENTENCE_BUF_LENGTH;i++) { // search for the altitude field which is the 9th one
-        if (','==SentenceBufRaw[i]) {
-            fieldNum++;
-            if (fieldNum==9) { // altitude is the 9th field
-                i++;
-                break;
-            }
-        }
-    }
-    if (SENTENCE_BUF_LENGTH<=i) return(ALT_DEFAULT); // didn't find the Altitude
-    for (k=0;((k+i)<SENTENCE_BUF_LENGTH) && (','!=SentenceBufRaw[k+i]);k++) {
-        tmp[k]=SentenceBufRaw[k+i];     // copy the altitude to tmp buffer
-    }
-    tmp[k+1] = '\0';
-    t = atof(tmp);
-    //DPRINTF("alt=%s = %f \r\n",tmp,t);  // https://community.silabs.com/s/article/floating-point-print-with-gcc?language=en_US required to enable printing of floats (adds 5K of flash!)
-    rtn=(int32_t)(t*100);   // convert to centimeters and return an integer
-    return(rtn);
+    const uint8_t * ptr;
+    uint8_t len;
+    int32_t alt;
+    ptr = NMEA_getField(GGA_ALT, &len);
+    alt = NMEA_decToInt(ptr, len, 2, ALT_DEFAULT); // meters to centimeters
+    if ((alt < -0x7FFFFF) || (alt > 0x7FFFFF)) alt = ALT_DEFAULT; // does not fit in the 24 bits of the Report
+    return(alt);
 } // NMEA_getAltitude
 
-/* @brief search thru the NMEA sentence and return the STATUS byte based on Q and SAT
- * Returns 0 if errors
+/* @brief return the STATUS byte based on Q and SAT from the field table
+ * Qual is zero if the GPS is not locked or there are fewer than 4 satellites
  */
 int32_t NMEA_getStatus(void) {
-    int32_t i;
-    int32_t fieldNum = 0;
-    int32_t rtn = 0;
-    int32_t k;
+    const uint8_t * ptr;
+    uint8_t len;
     int32_t t;
-    char tmp[10];
-    for (i=0;i<SENTENCE_BUF_LENGTH;i++) { // search for the Q field
-        if (','==SentenceBufRaw[i]) {
-            fieldNum++;
-            if (fieldNum==6) {
-                i++;
-                break;
+    ptr = NMEA_getField(GGA_QUAL, &len);
+    if ((0==len) || ('0'==ptr[0])) { // GPS not locked - values are not valid
+        return(GEO_READ_ONLY<<3);
+    }
+    ptr = NMEA_getField(GGA_SATS, &len);
+    t = NMEA_decToInt(ptr, len, 0, 0);
+    if (t>15) t=15; // clip # satellites to the max that fits in the QUAL field
+    //DPRINTF("SAT=%d",t);
+    if (t<4) { // need at least 4 satellites to get accurate readings
+        t=0;
+    }
+    return((t<<4)|(GEO_READ_ONLY<<3));
+} // NMEA_getStatus
+
+/* @brief return the UTC time in field n (hhmmss.sss) in milliseconds since midnight
+ * Returns GPS_UTC_INVALID if the field is empty or not well formed
+ */
+static uint32_t NMEA_getTime(uint8_t n) {
+    const uint8_t * ptr;
+    uint8_t len;
+    uint32_t hms = 0;
+    ptr = NMEA_getField(n, &len);
+    if (len<6) return(GPS_UTC_INVALID);
+    for (uint8_t i=0; i<6; i++) {
+        if (ptr[i]<'0' || ptr[i]>'9') return(GPS_UTC_INVALID);
+        hms = hms*10 + (ptr[i]-'0');
+    }
+    if ((hms/10000>23) || ((hms/100)%100>59) || (hms%100>60)) return(GPS_UTC_INVALID); // 60 seconds is a leap second
+    int32_t ms = (len>6) ? NMEA_decToInt(ptr+6, len-6, 3, -1) : 0; // ".sss" fraction of a second
+    if (ms<0 || ms>999) return(GPS_UTC_INVALID);
+    return(((hms/10000)*3600 + ((hms/100)%100)*60 + (hms%100))*1000 + ms);
+}
+
+/* @brief return field n as an unsigned value scaled by 100 clipped to 16 bits - 0 if the field is empty
+ */
+static uint16_t NMEA_getU16x100(uint8_t n) {
+    const uint8_t * ptr;
+    uint8_t len;
+    ptr = NMEA_getField(n, &len);
+    int32_t t = NMEA_decToInt(ptr, len, 2, 0);
+    if (t<0) t=0;
+    if (t>0xFFFF) t=0xFFFF;
+    return((uint16_t)t);
+}
+
+/* @brief decode all the fields of a GGA sentence out of the field table into fix
+ */
+static void NMEA_decodeGGA(GPS_fix_t * fix) {
+    int32_t status = NMEA_getStatus();
+    fix->quality = status>>4;
+    DPRINTF("Sats=%d ",fix->quality);
+    if (fix->quality >=4) {  // need at least 4 satellites to be locked on
+        fix->latitude  = NMEA_getLatitude();
+        fix->longitude = NMEA_getLongitude();
+        fix->altitude  = NMEA_getAltitude();
+    } else {
+        gps_notLocked(fix);
+    }
+    fix->hdop = NMEA_getU16x100(GGA_HDOP);
+}
+
+#ifdef NMEA_USE_RMC
+/* @brief decode the speed, course and date of a RMC sentence into fix
+ * $GNRMC,083559.00,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A,V*57
+ */
+static void NMEA_decodeRMC(GPS_fix_t * fix) {
+    const uint8_t * ptr;
+    uint8_t len;
+    fix->speed  = ((uint32_t)NMEA_getU16x100(RMC_SPEED)*5144)/10000; // knots*100 to cm/s
+    fix->course = NMEA_getU16x100(RMC_COURSE);
+    ptr = NMEA_getField(RMC_DATE, &len);
+    fix->date   = NMEA_decToInt(ptr, len, 0, 0);
+}
+#endif
+
+#ifdef NMEA_USE_VTG
+/* @brief decode the speed and course of a VTG sentence into fix
+ * $GPVTG,77.52,T,,M,0.004,N,0.008,K,A*06
+ */
+static void NMEA_decodeVTG(GPS_fix_t * fix) {
+    fix->speed  = ((uint32_t)NMEA_getU16x100(VTG_KMH)*10)/36; // km/h*100 to cm/s
+    fix->course = NMEA_getU16x100(VTG_COURSE);
+}
+#endif
+
+#ifdef NMEA_USE_GSA
+/* @brief decode the DOP values of a GSA sentence into fix - the fix is published on the first GSA of the epoch,
+ * the GSAs of the other constellations after it only update NMEA_epoch
+ * $GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47*17
+ */
+static void NMEA_decodeGSA(GPS_fix_t * fix) {
+    fix->pdop = NMEA_getU16x100(GSA_PDOP);
+    fix->hdop = NMEA_getU16x100(GSA_HDOP);
+    fix->vdop = NMEA_getU16x100(GSA_VDOP);
+}
+#endif
+
+static GPS_fix_t NMEA_epoch; // fix being assembled from the sentences of the current epoch
+
+/* @brief parse the NMEA sentence in the buffer and merge it into the fix of the current epoch
+ * Sentences with a UTC time start a new epoch when the time changes or that type was already received in this epoch.
+ * Sentences without a time (VTG, GSA) are merged into the current epoch.
+ * The coordinates are updated once all of the enabled sentences of the epoch have been received.
+ * With only GGA enabled every GGA sentence is published immediately.
+ */
+void NMEA_parse(void) {
+    if (!NMEA_checksum()) { // publish the checksum failure right away
+        gps_notLocked(&gps_fix);
+        gps_fix.quality = 1; // debugging value indicating the checksum has failed
+        gps_fix.have = 0;
+        NMEA_epoch.have = 0;
+    } else {
+        const NMEA_sentence_t * sentence = &NMEA_sentences[0];
+        for (uint8_t i=1; i<NMEA_SENTENCE_COUNT; i++) { // the type matched exactly one entry
+            if (NMEA_candidates & (1<<i)) sentence = &NMEA_sentences[i];
+        }
+        if (0!=sentence->timeField) {
+            uint32_t utc = NMEA_getTime(sentence->timeField);
+            if ((utc!=NMEA_epoch.utc) || (NMEA_epoch.have & sentence->have)) { // start a new epoch
+                memset(&NMEA_epoch, 0, sizeof(NMEA_epoch));
+                NMEA_epoch.utc = utc;
             }
+        } else if (0==NMEA_epoch.have) { // no epoch to merge into
+            return;
         }
+        bool published = ((NMEA_epoch.have & NMEA_HAVE_ALL)==NMEA_HAVE_ALL); // a late duplicate (another GSA) only updates the epoch
+        sentence->decode(&NMEA_epoch);
+        NMEA_epoch.have |= sentence->have;
+        if (published || ((NMEA_epoch.have & NMEA_HAVE_ALL)!=NMEA_HAVE_ALL)) return; // epoch not complete yet
+        gps_fix = NMEA_epoch;
     }
-    if ((i>=SENTENCE_BUF_LENGTH) || ('0'==SentenceBufRaw[i])) { // GPS not locked - values are not valid
-        gps_notLocked();
-    } else {
-        i++; // move to , before the SAT field
-        i++; // move to SAT field
-        for (k=0;((k+i)<SENTENCE_BUF_LENGTH) && (','!=SentenceBufRaw[k+i]);k++) {
-            tmp[k]=SentenceBufRaw[k+i];     // copy SAT to tmp buffer
+    GPS_publish(&gps_fix);
+}
+
+/* @brief add a span of received bytes to the sentence buffer and parse each complete sentence
+ * Used by interfaces that deliver data in blocks (UART LDMA buffers) instead of one byte at a time.
+ */
+void NMEA_feed(const uint8_t * buf, uint16_t len) {
+    for (uint16_t i=0; i<len; i++) {
+        if (NMEA_build(buf[i])) {
+            NMEA_parse();
         }
-        tmp[k+1] = '\0';
-        t = atoi(tmp);
-        if (t>15) t=15; // clip # satellites to the max that fits in the QUAL field
-        gps_quality=t;
-        //DPRINTF("SAT=%s, %d",&tmp[0],gps_quality);
-        if (gps_quality<4) { // need at least 4 satellites to get accurate readings
-            gps_notLocked();
+    }
+}
+
+#ifdef GEOLOC_TRACK_LOG
+static TrackPoint_t geo_batchPts[GEOGRAPHIC_LOCATION_BATCH_DATA_MAX/5]; // an encoded point is at least 5 bytes
+
+/* @brief build a Batch Report of the logged points from the oldest one not received - returns the length of the frame
+ * The points are in the track log encoding - the first in full then the changes - so as many as fit in the frame are sent.
+ * remaining is the number of blocks of the log that still have points after this Report so the controller knows to ask again.
+ * next is set to the first point after the ones sent.
+ */
+static uint8_t geo_batchBuild(ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME * frame, TrackLog_cursor_t * next) {
+    TrackLog_cursor_t cur;
+    TrackPoint_t pt;
+    uint8_t used;
+    cur = geo_batchCursor;
+    uint8_t n = TrackLog_Read(&cur, geo_batchPts, sizeof(geo_batchPts)/sizeof(geo_batchPts[0]));
+    frame->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION_V2;
+    frame->cmd      = GEOGRAPHIC_LOCATION_BATCH_REPORT_V2;
+    frame->count    = TrackLog_Encode(geo_batchPts, n, frame->data, sizeof(frame->data), &used);
+    *next = geo_batchCursor;
+    TrackLog_Read(next, geo_batchPts, frame->count); // move past the points sent
+    cur = *next;
+    uint32_t remaining = 0;
+    if (TrackLog_Read(&cur, &pt, 1) > 0) remaining = TrackLog_Newest() - next->seq + 1;
+    if (remaining > 0xFFFF) remaining = 0xFFFF;
+    frame->remaining1 = (uint8_t)(remaining>>8);
+    frame->remaining2 = (uint8_t)remaining;
+    return(offsetof(ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME, data) + used);
+}
+
+/* @brief the Batch Report for a Batch Get - if ack the points of the previous one were received so this one starts after them
+ */
+uint8_t GetBatchReport(ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME * frame, bool ack) {
+    if (ack) {
+        geo_batchCursor = geo_batchNext;
+        if (geo_batchCursor.seq > 1) TrackLog_Ack(geo_batchCursor.seq-1); // the blocks before it were all received
+    }
+    return(geo_batchBuild(frame, &geo_batchNext));
+}
+#endif
+
+#ifdef GEOLOC_LIFELINE_REPORTS
+// cos(latitude) in Q15 for each whole degree 0-90 - scales a longitude difference to the same length units as latitude
+static const uint16_t geo_cosQ15[91] = {
+    32768, 32763, 32748, 32723, 32688, 32643, 32588, 32524, 32449, 32365,
+    32270, 32166, 32052, 31928, 31795, 31651, 31499, 31336, 31164, 30983,
+    30792, 30592, 30382, 30163, 29935, 29698, 29452, 29197, 28932, 28660,
+    28378, 28088, 27789, 27482, 27166, 26842, 26510, 26170, 25822, 25466,
+    25102, 24730, 24351, 23965, 23571, 23170, 22763, 22348, 21926, 21498,
+    21063, 20622, 20174, 19720, 19261, 18795, 18324, 17847, 17364, 16877,
+    16384, 15886, 15384, 14876, 14365, 13848, 13328, 12803, 12275, 11743,
+    11207, 10668, 10126, 9580, 9032, 8481, 7927, 7371, 6813, 6252,
+    5690, 5126, 4560, 3993, 3425, 2856, 2286, 1715, 1144, 572,
+    0,
+};
+
+// GEOLOC_REPORT_DISTANCE_M in 23 bit fraction degrees of latitude (111320m per degree) - squared for comparing with geo_distance2()
+#define GEO_REPORT_DISTANCE ((((uint64_t)GEOLOC_REPORT_DISTANCE_M)<<23)/111320)
+#define GEO_REPORT_DISTANCE2 (GEO_REPORT_DISTANCE*GEO_REPORT_DISTANCE)
+
+static int32_t geo_rptLat;      // position in the last unsolicited Report
+static int32_t geo_rptLon;
+static bool geo_rptLocked;      // lock state in the last unsolicited Report
+static uint32_t geo_rptTime;    // ms tick of the last unsolicited Report
+static uint8_t geo_moveCount;   // fixes in a row beyond GEOLOC_REPORT_DISTANCE_M
+static uint8_t geo_lockCount;   // fixes in a row with a different lock state
+
+/* @brief squared distance between 2 positions in 23 bit fraction degrees using the equirectangular approximation
+ * Accurate to a few percent for the short distances used for reporting - integer only.
+ */
+static uint64_t geo_distance2(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    int64_t dlat = (int64_t)lat2 - lat1;
+    int64_t dlon = (int64_t)lon2 - lon1;
+    if (dlon > ((int64_t)180<<23)) { // the short way across the date line
+        dlon -= ((int64_t)360<<23);
+    } else if (dlon < -((int64_t)180<<23)) {
+        dlon += ((int64_t)360<<23);
+    }
+    uint32_t deg = (uint32_t)((lat1<0) ? -(int64_t)lat1 : lat1) >> 23;
+    if (deg > 90) deg = 90;
+    dlon = dlon * geo_cosQ15[deg] / 32768;
+    return((uint64_t)(dlat*dlat) + (uint64_t)(dlon*dlon));
+}
+
+#ifdef GEOLOC_TRACK_LOG
+/* @brief send the logged points not received yet to the Lifeline after a Report - the controller then drains the rest with Batch Get
+ * It is not supervised and may be lost so it does not move geo_batchNext - only the points of a Batch Report to a Batch Get are acknowledged.
+ */
+static void geo_lifelineBatch(void) {
+    static ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME frame;
+    static const agi_profile_t lifeline = {ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL, ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL_LIFELINE};
+    static const cc_group_t group = {COMMAND_CLASS_GEOGRAPHIC_LOCATION, GEOGRAPHIC_LOCATION_BATCH_REPORT_V2};
+    TrackLog_cursor_t next;
+    uint8_t len = geo_batchBuild(&frame, &next);
+    if (frame.count > 0) cc_engine_multicast_request(&lifeline, 0, &group, (uint8_t *)&frame, len, false, NULL);
+}
+#endif
+
+/* @brief send the Report to the Lifeline if the position moved, the lock state changed or the heartbeat expired
+ * A move or lock change must last GEOLOC_REPORT_CONFIRM fixes in a row so a single jump of the GPS does not send a Report.
+ * The position is compared with the last Report (not the last fix) so slow movement is still reported.
+ */
+static void geo_lifelineReport(const GPS_fix_t * fix) {
+    static ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME frame;
+    static const agi_profile_t lifeline = {ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL, ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL_LIFELINE};
+    static const cc_group_t group = {COMMAND_CLASS_GEOGRAPHIC_LOCATION, GEOGRAPHIC_LOCATION_REPORT_V2};
+    uint32_t now = xTaskGetTickCount()*portTICK_PERIOD_MS;
+    bool locked = (fix->quality > 1);
+
+    if (locked != geo_rptLocked) {
+        if (geo_lockCount < GEOLOC_REPORT_CONFIRM) geo_lockCount++;
+    } else {
+        geo_lockCount = 0;
+    }
+    if (locked && geo_rptLocked && (geo_distance2(geo_rptLat, geo_rptLon, fix->latitude, fix->longitude) > GEO_REPORT_DISTANCE2)) {
+        if (geo_moveCount < GEOLOC_REPORT_CONFIRM) geo_moveCount++;
+    } else {
+        geo_moveCount = 0;
+    }
+    if ((geo_lockCount >= GEOLOC_REPORT_CONFIRM) || (geo_moveCount >= GEOLOC_REPORT_CONFIRM) || ((now - geo_rptTime) >= GEOLOC_REPORT_HEARTBEAT_S*1000UL)) {
+        GetReport(&frame);
+        if (JOB_STATUS_BUSY != cc_engine_multicast_request(&lifeline, 0, &group, (uint8_t *)&frame, sizeof(frame), false, NULL)) { // try again on the next fix if busy
+            geo_rptLat = fix->latitude;
+            geo_rptLon = fix->longitude;
+            geo_rptLocked = locked;
+            geo_rptTime = now;
+            geo_lockCount = 0;
+            geo_moveCount = 0;
+#ifdef GEOLOC_TRACK_LOG
+            geo_lifelineBatch();
+#endif
         }
-        rtn=((gps_quality<<4)|(GEO_READ_ONLY<<3));
     }
-    return(rtn);
-} // NMEA_getStatus
+}
+#endif
+
+/* @brief make fix the one that is reported - called by NMEA_parse() or by a GPS driver that decodes a binary protocol
+ */
+void GPS_publish(const GPS_fix_t * fix) {
+    uint32_t tick = gps_fix.tick;
+    if (fix != &gps_fix) gps_fix = *fix;
+    if (0!=gps_fix.have) { // checksum failures are not fixes
+        gps_fixCount++;
+        geo_stats.fixes++;
+        tick = xTaskGetTickCount()*portTICK_PERIOD_MS;
+    }
+    gps_fix.tick = tick; // a checksum failure keeps the tick of the last fix for GetFixAge()
+    latitude  = gps_fix.latitude;
+    longitude = gps_fix.longitude;
+    altitude  = gps_fix.altitude;
+    gps_quality = gps_fix.quality;
+    geo_publish(&gps_fix, latitude, longitude, altitude, gps_quality);
+    if ((gps_fix.quality > 1) && (LAT_DEFAULT != gps_fix.latitude)) { // locked
+        uint32_t now = xTaskGetTickCount()*portTICK_PERIOD_MS;
+        if (0==geo_ttff) geo_ttff = (now==geo_bootTick) ? 1 : now - geo_bootTick;
+#ifdef GEOLOC_HOT_START
+        geo_aid.latitude = gps_fix.latitude;
+        geo_aid.longitude = gps_fix.longitude;
+        geo_aid.altitude = gps_fix.altitude;
+        geo_aid.utc = gps_fix.utc;
+        geo_aid.date = gps_fix.date;
+        geo_aidValid = true;
+        geo_aidDirty = true;
+        if (!geo_aidSaved || ((now - geo_aidTick) >= GEOLOC_HOT_START_SAVE_S*1000UL)) geo_aidSave();
+#endif
+    }
+#ifdef GEOLOC_LIFELINE_REPORTS
+    if (0!=gps_fix.have) geo_lifelineReport(&gps_fix); // checksum failures say nothing about the position
+#endif
+#ifdef GEOLOC_TRACK_LOG
+    if (0!=gps_fix.have) TrackLog_Add(&gps_fix);
+#endif
+}
 
 #endif
 
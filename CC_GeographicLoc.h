@@ -7,16 +7,71 @@
 
 #include <ZAF_types.h>
 
-// Choose one of the 2 hardware interfaces below and uncomment ONE line
-//#define GEOLOCCC_INTERFACE_I2C
-//#define GEOLOCCC_INTERFACE_UART
-// Choose the I2C interface by default as it is easier to connect to devkits
-#if !defined GEOLOCCC_INTERFACE_I2C || !defined GEOLOCCC_INTERFACE_UART
+// The GPS receiver - set GEOLOC_GPS_BACKEND to ONE of these (or build with -DGEOLOC_GPS_BACKEND=...) and add GPS_Driver.c and the
+// file of the receiver to the project. GPS_Driver.c calls the functions of the receiver file directly - see GPS_Driver.h.
+#define GEOLOC_GPS_UBLOX_I2C 1  // u-blox SAM-M8Q on I2C (QWIIC) - SAM-M8Q.c
+#define GEOLOC_GPS_MTK_I2C   2  // MTK XA1110 on I2C (QWIIC) - xa1110.c
+#define GEOLOC_GPS_UART      3  // NMEA receiver on EUSART1 - GPS_UART.c and UART_DRZ.c
+#ifndef GEOLOC_GPS_BACKEND
+#ifdef GEOLOCCC_INTERFACE_UART
+#define GEOLOC_GPS_BACKEND GEOLOC_GPS_UART
+#else
+#define GEOLOC_GPS_BACKEND GEOLOC_GPS_UBLOX_I2C // I2C by default as it is easier to connect to devkits
+#endif
+#endif
+// The hardware interface of the receiver
+#if GEOLOC_GPS_BACKEND == GEOLOC_GPS_UART
+#ifndef GEOLOCCC_INTERFACE_UART
+#define GEOLOCCC_INTERFACE_UART
+#endif
+#elif !defined(GEOLOCCC_INTERFACE_I2C)
 #define GEOLOCCC_INTERFACE_I2C
 #endif
+#if defined(GEOLOCCC_INTERFACE_I2C) && defined(GEOLOCCC_INTERFACE_UART)
+#error "GEOLOCCC_INTERFACE_I2C and GEOLOCCC_INTERFACE_UART are both defined - set GEOLOC_GPS_BACKEND to the receiver"
+#endif
 
-// Comment this out if NOT connected to a GPS receiver and only stores the location via SET.
+// Comment this out (or build with -DGEOLOC_NO_GPS) if NOT connected to a GPS receiver and only stores the location via SET.
+#ifndef GEOLOC_NO_GPS
 #define GPS_ENABLED
+#endif
+// A SET is written to NVM this long after it is received - repeated SETs in this window are a single write and unchanged values are not written
+#define GEOLOC_NVM_COMMIT_MS 5000
+
+// NMEA sentences merged into each fix. GGA is always used, uncomment to also collect speed/course (RMC, VTG) and DOP (GSA).
+// A fix is published once every enabled sentence of the same epoch (UTC time) has been received.
+//#define NMEA_USE_RMC
+//#define NMEA_USE_VTG
+//#define NMEA_USE_GSA
+
+// Unsolicited Reports to the Lifeline when the position or the lock state changes - uncomment to send Reports without a GET
+//#define GEOLOC_LIFELINE_REPORTS
+#define GEOLOC_REPORT_DISTANCE_M  50    // send when the position is more than this many meters from the last Report
+#define GEOLOC_REPORT_CONFIRM     3     // number of fixes in a row the move or lock change must last - suppresses GPS jitter
+#define GEOLOC_REPORT_HEARTBEAT_S 3600  // send at least this often while the GPS is sending data
+
+// Log a locked fix every TRACKLOG_INTERVAL_S to NVM so the track is kept while out of range - see TrackLog.h. Add TrackLog.c to the project.
+//#define GEOLOC_TRACK_LOG
+
+// Save the last locked fix to NVM and send it to the receiver after a reset so it starts hot instead of searching the whole sky.
+// The time of the saved fix is not the time now so the time is only sent if the application has a real time source (the Z-Wave Time CC
+// or an RTC running since the save) - define GEOLOC_HOT_START_TIME_ACC_S and provide GPS_GetTime().
+// Without it the u-blox receivers get the position alone and the XA1110 is not aided as PMTK741 needs the time.
+//#define GEOLOC_HOT_START
+#define GEOLOC_HOT_START_SAVE_S     600     // a locked fix is saved at most this often - the first one after a reset right away
+#define GEOLOC_HOT_START_POS_ACC_M  10000   // accuracy claimed for the saved position - the node may have moved since
+//#define GEOLOC_HOT_START_TIME_ACC_S 2     // accuracy claimed for the time from GPS_GetTime()
+
+// Accept assistance data (AssistNow Offline, EPO) from the controller, cache it in NVM and send it to the receiver so it does not have to
+// download the orbits from the sky - see GPS_Assist.h. Add GPS_Assist.c to the project.
+//#define GEOLOC_ASSIST
+
+// A Report of a fix older than this has Qual=0 (no data from the receiver) so the controller does not take a position the node may have left.
+// With GEOLOC_GPS_POWER the receiver sleeps for up to GPS_POWER_INTERVAL_S so a GET in between gets Qual=0. Without it the last fix is reported however old
+//#define GEOLOC_FIX_MAX_AGE_S 10
+
+// Put the I2C receiver to sleep between the fixes the Lifeline heartbeat or the track log need - see GPS_Power.h. Add GPS_Power.c to the project.
+//#define GEOLOC_GPS_POWER
 
 #ifdef GPS_ENABLED
  #define GEO_READ_ONLY 1
@@ -29,10 +84,46 @@
 #define LON_DEFAULT 0x7FFFFFFF
 #define ALT_DEFAULT 0xFF800000
 
+void GetReport(ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME * report); // copy of the Report frame of the current coordinates - never torn
+void GeoLoc_Flush(void); // write what is waiting for NVM now - call before going to sleep
+
 #ifdef GPS_ENABLED
-bool NMEA_build(char c); // add a character to the NEMA Sentence buffer, return TRUE if complete sentence is in buffer
+// GPS_fix_t.have bits - which sentences contributed to the fix
+#define GPS_FIX_HAVE_GGA 0x01
+#define GPS_FIX_HAVE_RMC 0x02
+#define GPS_FIX_HAVE_VTG 0x04
+#define GPS_FIX_HAVE_GSA 0x08
+#define GPS_FIX_HAVE_PVT 0x10   // UBX-NAV-PVT binary message
+
+#define GPS_UTC_INVALID 0xFFFFFFFF
+
+typedef struct GPS_fix  // one decoded GPS fix - all fields come from the sentences of the same epoch
+{
+    int32_t latitude;   // signed fixed point decimal degrees with 23 bits of fraction
+    int32_t longitude;
+    int32_t altitude;   // centimeters above mean sea level
+    uint32_t utc;       // UTC time of the fix in milliseconds since midnight, GPS_UTC_INVALID if unknown
+    uint32_t tick;      // ms tick (xTaskGetTickCount) when GPS_publish() received it - the age of the fix is measured from it
+    uint32_t date;      // UTC date as ddmmyy from RMC or NAV-PVT, 0 if unknown
+    uint16_t speed;     // speed over ground in cm/s from RMC, VTG or NAV-PVT
+    uint16_t course;    // course over ground in 0.01 degrees from RMC, VTG or NAV-PVT
+    uint16_t hdop;      // dilution of precision * 100 - HDOP from GGA, PDOP and VDOP from GSA (PDOP only from NAV-PVT)
+    uint16_t pdop;
+    uint16_t vdop;
+    uint8_t quality;    // satellites in use clipped to 15, 0=not locked, 1=checksum failed
+    uint8_t have;       // GPS_FIX_HAVE_xxx bits
+} GPS_fix_t;
+
+typedef enum {
+    NMEA_BUILD_BUSY = 0,        // sentence is not complete yet
+    NMEA_BUILD_OK,              // complete sentence with a good checksum is in the buffer
+    NMEA_BUILD_BAD_CHECKSUM     // complete sentence is in the buffer but the checksum failed
+} NMEA_build_e;
+
+NMEA_build_e NMEA_build(char c); // add a character to the NEMA Sentence buffer, returns non-zero if a complete sentence is in buffer
 bool NMEA_checksum(void) ; // TRUE if the Sentence Checksum is good
 void NMEA_parse(void);
+void NMEA_feed(const uint8_t * buf, uint16_t len); // NMEA_build() and NMEA_parse() a block of received bytes
 int32_t NMEA_getLongitude(void);
 int32_t NMEA_getLatitude(void);
 int32_t NMEA_getAltitude(void);
@@ -41,6 +132,46 @@ int32_t GetLatitude(void);
 int32_t GetLongitude(void);
 int32_t GetAltitude(void);
 int32_t GetStatus(void);
+void GetFix(GPS_fix_t * fix); // copy of the last published fix
+uint32_t GetFixCount(void); // incremented each time a fix is published
+void GPS_publish(const GPS_fix_t * fix); // update the reported coordinates with a complete fix
+uint32_t GetTTFF(void); // ms from init() to the first locked fix - 0 until then
+uint32_t GetFixAge(void); // ms since the last fix was published - 0xFFFFFFFF if there has been none since init()
+
+typedef struct GPS_stats    // counters since init() - they only count up. Sent in the Statistics Report
+{
+    uint32_t sentences;     // NMEA sentences started (a $ received)
+    uint32_t accepted;      // ... complete with a good checksum and of a type in NMEA_sentences[]
+    uint32_t rejected;      // ... of the other types - dropped by NMEA_build() as soon as the type does not match
+    uint32_t checksum;      // NMEA sentences or UBX messages with a bad checksum
+    uint32_t overruns;      // NMEA sentences longer than the sentence buffer - dropped while collecting the fields
+    uint32_t fixes;         // fixes published - a sentence with a bad checksum is not one
+    uint32_t busErrors;     // I2C transfers that failed (NACKs included) or UART framing errors
+    uint32_t nacks;         // I2C transfers the receiver did not acknowledge - it is booting, asleep or not connected
+    uint32_t drops;         // bytes lost by the UART - RxFIFO full or hardware overrun
+    uint32_t age;           // GetFixAge()
+} GPS_stats_t;
+void GetStats(GPS_stats_t * stats);
+void GPS_StatsBusError(bool nack); // the GPS drivers count each failed transfer
+void GPS_StatsChecksumError(void); // a binary message of the receiver failed its checksum
+#ifdef GEOLOC_HOT_START
+#define FILE_ID_GPS_AID (4202)
+typedef struct GPS_aid  // last locked fix saved in NVM
+{
+    int32_t latitude;   // same units as GPS_fix_t
+    int32_t longitude;
+    int32_t altitude;
+    uint32_t utc;
+    uint32_t date;      // 0 if unknown
+} GPS_aid_t;
+bool GPS_GetAiding(GPS_aid_t * aid); // the fix saved before the reset - false if there is none. The drivers send it to the receiver
+#ifdef GEOLOC_HOT_START_TIME_ACC_S
+bool GPS_GetTime(uint32_t * utc, uint32_t * date); // the UTC now in GPS_fix_t units from the application's time source - false if it is not set
+#endif
+#endif
+#ifdef GEOLOC_TRACK_LOG
+uint8_t GetBatchReport(ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME * frame, bool ack); // logged fixes - returns the frame length
+#endif
 
 void NMEA_Init(uint8_t * ptr); // Initialize the pointer to the NMEA buffer in the specific hardware interface
 
@@ -3,3 +3,12 @@
   ZW_GEOGRAPHIC_LOCATION_GET_V2_FRAME                             ZW_GeographicLocationGetV2Frame;\
   ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME                          ZW_GeographicLocationReportV2Frame;\
   ZW_GEOGRAPHIC_LOCATION_SET_V2_FRAME                             ZW_GeographicLocationSetV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_BATCH_GET_V2_FRAME                       ZW_GeographicLocationBatchGetV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME                    ZW_GeographicLocationBatchReportV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_ASSIST_GET_V2_FRAME                      ZW_GeographicLocationAssistGetV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2_FRAME                   ZW_GeographicLocationAssistReportV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME                     ZW_GeographicLocationAssistDataV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_STATISTICS_GET_V2_FRAME                  ZW_GeographicLocationStatisticsGetV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2_FRAME               ZW_GeographicLocationStatisticsReportV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_AGE_GET_V2_FRAME                         ZW_GeographicLocationAgeGetV2Frame;\
+  ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME                      ZW_GeographicLocationAgeReportV2Frame;\
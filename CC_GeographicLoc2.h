@@ -10,3 +10,17 @@
 #define GEOGRAPHIC_LOCATION_SET_V2 0x01
 #define GEOGRAPHIC_LOCATION_GET_V2 0x02
 #define GEOGRAPHIC_LOCATION_REPORT_V2 0x03
+#define GEOGRAPHIC_LOCATION_BATCH_GET_V2 0x04     /* proposed - logged fixes, see the README */
+#define GEOGRAPHIC_LOCATION_BATCH_REPORT_V2 0x05
+#define GEOGRAPHIC_LOCATION_BATCH_GET_PROPERTIES1_ACK_BIT_MASK_V2 0x01
+#define GEOGRAPHIC_LOCATION_ASSIST_GET_V2 0x06    /* proposed - assistance data for the receiver, see the README */
+#define GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2 0x07
+#define GEOGRAPHIC_LOCATION_ASSIST_DATA_V2 0x08
+#define GEOGRAPHIC_LOCATION_ASSIST_STATUS_EMPTY_V2 0x00      /* no assistance data */
+#define GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2 0x01  /* a transfer is in progress - send the chunk at OFFSET */
+#define GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2 0x02      /* the data is cached and is fed to the receiver */
+#define GEOGRAPHIC_LOCATION_ASSIST_STATUS_ERROR_V2 0x03      /* the last transfer failed the CRC or is not receiver messages - send it again */
+#define GEOGRAPHIC_LOCATION_STATISTICS_GET_V2 0x09    /* proposed - parser and driver counters, see the README */
+#define GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2 0x0A
+#define GEOGRAPHIC_LOCATION_AGE_GET_V2 0x0B           /* proposed - the Report with the age and UTC time of the fix, see the README */
+#define GEOGRAPHIC_LOCATION_AGE_REPORT_V2 0x0C
@@ -53,3 +53,166 @@ typedef struct _ZW_GEOGRAPHIC_LOCATION_SET_V2_FRAME_
     uint8_t   altitude2;
     uint8_t   altitude3; /* LSB */
 } ZW_GEOGRAPHIC_LOCATION_SET_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Batch Get command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_BATCH_GET_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+    uint8_t   properties1; /* bit 0 = the previous Batch Report was received - send the next points */
+} ZW_GEOGRAPHIC_LOCATION_BATCH_GET_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Batch Report command class structs */
+/************************************************************/
+#ifndef GEOGRAPHIC_LOCATION_BATCH_DATA_MAX
+#define GEOGRAPHIC_LOCATION_BATCH_DATA_MAX 41 /* 46 byte frame - the S2 payload of classic Z-Wave, raise it for Long Range */
+#endif
+typedef struct _ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+    uint8_t   count;      /* number of fixes in data */
+    uint8_t   remaining1; /* MSB blocks of the log still to be sent after this one - 0 when this includes the newest fix */
+    uint8_t   remaining2; /* LSB */
+    uint8_t   data[GEOGRAPHIC_LOCATION_BATCH_DATA_MAX]; /* first fix in full then the changes from the previous one - only count fixes are sent */
+} ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Assist Get command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_ASSIST_GET_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+} ZW_GEOGRAPHIC_LOCATION_ASSIST_GET_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Assist Report command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+    uint8_t   status;     /* GEOGRAPHIC_LOCATION_ASSIST_STATUS_xxx_V2 */
+    uint8_t   size1;      /* MSB bytes of the data being received or cached */
+    uint8_t   size2;      /* LSB */
+    uint8_t   crc1;       /* MSB CRC-16 of the data */
+    uint8_t   crc2;       /* LSB */
+    uint8_t   offset1;    /* MSB bytes received - the next chunk starts here */
+    uint8_t   offset2;    /* LSB */
+    uint8_t   max1;       /* MSB largest transfer the node can cache */
+    uint8_t   max2;       /* LSB */
+} ZW_GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Assist Data command class structs */
+/************************************************************/
+#ifndef GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX
+#define GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX 38 /* 46 byte frame - the S2 payload of classic Z-Wave, raise it for Long Range */
+#endif
+typedef struct _ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+    uint8_t   size1;      /* MSB bytes of the whole transfer */
+    uint8_t   size2;      /* LSB */
+    uint8_t   crc1;       /* MSB CRC-16 of the whole transfer - a different SIZE or CRC at OFFSET 0 starts a new one */
+    uint8_t   crc2;       /* LSB */
+    uint8_t   offset1;    /* MSB of the first byte of this chunk */
+    uint8_t   offset2;    /* LSB */
+    uint8_t   data[GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX]; /* the chunk - its length is the rest of the frame */
+} ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Statistics Get command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_STATISTICS_GET_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+} ZW_GEOGRAPHIC_LOCATION_STATISTICS_GET_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Statistics Report command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+    uint8_t   sentences1; /* MSB NMEA sentences started - all the counters are since the reset */
+    uint8_t   sentences2;
+    uint8_t   sentences3;
+    uint8_t   sentences4; /* LSB */
+    uint8_t   accepted1;  /* MSB ... with a good checksum and of a type the parser uses */
+    uint8_t   accepted2;
+    uint8_t   accepted3;
+    uint8_t   accepted4;  /* LSB */
+    uint8_t   rejected1;  /* MSB ... of the other types */
+    uint8_t   rejected2;
+    uint8_t   rejected3;
+    uint8_t   rejected4;  /* LSB */
+    uint8_t   checksum1;  /* MSB NMEA sentences or UBX messages with a bad checksum */
+    uint8_t   checksum2;
+    uint8_t   checksum3;
+    uint8_t   checksum4;  /* LSB */
+    uint8_t   overruns1;  /* MSB NMEA sentences longer than the buffer */
+    uint8_t   overruns2;
+    uint8_t   overruns3;
+    uint8_t   overruns4;  /* LSB */
+    uint8_t   fixes1;     /* MSB fixes published */
+    uint8_t   fixes2;
+    uint8_t   fixes3;
+    uint8_t   fixes4;     /* LSB */
+    uint8_t   busErrors1; /* MSB I2C transfers that failed or UART framing errors */
+    uint8_t   busErrors2;
+    uint8_t   busErrors3;
+    uint8_t   busErrors4; /* LSB */
+    uint8_t   nacks1;     /* MSB I2C transfers not acknowledged */
+    uint8_t   nacks2;
+    uint8_t   nacks3;
+    uint8_t   nacks4;     /* LSB */
+    uint8_t   drops1;     /* MSB bytes lost by the UART */
+    uint8_t   drops2;
+    uint8_t   drops3;
+    uint8_t   drops4;     /* LSB */
+    uint8_t   age1;       /* MSB seconds since the last fix - 0xFFFF if none since the reset or longer ago */
+    uint8_t   age2;       /* LSB */
+} ZW_GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Age Get command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_AGE_GET_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+} ZW_GEOGRAPHIC_LOCATION_AGE_GET_V2_FRAME;
+
+/************************************************************/
+/* Geographic Location Age Report command class structs */
+/************************************************************/
+typedef struct _ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME_
+{
+    uint8_t   cmdClass;                     /* The command class */
+    uint8_t   cmd;                          /* The command */
+    uint8_t   longitude1; /* MSB the fields of the Report up to the status */
+    uint8_t   longitude2;
+    uint8_t   longitude3;
+    uint8_t   longitude4; /* LSB */
+    uint8_t   latitude1;  /* MSB */
+    uint8_t   latitude2;
+    uint8_t   latitude3;
+    uint8_t   latitude4;  /* LSB */
+    uint8_t   altitude1;  /* MSB */
+    uint8_t   altitude2;
+    uint8_t   altitude3;  /* LSB */
+    uint8_t   status;
+    uint8_t   age1;       /* MSB seconds from the fix to this Report, 0xFFFF if there is no fix or it is over 18 hours old */
+    uint8_t   age2;       /* LSB */
+    uint8_t   time1;      /* MSB UTC time of the fix in seconds since midnight, 0xFFFFFF if unknown */
+    uint8_t   time2;
+    uint8_t   time3;      /* LSB */
+} ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME;
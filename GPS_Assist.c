@@ -0,0 +1,272 @@
+/**
+ * @file GPS_Assist.c
+ * @brief Assistance data (AssistNow Offline, EPO) pushed by the controller, cached in NVM and fed to the receiver
+ *
+ * A receiver without current orbits of the satellites has to download them from the sky, 30s or more at a strong signal, which
+ * is most of the on-time of a tracker that sleeps for hours. The node has no internet but the controller does so the controller
+ * sends the receiver's own assistance messages - u-blox UBX-MGA-ANO (AssistNow Offline) or MTK PMTK721 (EPO) sentences -
+ * and the node passes them on to the receiver without looking inside.
+ *  - The controller sends the data in chunks with ASSIST_DATA. Each chunk carries the size and CRC-16 of the whole transfer and its
+ *    offset so there is no session to set up: a chunk at offset 0 with a new size or CRC starts a new transfer and a chunk that is
+ *    not at the next offset is rejected. ASSIST_GET tells the controller where to continue.
+ *  - The chunks are gathered into blocks of GPS_ASSIST_BLOCK_SIZE which are written to NVM when full along with the offset, so a
+ *    transfer cut by a reset or by leaving the range resumes at the last block written. GPS_AssistFlush() writes a partial block.
+ *  - After the last chunk the data is read back from NVM and checked against the CRC and for being whole receiver messages
+ *    (UBX frames or NMEA sentences with good checksums). It is checked again after every reset so a corrupt cache is never sent.
+ *  - The drivers take one message at a time with GPS_AssistSpan() and GPS_AssistConsume() once they have configured the receiver.
+ *    The messages are sent once after each reset and after each new transfer - the receiver keeps them while it sleeps.
+ */
+
+#include "GPS_Assist.h"
+#include <ZAF_types.h>
+#include "DebugPrint.h"
+#include <string.h>
+
+static GPS_AssistInfo_t info;
+static uint16_t infoStored;     // info.received in NVM
+static uint8_t block[GPS_ASSIST_BLOCK_SIZE]; // block being received - or a copy of a cached block while it is VALID
+static int16_t blockCached = -1; // the cached block in block[] - -1 if none
+static uint8_t msg[GPS_ASSIST_MSG_MAX]; // message being sent to the receiver
+static uint16_t msgLen;         // 0 when the next message has to be read
+static uint16_t msgSent;        // bytes of msg already sent
+static uint16_t feedPos;        // offset of msg in the data
+
+/* @brief CRC-16 CCITT (poly 0x1021, MSB first) - the controller computes the same over the whole transfer
+ */
+uint16_t GPS_AssistCRC(uint16_t crc, const uint8_t * data, uint16_t len) {
+    while (len--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (uint8_t i=0; i<8; i++) {
+            crc = (crc & 0x8000) ? (crc<<1) ^ 0x1021 : crc<<1;
+        }
+    }
+    return(crc);
+}
+
+static void infoSave(void) {
+    zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_GPS_ASSIST_INFO, &info, sizeof(info));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITENVM %X", tmp);
+        return;
+    }
+    infoStored = info.received;
+}
+
+static bool blockSave(uint16_t n) {
+    zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_GPS_ASSIST + n, block, sizeof(block));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITENVM %X", tmp);
+        return(false);
+    }
+    return(true);
+}
+
+static bool blockLoad(uint16_t n) {
+    if (blockCached == n) return(true);
+    blockCached = -1;
+    if (ZPAL_STATUS_OK != ZAF_nvm_app_read(FILE_ID_GPS_ASSIST + n, block, sizeof(block))) return(false);
+    blockCached = n;
+    return(true);
+}
+
+/* @brief copy len bytes at offset of the cached data to dst - false if NVM can't be read
+ */
+static bool cacheRead(uint16_t offset, uint8_t * dst, uint16_t len) {
+    while (len > 0) {
+        uint16_t at = offset % GPS_ASSIST_BLOCK_SIZE;
+        uint16_t n = GPS_ASSIST_BLOCK_SIZE - at;
+        if (n > len) n = len;
+        if (!blockLoad(offset / GPS_ASSIST_BLOCK_SIZE)) return(false);
+        memcpy(dst, &block[at], n);
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+    return(true);
+}
+
+static uint8_t hexValue(uint8_t c) {
+    if ((c>='0') && (c<='9')) return(c-'0');
+    if ((c>='A') && (c<='F')) return(c-'A'+10);
+    return(0xFF);
+}
+
+/* @brief read the receiver message at offset of the cached data into msg - returns its length or 0 if it is not
+ * a UBX frame or an NMEA sentence with a good checksum that fits in msg
+ */
+static uint16_t msgRead(uint16_t offset) {
+    uint16_t left = info.size - offset;
+    uint16_t len;
+    if (left > sizeof(msg)) left = sizeof(msg);
+    if ((left < 8) || !cacheRead(offset, msg, left)) return(0); // 8 is the shortest UBX frame
+    if ((0xB5==msg[0]) && (0x62==msg[1])) { // sync, class, id, length (little endian), payload, 8-bit Fletcher checksum
+        uint8_t sumA = 0;
+        uint8_t sumB = 0;
+        len = 8 + (msg[4] | ((uint16_t)msg[5]<<8));
+        if (len > left) return(0);
+        for (uint16_t i=2; i<len-2; i++) {
+            sumA += msg[i];
+            sumB += sumA;
+        }
+        return(((sumA==msg[len-2]) && (sumB==msg[len-1])) ? len : 0);
+    }
+    if ('$'==msg[0]) { // $ ... *hh CR LF
+        uint8_t sum = 0;
+        for (len=1; (len+4<left) && ('*'!=msg[len]); len++) sum ^= msg[len];
+        if (len+4>=left) return(0); // no * or no room for the checksum and CR LF
+        if ((sum!=((hexValue(msg[len+1])<<4) | hexValue(msg[len+2]))) || ('\r'!=msg[len+3]) || ('\n'!=msg[len+4])) return(0);
+        return(len+5);
+    }
+    return(0);
+}
+
+/* @brief the cached data matches the CRC of the transfer and is whole receiver messages
+ */
+static bool cacheCheck(void) {
+    uint16_t crc = GPS_ASSIST_CRC_INIT;
+    uint16_t len;
+    blockCached = -1;
+    for (uint16_t offset=0; offset<info.size; offset+=GPS_ASSIST_BLOCK_SIZE) {
+        len = info.size - offset;
+        if (len > GPS_ASSIST_BLOCK_SIZE) len = GPS_ASSIST_BLOCK_SIZE;
+        if (!blockLoad(offset / GPS_ASSIST_BLOCK_SIZE)) return(false);
+        crc = GPS_AssistCRC(crc, block, len);
+    }
+    if (crc!=info.crc) return(false);
+    for (uint16_t offset=0; offset<info.size; offset+=len) {
+        len = msgRead(offset);
+        if (0==len) return(false);
+    }
+    return(true);
+}
+
+/* @brief called by init() - read the state of the transfer and check the cached data
+ * A partial transfer continues where it was written up to and valid data is fed to the receiver again.
+ */
+void GPS_AssistInit(void) {
+    blockCached = -1;
+    GPS_AssistRewind();
+    if ((ZPAL_STATUS_OK != ZAF_nvm_app_read(FILE_ID_GPS_ASSIST_INFO, &info, sizeof(info))) ||
+        (info.size > GPS_ASSIST_MAX) || (info.received > info.size)) {
+        memset(&info, 0, sizeof(info));
+    }
+    infoStored = info.received;
+    if (GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2==info.status) {
+        if (!cacheCheck()) { // the flash lost it - the controller sends it again
+            DPRINT("assistance data corrupt\r\n");
+            info.status = GEOGRAPHIC_LOCATION_ASSIST_STATUS_ERROR_V2;
+            info.received = 0;
+            infoSave();
+        }
+    } else if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2==info.status) && (info.received % GPS_ASSIST_BLOCK_SIZE)) {
+        // the partial block written by GPS_AssistFlush()
+        if (ZPAL_STATUS_OK != ZAF_nvm_app_read(FILE_ID_GPS_ASSIST + info.received/GPS_ASSIST_BLOCK_SIZE, block, sizeof(block))) {
+            info.received -= info.received % GPS_ASSIST_BLOCK_SIZE;
+        }
+    }
+}
+
+/* @brief a chunk of len bytes at offset of a transfer of size bytes with the CRC-16 crc
+ * Returns false if it was not the chunk expected or could not be written - ASSIST_GET has the offset to send next.
+ */
+bool GPS_AssistData(uint16_t size, uint16_t crc, uint16_t offset, const uint8_t * data, uint8_t len) {
+    if ((0==size) || (size>GPS_ASSIST_MAX)) return(false); // too big to cache
+    if ((size!=info.size) || (crc!=info.crc) ||
+        ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2!=info.status) && (GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=info.status))) {
+        if (0!=offset) return(false); // a new transfer starts at the beginning
+        info.size = size;
+        info.crc = crc;
+        info.received = 0;
+        info.status = GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2;
+        blockCached = -1; // block[] is the block being received from now on
+        GPS_AssistRewind();
+        infoSave(); // the old data is gone as soon as its first block is overwritten
+    } else if (GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2==info.status) {
+        return(true); // a repeat of a chunk of the data already cached
+    }
+    if ((offset!=info.received) || (len > size-offset)) return(false);
+    while (len > 0) {
+        uint16_t at = info.received % GPS_ASSIST_BLOCK_SIZE;
+        uint16_t n = GPS_ASSIST_BLOCK_SIZE - at;
+        if (n > len) n = len;
+        memcpy(&block[at], data, n);
+        data += n;
+        len -= n;
+        info.received += n;
+        if (0==(info.received % GPS_ASSIST_BLOCK_SIZE)) { // full - write it with the offset so a reset resumes after it
+            if (!blockSave(info.received/GPS_ASSIST_BLOCK_SIZE - 1)) {
+                info.received -= GPS_ASSIST_BLOCK_SIZE;
+                return(false);
+            }
+            if (info.received<size) infoSave();
+        }
+    }
+    if (info.received==size) { // the last chunk - check what was written
+        if ((info.received % GPS_ASSIST_BLOCK_SIZE) && !blockSave(info.received/GPS_ASSIST_BLOCK_SIZE)) {
+            info.received -= info.received % GPS_ASSIST_BLOCK_SIZE;
+            return(false);
+        }
+        if (cacheCheck()) {
+            info.status = GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2;
+        } else {
+            DPRINT("assistance data failed the check\r\n");
+            info.status = GEOGRAPHIC_LOCATION_ASSIST_STATUS_ERROR_V2;
+            info.received = 0;
+        }
+        GPS_AssistRewind();
+        infoSave();
+    }
+    return(true);
+}
+
+/* @brief write the partial block of a transfer - called by GeoLoc_Flush() before the node sleeps
+ */
+void GPS_AssistFlush(void) {
+    if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2!=info.status) || (info.received==infoStored)) return;
+    if ((info.received % GPS_ASSIST_BLOCK_SIZE) && !blockSave(info.received/GPS_ASSIST_BLOCK_SIZE)) return;
+    infoSave();
+}
+
+void GPS_AssistState(GPS_AssistInfo_t * state) {
+    *state = info;
+}
+
+/* @brief the rest of the next message for the receiver - returns the number of bytes at *data, 0 when there is nothing to send
+ */
+uint16_t GPS_AssistSpan(const uint8_t ** data) {
+    if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=info.status) || (feedPos>=info.size)) return(0);
+    if (0==msgLen) {
+        msgLen = msgRead(feedPos);
+        msgSent = 0;
+        if (0==msgLen) { // NVM can't be read - try again after the next reset
+            feedPos = info.size;
+            return(0);
+        }
+    }
+    *data = &msg[msgSent];
+    return(msgLen - msgSent);
+}
+
+void GPS_AssistConsume(uint16_t len) {
+    msgSent += len;
+    if (msgSent >= msgLen) {
+        feedPos += msgLen;
+        msgLen = 0;
+        msgSent = 0;
+    }
+}
+
+void GPS_AssistRewind(void) {
+    feedPos = 0;
+    msgLen = 0;
+    msgSent = 0;
+}
+
+/* @brief forget the cached data and the transfer in progress - a factory reset. The blocks stay in NVM but nothing points to them
+ */
+void GPS_AssistErase(void) {
+    memset(&info, 0, sizeof(info)); // GEOGRAPHIC_LOCATION_ASSIST_STATUS_EMPTY_V2
+    blockCached = -1;
+    GPS_AssistRewind();
+    infoSave();
+}
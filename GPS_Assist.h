@@ -0,0 +1,47 @@
+/**
+ * @file GPS_Assist.h
+ * @brief Assistance data (AssistNow Offline, EPO) pushed by the controller, cached in NVM and fed to the receiver
+ */
+
+#ifndef GPS_ASSIST_H_
+#define GPS_ASSIST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "CC_GeographicLoc.h"
+
+// Number of NVM files the data is cached in - the largest transfer is GPS_ASSIST_BLOCKS*GPS_ASSIST_BLOCK_SIZE bytes
+#ifndef GPS_ASSIST_BLOCKS
+#define GPS_ASSIST_BLOCKS 32
+#endif
+#define GPS_ASSIST_BLOCK_SIZE 128
+#define GPS_ASSIST_MAX (GPS_ASSIST_BLOCKS*GPS_ASSIST_BLOCK_SIZE)
+// Longest message in the data - a UBX-MGA-ANO is 84 bytes, a PMTK721 sentence of EPO data about 180
+#define GPS_ASSIST_MSG_MAX 192
+// Bytes sent to the receiver per poll so its input buffer keeps up
+#define GPS_ASSIST_FEED_MAX 256
+
+// NVM file IDs - block n of the data is in FILE_ID_GPS_ASSIST+n
+#define FILE_ID_GPS_ASSIST_INFO (4203)
+#define FILE_ID_GPS_ASSIST      (4400)
+
+typedef struct GPS_AssistInfo   // state of the transfer - the NVM file FILE_ID_GPS_ASSIST_INFO
+{
+    uint16_t size;      // bytes of the data being received or cached
+    uint16_t crc;       // CRC-16 of all of them sent by the controller
+    uint16_t received;  // bytes in NVM - the next chunk starts here
+    uint8_t status;     // GEOGRAPHIC_LOCATION_ASSIST_STATUS_xxx_V2
+} GPS_AssistInfo_t;
+
+void GPS_AssistInit(void); // read the transfer state and check the cached data - the data is fed to the receiver again
+bool GPS_AssistData(uint16_t size, uint16_t crc, uint16_t offset, const uint8_t * data, uint8_t len); // a chunk - false if it was not the one expected
+void GPS_AssistFlush(void); // write the partial block - a transfer resumes at the last block written after a reset
+void GPS_AssistState(GPS_AssistInfo_t * info);
+uint16_t GPS_AssistSpan(const uint8_t ** data); // bytes at *data of the next message for the receiver - 0 when all have been sent
+void GPS_AssistConsume(uint16_t len); // len bytes returned by GPS_AssistSpan() were sent
+void GPS_AssistRewind(void); // send all the messages again - the receiver lost them
+void GPS_AssistErase(void); // forget the data and the transfer - a factory reset
+uint16_t GPS_AssistCRC(uint16_t crc, const uint8_t * data, uint16_t len); // CRC-16 CCITT - start with GPS_ASSIST_CRC_INIT
+#define GPS_ASSIST_CRC_INIT 0x1D0F  // the same CRC as Z-Wave CRC-16 Encapsulation
+
+#endif
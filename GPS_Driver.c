@@ -0,0 +1,150 @@
+/**
+ * @file GPS_Driver.c
+ * @brief The part of the GPS driver common to all the receivers - see GPS_Driver.h
+ *
+ * Set GEOLOC_GPS_BACKEND in CC_GeographicLoc.h and add this file and the backend file (SAM-M8Q.c, xa1110.c or GPS_UART.c) to the project.
+ *
+ * Setup to add support to the Z-Wave SwitchOnOff sample app GSDK 4.4.1
+ * Add the following to the beginning of ApplicationTask after app_hw_init().
+m_AppTaskHandle = xTaskGetCurrentTaskHandle();
+AppTimerSetReceiverTask(m_AppTaskHandle);
+GPS_Init(&I2CTimer);
+ * For the UART receiver call UART_Init() for EUSART1 instead, GPS_Init(NULL) and GPS_Poll() on EVENT_EUSART1_CHARACTER_RECEIVED.
+ *
+ * add the following lines near the top of app.c
+#include <AppTimer.h>            // GeoLocCC
+#include "GPS_Driver.h"
+static SSwTimer I2CTimer;
+static TaskHandle_t m_AppTaskHandle;
+
+Add the following line to ApplicationInit just before the user task creation
+  AppTimerInit(EAPPLICATIONEVENT_TIMER,NULL); // GPS support
+
+Note that it may take a minute or two for the GPS to lock onto satellites or move to a more open location.
+ */
+
+#include "GPS_Driver.h"
+#ifdef GEOLOCCC_INTERFACE_I2C
+#include <sl_i2cspm.h> // I2C stuff
+#include <sl_i2cspm_gps_config.h> // "gps" or whatever you named the I2C component
+#endif
+#ifdef GEOLOC_GPS_POWER
+#include "GPS_Power.h"
+#endif
+#ifdef GEOLOC_ASSIST
+#include "GPS_Assist.h"
+#endif
+#include <FreeRTOS.h>
+#include <task.h>
+// uncomment to enable debugging info
+//#define DEBUGPRINT
+#include <DebugPrint.h>
+
+#if defined(GEOLOC_GPS_POWER) && !defined(GEOLOCCC_INTERFACE_I2C)
+#error "GEOLOC_GPS_POWER needs a receiver on I2C"
+#endif
+
+static uint8_t * NMEA_sentence; // Build the GPS NMEA sentence with the string needed - "$G.GGA..."
+static bool NMEA_valid = false;
+static bool GPS_configured = false;
+
+void NMEA_Init(uint8_t * ptr) { // Initialize the pointer to the NMEA buffer
+    NMEA_sentence=ptr;
+}
+bool is_NMEA_Valid(void) { // Is the NEMA sentence in the buffer valid?
+    return(NMEA_valid);
+}
+
+#ifdef GEOLOC_ASSIST
+/* @brief send the next messages of the assistance data from the controller - up to GPS_ASSIST_FEED_MAX bytes a poll so the
+ * input buffer of the receiver keeps up. Each message is one write - what the backend could not take is sent next poll.
+ */
+static void GPS_assist(void) {
+    const uint8_t * data;
+    uint16_t len;
+    uint16_t sent = 0;
+    while ((len = GPS_AssistSpan(&data)) && (sent + len <= GPS_ASSIST_FEED_MAX)) {
+        len = GPS_BackendWrite(data, len);
+        if (0==len) return;
+        GPS_AssistConsume(len);
+        sent += len;
+    }
+}
+#endif
+
+GPS_poll_e GPS_Poll(void) {
+    uint32_t fixes = GetFixCount();
+    if (!GPS_configured) { // set the rate and protocol on the first poll
+        if (!GPS_BackendConfigure()) {
+            return(GPS_POLL_ERROR); // failed - try again next poll
+        }
+#ifdef GEOLOC_HOT_START
+        static bool aided = false;
+        if (!aided) { // once after the reset
+            if (!GPS_BackendAid()) {
+                return(GPS_POLL_ERROR);
+            }
+            aided=true;
+        }
+#endif
+        GPS_configured=true;
+    }
+#ifdef GEOLOC_ASSIST
+    GPS_assist(); // after the aiding - the receiver needs the time to use it
+#endif
+    if (!GPS_BackendRead()) {
+        DPRINT("GPS read failed ");
+        return(GPS_POLL_ERROR); // back off and try again - it may still be booting
+    }
+    return((fixes!=GetFixCount()) ? GPS_POLL_FIX : GPS_POLL_EMPTY);
+}
+
+#ifdef GEOLOCCC_INTERFACE_I2C
+I2C_TransferReturn_TypeDef GPS_I2CTransfer(I2C_TransferSeq_TypeDef * seq) {
+    I2C_TransferReturn_TypeDef rtn = I2CSPM_Transfer(SL_I2CSPM_GPS_PERIPHERAL, seq);
+    if (i2cTransferDone!=rtn) GPS_StatsBusError(i2cTransferNack==rtn); // sent in the Statistics Report
+    return(rtn);
+}
+
+void GPS_Init(SSwTimer * pTimer) {
+    GPS_configured = false; // the first poll sets the receiver to GPS_FIX_RATE_HZ
+    GPS_SchedInit();
+    AppTimerRegister(pTimer, false, ZCB_I2CTimerCallBack);
+    TimerStart(pTimer, GPS_POLLING_INTERVAL);
+}
+
+// This callback fetches the GPS coordinates - GPS_SchedNext() picks the time of the next poll to land just after the receiver has the next fix ready
+// With GEOLOC_GPS_POWER GPS_Power.c puts the receiver to sleep between the fixes the reporting needs and the timer only runs to wake it
+void ZCB_I2CTimerCallBack(SSwTimer *pTimer) {
+  GPS_poll_e result;
+  uint32_t now;
+  uint32_t next;
+#ifdef GEOLOC_GPS_POWER
+  static bool powerInit = false;
+  if (!powerInit) {
+      GPS_PowerInit(pTimer, GPS_WAKE_ANYTIME, xTaskGetTickCount()*portTICK_PERIOD_MS);
+      powerInit = true;
+  }
+  if (GPS_PowerAsleep()) { // time to wake
+      GPS_PowerWake(xTaskGetTickCount()*portTICK_PERIOD_MS);
+      GPS_configured = GPS_BackendWake(); // configure it again in case it lost the settings
+      TimerStart(pTimer, GPS_SchedPeriod());
+      return;
+  }
+#endif
+  result = GPS_Poll();
+  now = xTaskGetTickCount()*portTICK_PERIOD_MS;
+  next = GPS_SchedNext(result, now);
+#ifdef GEOLOC_GPS_POWER
+  if (GPS_PowerSleep(result, (GetStatus()>>4) > 1, now, &next)) {
+      GPS_BackendSleep(next); // if this fails the receiver keeps tracking until the wake - nothing is lost
+  }
+#endif
+  TimerStart(pTimer, next);
+}
+#else
+void GPS_Init(SSwTimer * pTimer) {
+    (void)pTimer; // the receiver sends on its own - GPS_Poll() runs when the data arrives
+    GPS_configured = false;
+}
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @file GPS_Driver.h
+ * @brief One driver for all the GPS receivers - the receiver specific backend is chosen at compile time with GEOLOC_GPS_BACKEND
+ *
+ * GPS_Driver.c does what every receiver needs: the first poll configures the receiver and sends it the saved fix (GEOLOC_HOT_START),
+ * then each poll sends the next assistance data (GEOLOC_ASSIST) and reads what the receiver has into the parser. For the I2C receivers
+ * ZCB_I2CTimerCallBack() runs the polls on the schedule of GPS_Scheduler.c and sleeps the receiver with GPS_Power.c (GEOLOC_GPS_POWER).
+ * The backend file of the receiver has the GPS_Backend functions below. Only the backend selected compiles to anything so they are
+ * plain calls - there are no function pointers.
+ */
+
+#ifndef GPS_DRIVER_H_
+#define GPS_DRIVER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <AppTimer.h>
+#include "CC_GeographicLoc.h"
+#include "GPS_Scheduler.h"
+#if GEOLOC_GPS_BACKEND == GEOLOC_GPS_UBLOX_I2C
+#include "SAM-M8Q.h"
+#elif GEOLOC_GPS_BACKEND == GEOLOC_GPS_MTK_I2C
+#include "xa1110.h"
+#elif GEOLOC_GPS_BACKEND == GEOLOC_GPS_UART
+#include "UART_DRZ.h"
+#else
+#error "GEOLOC_GPS_BACKEND must be GEOLOC_GPS_UBLOX_I2C, GEOLOC_GPS_MTK_I2C or GEOLOC_GPS_UART"
+#endif
+
+void GPS_Init(SSwTimer * pTimer); // start the polls of an I2C receiver with pTimer - NULL for the UART
+GPS_poll_e GPS_Poll(void); // configure, aid and assist the receiver as needed and read its data - the UART calls it on EVENT_EUSART1_CHARACTER_RECEIVED
+bool is_NMEA_Valid(void);
+#ifdef GEOLOCCC_INTERFACE_I2C
+void ZCB_I2CTimerCallBack(SSwTimer *pTimer); // a poll - GPS_SchedNext() and GPS_PowerSleep() pick the time of the next one
+I2C_TransferReturn_TypeDef GPS_I2CTransfer(I2C_TransferSeq_TypeDef * seq); // the backends make every transfer with this - the failures are counted
+#endif
+
+// The backend - implemented by the receiver file
+bool GPS_BackendConfigure(void); // set the rate and protocol - the settings are not saved in the receivers so this is sent after every reset
+bool GPS_BackendAid(void); // send the fix saved before the reset (GEOLOC_HOT_START) - true if there is nothing to send
+bool GPS_BackendRead(void); // feed what the receiver has to the parser - false on a bus error
+uint16_t GPS_BackendWrite(const uint8_t * data, uint16_t len); // raw bytes for the receiver - returns the number taken, 0 if none could be
+#ifdef GEOLOC_GPS_POWER
+bool GPS_BackendSleep(uint32_t ms); // put the receiver to sleep for ms - if this fails it keeps tracking until the wake
+bool GPS_BackendWake(void); // the sleep is over - true if the receiver is configured again, false to configure it on the next poll
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file GPS_Power.c
+ * @brief Duty cycling of GPS receivers on I2C - the receiver sleeps between the fixes the reporting needs
+ *
+ * Left in continuous tracking the receiver draws 20-30mA all the time which is most of the budget of a battery node.
+ * The Lifeline heartbeat and the track log only need a fix every GPS_POWER_INTERVAL_S so between them the receiver is put
+ * in backup (u-blox UBX-RXM-PMREQ) or standby (MTK PMTK161) and the polling timer of the driver is stopped until it is time to wake.
+ *  - Each time the schedule needs a fix the receiver stays awake until it has GPS_POWER_FIXES locked fixes. The next fix is
+ *    needed GPS_POWER_INTERVAL_S after the first of them, the same time the heartbeat or the next track point is due.
+ *  - The receiver is woken the lead time before the fix is needed. The lead follows the time from the wake to the first
+ *    locked fix: it jumps up to a longer reacquire (plus a margin) at once so the next fix is not late, and creeps down a
+ *    quarter of the way each time the receiver locks faster so it does not track for nothing.
+ *  - If the schedule does not have its fixes GPS_POWER_TIMEOUT_MS after the wake (or after the fix was needed if that is later)
+ *    the receiver sleeps anyway until the next interval with twice the lead - also when it locked and lost the lock again.
+ *  - A GET wants a fresh fix. A receiver that can be woken over I2C (MTK) is woken right away, the u-blox receiver only wakes
+ *    at the end of its backup time. Either way the receiver stays awake until it has a locked fix.
+ * The caller passes in the current time and does the I2C so this only needs the timer of the driver to wake it early.
+ */
+
+#include "GPS_Power.h"
+#include <stddef.h>
+
+static SSwTimer * timer;        // polling timer of the driver - started early to wake the receiver for a GET
+static bool canWake;            // the receiver can be woken before the end of the sleep
+static bool asleep;
+static uint32_t wakeAt;         // time the receiver was woken
+static bool woke;               // wakeAt is the end of a sleep - the reacquire time is measured from it
+static bool lockedSinceWake;
+static uint32_t demandAt;       // time the schedule needs the next fix
+static uint32_t nextAt;         // time the one after that is needed - set by the first locked fix at or after demandAt
+static uint8_t fixes;           // locked fixes at or after demandAt
+static uint8_t getFixes;        // locked fixes still wanted by a GET
+static uint32_t lead = GPS_POWER_LEAD_MS;
+static uint32_t reacquire;
+
+/* @brief start with the receiver awake and a fix needed now - pTimer is the polling timer of the driver
+ */
+void GPS_PowerInit(SSwTimer * pTimer, bool wakeAnytime, uint32_t now) {
+    timer = pTimer;
+    canWake = wakeAnytime;
+    asleep = false;
+    wakeAt = now;
+    woke = false; // a cold start is not a reacquire
+    lockedSinceWake = false;
+    demandAt = now;
+    fixes = 0;
+    getFixes = 0;
+    lead = GPS_POWER_LEAD_MS;
+    reacquire = 0;
+}
+
+bool GPS_PowerAsleep(void) {
+    return(asleep);
+}
+
+uint32_t GPS_PowerLead(void) {
+    return(lead);
+}
+
+uint32_t GPS_PowerReacquire(void) {
+    return(reacquire);
+}
+
+/* @brief called by the driver after each poll at time now (ms) - returns true when the receiver should sleep for *next ms
+ * The driver then sends the sleep command and starts its timer for *next instead of the next poll.
+ */
+bool GPS_PowerSleep(GPS_poll_e result, bool locked, uint32_t now, uint32_t * next) {
+    if (asleep) return(false);
+    if ((GPS_POLL_FIX==result) && locked) {
+        if (!lockedSinceWake) {
+            lockedSinceWake = true;
+            if (woke) { // up at once to a longer reacquire, down a quarter of the way to a shorter one
+                uint32_t want = (now - wakeAt) + GPS_POWER_LEAD_MARGIN_MS;
+                reacquire = now - wakeAt;
+                lead = (want > lead) ? want : lead - (lead - want)/4;
+                if (lead > GPS_POWER_LEAD_MAX_MS) lead = GPS_POWER_LEAD_MAX_MS;
+            }
+        }
+        if (getFixes > 0) getFixes--;
+        if ((int32_t)(now - demandAt) >= 0) {
+            if (0==fixes) nextAt = now + GPS_POWER_INTERVAL_S*1000UL;
+            fixes++;
+        }
+    }
+    uint32_t from = ((int32_t)(demandAt - wakeAt) > 0) ? demandAt : wakeAt; // an early lock does not count for the fixes
+    if (fixes >= GPS_POWER_FIXES) { // the schedule has its fix
+        demandAt = nextAt;
+        fixes = 0;
+    } else if ((int32_t)(now - from) >= GPS_POWER_TIMEOUT_MS) { // no lock or lost it - try again next interval, earlier
+        demandAt = now + GPS_POWER_INTERVAL_S*1000UL;
+        fixes = 0;
+        getFixes = 0;
+        wakeAt = now;
+        lead = (lead*2 > GPS_POWER_LEAD_MAX_MS) ? GPS_POWER_LEAD_MAX_MS : lead*2;
+    }
+    if (getFixes > 0) return(false);
+    int32_t sleep = (int32_t)(demandAt - lead - now);
+    if (sleep < GPS_POWER_MIN_SLEEP_MS) return(false);
+    asleep = true;
+    *next = (uint32_t)sleep;
+    return(true);
+}
+
+/* @brief the sleep is over at time now - the driver wakes the receiver if it does not wake itself and goes back to polling
+ */
+void GPS_PowerWake(uint32_t now) {
+    asleep = false;
+    wakeAt = now;
+    woke = true;
+    lockedSinceWake = false;
+}
+
+/* @brief a GET wants a fresh fix - the receiver stays awake until it has one and is woken now if it can be
+ */
+void GPS_PowerDemand(void) {
+    getFixes = 1;
+    if (asleep && canWake && (NULL!=timer)) {
+        TimerStart(timer, 1); // the driver sees it is asleep and wakes it
+    }
+}
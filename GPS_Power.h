@@ -0,0 +1,54 @@
+/**
+ * @file GPS_Power.h
+ * @brief Duty cycling of GPS receivers on I2C - the receiver sleeps between the fixes the reporting needs
+ */
+
+#ifndef GPS_POWER_H_
+#define GPS_POWER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <AppTimer.h>
+#include "CC_GeographicLoc.h"
+#include "GPS_Scheduler.h"
+#ifdef GEOLOC_TRACK_LOG
+#include "TrackLog.h"
+#endif
+
+// Time between the fixes the reporting needs - the receiver sleeps in between. Defaults to the track log interval
+// or the Lifeline heartbeat so every point logged and every heartbeat Report has a fresh fix.
+#ifndef GPS_POWER_INTERVAL_S
+#if defined(GEOLOC_TRACK_LOG)
+#define GPS_POWER_INTERVAL_S TRACKLOG_INTERVAL_S
+#elif defined(GEOLOC_LIFELINE_REPORTS)
+#define GPS_POWER_INTERVAL_S GEOLOC_REPORT_HEARTBEAT_S
+#else
+#define GPS_POWER_INTERVAL_S 60
+#endif
+#endif
+// Locked fixes collected each time before going back to sleep - enough for the Lifeline to confirm a move
+#ifdef GEOLOC_LIFELINE_REPORTS
+#define GPS_POWER_FIXES GEOLOC_REPORT_CONFIRM
+#else
+#define GPS_POWER_FIXES 1
+#endif
+// The receiver is woken this long before the fix is needed - starts as a hot start and follows the measured reacquire time
+#define GPS_POWER_LEAD_MS 5000
+#define GPS_POWER_LEAD_MARGIN_MS 1000   // added to the reacquire time
+#define GPS_POWER_LEAD_MAX_MS 60000
+// Go back to sleep without a fix after this long - the sky is blocked so try again at the next interval with twice the lead
+#ifndef GPS_POWER_TIMEOUT_MS
+#define GPS_POWER_TIMEOUT_MS 120000
+#endif
+// Stay awake if the sleep would be shorter than this - waking costs more than a few seconds of tracking
+#define GPS_POWER_MIN_SLEEP_MS 10000
+
+void GPS_PowerInit(SSwTimer * pTimer, bool wakeAnytime, uint32_t now); // the polling timer of the driver - wakeAnytime if a GET can wake the receiver early
+bool GPS_PowerSleep(GPS_poll_e result, bool locked, uint32_t now, uint32_t * next); // after a poll - true to put the receiver to sleep for *next ms
+void GPS_PowerWake(uint32_t now); // the sleep is over - the driver wakes the receiver and polls
+void GPS_PowerDemand(void); // a fix is wanted now (GET) - wakes the receiver if it can be woken early
+bool GPS_PowerAsleep(void);
+uint32_t GPS_PowerLead(void); // current wake lead in ms
+uint32_t GPS_PowerReacquire(void); // ms from the last wake to its first locked fix - 0 if none yet
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file GPS_Scheduler.c
+ * @brief Adaptive polling schedule for GPS receivers on I2C
+ *
+ * The receivers compute a fix every 1/rate seconds and the data shows up on the I2C port a little later.
+ * Polling on a fixed timer either wastes transactions (too often) or adds up to a full period of latency (out of phase).
+ * This learns the phase of the receiver from when the fixes show up:
+ *  - When a poll finds a fix, the next poll is one period later minus a step so the polls creep earlier each epoch.
+ *    The step starts at GPS_SCHED_STEP_MS and doubles each epoch the fix was already waiting so a poll far out of phase converges in a few epochs.
+ *  - When a poll finds nothing, it is retried every GPS_SCHED_RETRY_MS until the fix shows up which then locks the phase.
+ * Once locked the fix is picked up within GPS_SCHED_RETRY_MS of being ready at the cost of about one empty poll every few epochs.
+ * Errors back off exponentially but polling never gives up since the receiver may just be booting or the bus is busy.
+ * The caller passes in the current time so this has no dependency on the timer implementation.
+ */
+
+#include "GPS_Scheduler.h"
+#include <stdbool.h>
+
+static uint32_t period = 1000/GPS_FIX_RATE_HZ;  // ms between fixes
+static uint32_t lastFix;    // time the last fix was found
+static bool waited;         // an empty poll happened since the last fix
+static uint32_t step = GPS_SCHED_STEP_MS; // how much earlier to try next epoch - doubles while the fix is always waiting
+static uint32_t backoff;    // current error backoff - 0 when not in error
+
+/* @brief start the schedule over - the phase of the receiver is learned again
+ */
+void GPS_SchedInit(void) {
+    period = 1000/GPS_FIX_RATE_HZ;
+    waited = false;
+    step = GPS_SCHED_STEP_MS;
+    backoff = 0;
+}
+
+uint32_t GPS_SchedPeriod(void) {
+    return(period);
+}
+
+/* @brief return the number of ms to wait before the next poll based on the result of the poll that just finished at time now (ms)
+ */
+uint32_t GPS_SchedNext(GPS_poll_e result, uint32_t now) {
+    uint32_t next;
+    switch (result) {
+        case GPS_POLL_FIX:
+            if (!waited) { // the fix may have been waiting - try earlier next time, twice as much earlier each epoch this keeps happening
+                next = period - step;
+                if (step < period/2) step *= 2;
+            } else { // the fix showed up since the last empty poll so the phase is known
+                next = period;
+                step = GPS_SCHED_STEP_MS;
+            }
+            waited = false;
+            backoff = 0;
+            lastFix = now;
+            break;
+        case GPS_POLL_EMPTY:
+            backoff = 0;
+            if ((now - lastFix) < period + period/2) { // the fix of this epoch is due - keep checking
+                waited = true;
+                next = GPS_SCHED_RETRY_MS;
+            } else { // no fix for well over a period - the receiver has no data yet so check once per period
+                waited = false;
+                next = period;
+            }
+            break;
+        default: // GPS_POLL_ERROR
+            waited = false;
+            backoff = (0==backoff) ? period : backoff*2;
+            if (backoff>GPS_SCHED_MAX_BACKOFF_MS) backoff = GPS_SCHED_MAX_BACKOFF_MS;
+            next = backoff;
+            break;
+    }
+    return(next);
+}
@@ -0,0 +1,34 @@
+/**
+ * @file GPS_Scheduler.h
+ * @brief Adaptive polling schedule for GPS receivers on I2C
+ */
+
+#ifndef GPS_SCHEDULER_H_
+#define GPS_SCHEDULER_H_
+
+#include <stdint.h>
+
+// Navigation rate of the receiver - 1, 5 or 10 fixes per second. The drivers configure the receiver to this rate.
+// It is fixed at build time so the polls and the receiver can never disagree - CFG-RATE and PMTK220 are built from it too.
+#ifndef GPS_FIX_RATE_HZ
+#define GPS_FIX_RATE_HZ 1
+#endif
+
+// Time between polls while waiting for the data of an epoch to show up
+#define GPS_SCHED_RETRY_MS 20
+// Each epoch the first poll is moved this much earlier until it finds no data - this keeps the polls locked just after the data is ready
+#define GPS_SCHED_STEP_MS 5
+// Errors back off exponentially from one period up to this limit - polling never stops
+#define GPS_SCHED_MAX_BACKOFF_MS 32000
+
+typedef enum {
+    GPS_POLL_FIX,       // a new fix was published by this poll
+    GPS_POLL_EMPTY,     // the receiver answered but the fix is not ready yet
+    GPS_POLL_ERROR      // I2C error or NACK
+} GPS_poll_e;
+
+void GPS_SchedInit(void); // start over at GPS_FIX_RATE_HZ - GPS_Init() calls it as the receiver is configured again
+uint32_t GPS_SchedNext(GPS_poll_e result, uint32_t now); // returns the ms until the next poll
+uint32_t GPS_SchedPeriod(void);
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * @file GPS_UART.c
+ * @brief The GEOLOC_GPS_UART backend of GPS_Driver.c - an NMEA receiver on EUSART1 with UART_DRZ.c
+ *
+ * The receiver sends on its own at the rate and protocol it was set up with so there is nothing to configure or poll.
+ * GPS_Poll() drains the RxFIFO into the parser each time EVENT_EUSART1_CHARACTER_RECEIVED is queued - see UART_DRZ.h.
+ */
+
+#include "CC_GeographicLoc.h"
+#if GEOLOC_GPS_BACKEND == GEOLOC_GPS_UART
+#include "GPS_Driver.h"
+
+bool GPS_BackendConfigure(void) {
+    return(true);
+}
+
+bool GPS_BackendAid(void) { // the aiding messages are specific to the receiver - it starts from what it has saved itself
+    return(true);
+}
+
+uint16_t GPS_BackendWrite(const uint8_t * data, uint16_t len) { // as much as fits in the Tx FIFO - the rest is sent next time
+    return(EUSART1_Write(data, len));
+}
+
+bool GPS_BackendRead(void) {
+    const uint8_t * data;
+    uint16_t len;
+    while ((len = EUSART1_RxSpan(&data))) { // the whole RxFIFO so the next event is queued
+        NMEA_feed(data, len);
+        EUSART1_RxConsume(len);
+    }
+    return(true);
+}
+
+#endif // GEOLOC_GPS_UART
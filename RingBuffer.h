@@ -0,0 +1,112 @@
+/*
+ * @file RingBuffer.h
+ * @brief Lock-free single producer/single consumer byte ring buffer
+ *
+ * One side (typically an ISR or the LDMA) only writes and the other side (the application task) only reads.
+ * No critical sections are needed: the producer only moves head and the consumer only moves tail.
+ * head and tail run freely and are masked when indexing so the full size of the buffer is usable and full is not the same as empty.
+ * The size must be a power of 2 no larger than 32768.
+ * The acquire/release atomics order the data accesses against the index updates - on a single core Cortex-M they only stop
+ * the compiler from reordering but they keep the ring correct if the two sides ever run on different cores (or a host test).
+ */
+
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct Ring
+{
+    uint8_t * buf;
+    uint16_t mask;          // size-1
+    uint16_t head;          // next byte written - only changed by the producer
+    uint16_t tail;          // next byte read - only changed by the consumer
+} Ring_t;
+
+#define RING_IS_POW2(n) ((n)>0 && 0==((n) & ((n)-1)))
+
+static inline void Ring_Init(Ring_t * r, uint8_t * buf, uint16_t size) {
+    r->buf = buf;
+    r->mask = size-1;
+    r->head = 0;
+    r->tail = 0;
+}
+
+static inline uint16_t Ring_Size(const Ring_t * r) {
+    return(r->mask+1);
+}
+
+// Number of bytes waiting - either side
+static inline uint16_t Ring_Depth(const Ring_t * r) {
+    return((uint16_t)(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)));
+}
+
+// Number of bytes that can be written - either side
+static inline uint16_t Ring_Free(const Ring_t * r) {
+    return(Ring_Size(r) - Ring_Depth(r));
+}
+
+/* Producer side */
+
+// Add one byte - returns false and drops it if the ring is full
+static inline bool Ring_Put(Ring_t * r, uint8_t dat) {
+    uint16_t head = r->head;
+    if ((uint16_t)(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) > r->mask) {
+        return(false);
+    }
+    r->buf[head & r->mask] = dat;
+    __atomic_store_n(&r->head, (uint16_t)(head+1), __ATOMIC_RELEASE); // publish the byte after it is written
+    return(true);
+}
+
+// Publish len bytes that were written directly into buf (by the LDMA) starting at head
+static inline void Ring_Commit(Ring_t * r, uint16_t len) {
+    __atomic_store_n(&r->head, (uint16_t)(r->head+len), __ATOMIC_RELEASE);
+}
+
+/* Consumer side */
+
+// Remove one byte into *dat - returns false if the ring is empty
+static inline bool Ring_Get(Ring_t * r, uint8_t * dat) {
+    uint16_t tail = r->tail;
+    if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+        return(false);
+    }
+    *dat = r->buf[tail & r->mask];
+    __atomic_store_n(&r->tail, (uint16_t)(tail+1), __ATOMIC_RELEASE); // free the byte after it is read
+    return(true);
+}
+
+// Number of contiguous bytes waiting at *data without removing them - call again after Ring_Consume() for the part that wraps
+static inline uint16_t Ring_Peek(const Ring_t * r, const uint8_t ** data) {
+    uint16_t depth = Ring_Depth(r);
+    uint16_t indx = r->tail & r->mask;
+    *data = &r->buf[indx];
+    if (depth > Ring_Size(r) - indx) {
+        depth = Ring_Size(r) - indx; // up to the end of the buffer, the rest is at the start
+    }
+    return(depth);
+}
+
+// Remove len bytes returned by Ring_Peek()
+static inline void Ring_Consume(Ring_t * r, uint16_t len) {
+    __atomic_store_n(&r->tail, (uint16_t)(r->tail+len), __ATOMIC_RELEASE);
+}
+
+// Copy up to len bytes into dst and remove them - returns the number copied
+static inline uint16_t Ring_Read(Ring_t * r, uint8_t * dst, uint16_t len) {
+    uint16_t done = 0;
+    const uint8_t * data;
+    uint16_t n;
+    while ((done < len) && (0 != (n = Ring_Peek(r, &data)))) {
+        if (n > len-done) n = len-done;
+        memcpy(&dst[done], data, n);
+        Ring_Consume(r, n);
+        done += n;
+    }
+    return(done);
+}
+
+#endif /* RING_BUFFER_H_ */
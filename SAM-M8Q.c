@@ -4,30 +4,15 @@
  * 
  * This code will extract the GPS NMEA Sentence from a SparkFun GPS receiver board.
  * The Sparkfun board is easy to use since it has a QWIIC connector so it can be easily added to any Silabs Devkit with a QWIIC connector (DK2603)
- * The tricky part is that the GPS has to be polled every 900ms to pull the GPS data via I2C.
+ * The tricky part is that the GPS has to be polled to pull the GPS data via I2C. GPS_Scheduler.c times the polls to land just after each fix.
+ * Each poll first reads the number of bytes waiting (registers 0xFD/0xFE) and then reads exactly that many from the data stream (0xFF).
  * The data comes across in pieces which must then be reassembled into a single string.
  * Then the Geographic Location Command Class code can then extract the coordinates from the NMEA string and report them via Z-Wave.
+ * Defining SAM_M8Q_UBX in SAM-M8Q.h switches the receiver to the binary UBX protocol instead. One ~100 byte UBX-NAV-PVT message
+ * per epoch already has the coordinates as integers so there is no text to parse and far fewer bytes to pull over I2C.
+ *
+ * This is the GEOLOC_GPS_UBLOX_I2C backend of GPS_Driver.c - see GPS_Driver.c for the setup in app.c.
  *
- * Setup to add support to the Z-Wave SwitchOnOff sample app GSDK 4.4.1
- * Add the following to the beginning of ApplicationTask after app_hw_init().
-m_AppTaskHandle = xTaskGetCurrentTaskHandle();
-AppTimerSetReceiverTask(m_AppTaskHandle);
-AppTimerRegister(&I2CTimer, false, ZCB_I2CTimerCallBack);
-TimerStart( &I2CTimer, GPS_POLLING_INTERVAL);
-
- * add the following lines near the top of app.c 
-#include <AppTimer.h>            // GeoLocCC
-#include "SAM-M8Q.h"
-static SSwTimer I2CTimer;
-static TaskHandle_t m_AppTaskHandle;
-
-Add the following line to ApplicationInit just before the user task creation
-  AppTimerInit(EAPPLICATIONEVENT_TIMER,NULL); // GPS support
-
-add the following lines to the EVENT_APP_SWITCH_ON_OFF enum in events.h
-  EVENT_APP_I2CTIMER_TIMEOUT,
-  EVENT_APP_NMEA_READY,
-
 Note that it may take a minute or two for the GPS to lock onto satellites or move to a more open location.
 
  Typical GPS NMEA Sentence:
@@ -44,71 +29,353 @@ $GNGGA,120908.00,4310.23951,N,07052.28237,W,1,08,2.33,33.5,M,-32.5,M,,Sats=8
  */
 
 
-#include <sl_i2cspm.h> // I2C stuff
-#include <sl_i2cspm_gps_config.h> // "gps" or whatever you named the I2C component
-#include <AppTimer.h>
-#include "SAM-M8Q.h"
-#include "events.h"
+#include "CC_GeographicLoc.h"
+#if GEOLOC_GPS_BACKEND == GEOLOC_GPS_UBLOX_I2C
+#include "GPS_Driver.h"
+#include <string.h>
+
+#ifdef SAM_M8Q_UBX
+// Binary UBX protocol - one NAV-PVT message per epoch replaces the NMEA sentences
+#define GPS_BUILD(c)    UBX_build(c)
+#define GPS_PARSE()     UBX_parsePVT()
+
+typedef enum {  // UBX state machine states
+    UBX_sync1,
+    UBX_sync2,
+    UBX_class,
+    UBX_id,
+    UBX_len1,
+    UBX_len2,
+    UBX_payload,
+    UBX_ckA,
+    UBX_ckB
+} UBX_state_e;
+
+static uint8_t UBXState = UBX_sync1; // state machine that assembles the UBX message
+static uint8_t UBX_msg[UBX_NAV_PVT_LEN]; // payload of the message - only NAV-PVT is kept
+static uint8_t UBX_msgClass;
+static uint8_t UBX_msgId;
+static uint16_t UBX_len;    // payload length from the header
+static uint16_t UBX_index;  // payload bytes received so far
+static uint8_t UBX_sumA;    // 8-bit Fletcher checksum over class, id, length and payload
+static uint8_t UBX_sumB;
+
+/* @brief Add the byte c to the UBX message as each byte arrives via I2C
+ * returns true when a complete NAV-PVT message with a good checksum is in UBX_msg
+ * UBX frame: 0xB5 0x62 CLASS ID LEN(2 bytes little endian) PAYLOAD CK_A CK_B
+ * Other messages (ACKs etc) are checksummed and dropped. A length longer than NAV-PVT is counted as a checksum error and the sync is searched for again.
+ */
+bool UBX_build(uint8_t c) {
+    bool rtn = false;
+    if (UBXState>=UBX_class && UBXState<=UBX_payload) { // running Fletcher checksum
+        UBX_sumA += c;
+        UBX_sumB += UBX_sumA;
+    }
+    switch(UBXState) {
+        case UBX_sync1:
+            if (UBX_SYNC1==c) UBXState=UBX_sync2;
+            break;
+        case UBX_sync2:
+            if (UBX_SYNC2==c) {
+                UBX_sumA=0;
+                UBX_sumB=0;
+                UBXState=UBX_class;
+            } else if (UBX_SYNC1!=c) {
+                UBXState=UBX_sync1;
+            }
+            break;
+        case UBX_class:
+            UBX_msgClass=c;
+            UBXState=UBX_id;
+            break;
+        case UBX_id:
+            UBX_msgId=c;
+            UBXState=UBX_len1;
+            break;
+        case UBX_len1:
+            UBX_len=c;
+            UBXState=UBX_len2;
+            break;
+        case UBX_len2:
+            UBX_len|=(uint16_t)c<<8;
+            UBX_index=0;
+            if (UBX_len>UBX_NAV_PVT_LEN) { // a corrupted length or a false sync - don't swallow up to 64KB before looking for the sync again
+                GPS_StatsChecksumError();
+                UBXState=UBX_sync1;
+            } else {
+                UBXState=(0==UBX_len) ? UBX_ckA : UBX_payload;
+            }
+            break;
+        case UBX_payload:
+            if (UBX_index<sizeof(UBX_msg)) UBX_msg[UBX_index]=c;
+            if (++UBX_index>=UBX_len) UBXState=UBX_ckA;
+            break;
+        case UBX_ckA:
+            if (UBX_sumA==c) {
+                UBXState=UBX_ckB;
+            } else {
+                GPS_StatsChecksumError();
+                UBXState=UBX_sync1;
+            }
+            break;
+        case UBX_ckB:
+            UBXState=UBX_sync1;
+            if (UBX_sumB!=c) {
+                GPS_StatsChecksumError();
+                break;
+            }
+            rtn = (UBX_CLASS_NAV==UBX_msgClass) && (UBX_NAV_PVT==UBX_msgId) && (UBX_NAV_PVT_LEN==UBX_len);
+            break;
+        default:
+            UBXState=UBX_sync1;
+            break;
+    }
+    return(rtn);
+}
+
+// little endian fields of the UBX payload
+static uint16_t UBX_U2(uint8_t offset) {
+    return((uint16_t)UBX_msg[offset] | ((uint16_t)UBX_msg[offset+1]<<8));
+}
+static uint32_t UBX_U4(uint8_t offset) {
+    return((uint32_t)UBX_U2(offset) | ((uint32_t)UBX_U2(offset+2)<<16));
+}
+
+/* @brief decode the NAV-PVT message in UBX_msg and publish the fix
+ * Lat/Lon are 1e-7 degrees and hMSL is mm so no text parsing is needed.
+ * Payload offsets: 0 iTOW, 4 year, 6 month, 7 day, 8 hour, 9 min, 10 sec, 11 valid, 20 fixType, 21 flags, 23 numSV,
+ * 24 lon, 28 lat, 36 hMSL, 60 gSpeed mm/s, 64 headMot 1e-5 deg, 76 pDOP 0.01
+ */
+void UBX_parsePVT(void) {
+    GPS_fix_t fix;
+    memset(&fix, 0, sizeof(fix));
+    uint8_t valid = UBX_msg[11];
+    uint8_t fixType = UBX_msg[20];
+    fix.quality = (UBX_msg[23]>15) ? 15 : UBX_msg[23]; // clip # satellites to the max that fits in the QUAL field
+    if (!(UBX_msg[21] & 0x01) || fixType<2 || fixType>4 || fix.quality<4) { // gnssFixOK with a 2D, 3D or GNSS+DR fix and at least 4 satellites
+        fix.quality=0;
+        fix.latitude=LAT_DEFAULT;
+        fix.longitude=LON_DEFAULT;
+        fix.altitude=ALT_DEFAULT;
+    } else {
+        fix.latitude  = (int32_t)(((int64_t)(int32_t)UBX_U4(28)*(1<<23))/10000000); // 1e-7 degrees to 23 bits of fraction
+        fix.longitude = (int32_t)(((int64_t)(int32_t)UBX_U4(24)*(1<<23))/10000000);
+        fix.altitude  = (int32_t)UBX_U4(36)/10; // mm to cm
+    }
+    fix.utc = (valid & 0x02) ? (((UBX_msg[8]*60 + UBX_msg[9])*60 + UBX_msg[10])*1000 + UBX_U4(0)%1000) : GPS_UTC_INVALID;
+    fix.date = (valid & 0x01) ? (UBX_msg[7]*10000 + UBX_msg[6]*100 + UBX_U2(4)%100) : 0;
+    uint32_t speed = (int32_t)UBX_U4(60)/10; // mm/s to cm/s
+    fix.speed = (speed>0xFFFF) ? 0xFFFF : speed;
+    fix.course = (int32_t)UBX_U4(64)/1000; // 1e-5 to 0.01 degrees
+    fix.pdop = UBX_U2(76);
+    fix.have = GPS_FIX_HAVE_PVT;
+    GPS_publish(&fix);
+}
+
+#else
+// NMEA sentences
+#define GPS_BUILD(c)    NMEA_build(c)
+#define GPS_PARSE()     NMEA_parse()
+#endif
+
+/* @brief send a UBX message to the receiver over I2C
+ */
+static I2C_TransferReturn_TypeDef UBX_send(uint8_t msgClass, uint8_t msgId, const uint8_t * payload, uint8_t len) {
+    I2C_TransferSeq_TypeDef seq;
+    uint8_t frame[UBX_CFG_MAX_LEN+8];
+    uint8_t sumA=0;
+    uint8_t sumB=0;
+    uint8_t i;
+    if (len>UBX_CFG_MAX_LEN) return(i2cTransferUsageFault);
+    frame[0]=UBX_SYNC1;
+    frame[1]=UBX_SYNC2;
+    frame[2]=msgClass;
+    frame[3]=msgId;
+    frame[4]=len;
+    frame[5]=0;
+    memcpy(&frame[6], payload, len);
+    for (i=2; i<len+6; i++) {
+        sumA += frame[i];
+        sumB += sumA;
+    }
+    frame[i++]=sumA;
+    frame[i++]=sumB;
+    seq.addr = I2C_GPS_ADDR<<1;
+    seq.flags = I2C_FLAG_WRITE;
+    seq.buf[0].data = frame;
+    seq.buf[0].len = i;
+    seq.buf[1].data = frame;
+    seq.buf[1].len = 0;
+    return(GPS_I2CTransfer(&seq));
+}
+
+/* @brief configure the navigation rate and, for SAM_M8Q_UBX, switch the I2C (DDC) port to UBX only output with one NAV-PVT per epoch
+ * The settings are not saved in the receiver so this is sent after every reset.
+ */
+static I2C_TransferReturn_TypeDef UBX_configure(void) {
+    I2C_TransferReturn_TypeDef rtn;
+    static const uint8_t cfgRate[6] = { // UBX-CFG-RATE
+        (1000/GPS_FIX_RATE_HZ)&0xFF, (1000/GPS_FIX_RATE_HZ)>>8, // measRate in ms
+        0x01, 0x00,                 // navRate = 1 fix per measurement
+        0x01, 0x00                  // timeRef = GPS time
+    };
+    rtn = UBX_send(UBX_CLASS_CFG, UBX_CFG_RATE, cfgRate, sizeof(cfgRate));
+    if (i2cTransferDone!=rtn) return(rtn);
+#ifdef SAM_M8Q_UBX
+    static const uint8_t cfgPrt[20] = { // UBX-CFG-PRT for the DDC port
+        0x00, 0x00,                 // portID=0 (DDC), reserved
+        0x00, 0x00,                 // txReady disabled
+        I2C_GPS_ADDR<<1, 0x00, 0x00, 0x00,  // mode = slave address
+        0x00, 0x00, 0x00, 0x00,     // reserved
+        0x01, 0x00,                 // inProtoMask = UBX
+        0x01, 0x00,                 // outProtoMask = UBX - no more NMEA
+        0x00, 0x00,                 // flags
+        0x00, 0x00                  // reserved
+    };
+    static const uint8_t cfgMsg[3] = {UBX_CLASS_NAV, UBX_NAV_PVT, 1}; // UBX-CFG-MSG - NAV-PVT every epoch on this port
+    rtn = UBX_send(UBX_CLASS_CFG, UBX_CFG_PRT, cfgPrt, sizeof(cfgPrt));
+    if (i2cTransferDone==rtn) {
+        rtn = UBX_send(UBX_CLASS_CFG, UBX_CFG_MSG, cfgMsg, sizeof(cfgMsg));
+    }
+#endif
+    return(rtn);
+}
+
+#ifdef GEOLOC_GPS_POWER
+/* @brief put the receiver in backup for ms with UBX-RXM-PMREQ - it wakes itself at the end and restarts with the last fix and ephemeris
+ * The DDC port is not a wakeup source so it can't be woken any earlier and it NACKs until it has woken up.
+ */
+static I2C_TransferReturn_TypeDef UBX_sleep(uint32_t ms) {
+    const uint8_t pmreq[8] = {
+        ms&0xFF, (ms>>8)&0xFF, (ms>>16)&0xFF, ms>>24, // duration in ms
+        0x02, 0x00, 0x00, 0x00      // flags = backup
+    };
+    return(UBX_send(UBX_CLASS_RXM, UBX_RXM_PMREQ, pmreq, sizeof(pmreq)));
+}
+#endif
+
+#ifdef GEOLOC_HOT_START
+static void UBX_put4(uint8_t * p, uint32_t v) {
+    p[0] = v;
+    p[1] = v>>8;
+    p[2] = v>>16;
+    p[3] = v>>24;
+}
+
+/* @brief send the fix saved before the reset with UBX-MGA-INI-POS_LLH so the receiver starts hot
+ * The time is only sent (UBX-MGA-INI-TIME_UTC) if the application has a time source - the time of the saved fix is not the time now.
+ */
+static I2C_TransferReturn_TypeDef UBX_aid(void) {
+    I2C_TransferReturn_TypeDef rtn;
+    GPS_aid_t aid;
+#ifdef GEOLOC_HOT_START_TIME_ACC_S
+    uint32_t utc, date;
+#endif
+    uint8_t msg[24];
+    if (!GPS_GetAiding(&aid)) return(i2cTransferDone); // nothing saved - cold start
+    memset(msg, 0, sizeof(msg));
+    msg[0] = 0x01;  // type = POS_LLH
+    UBX_put4(&msg[4], (int32_t)(((int64_t)aid.latitude*10000000)/(1<<23)));  // 23 bits of fraction to 1e-7 degrees
+    UBX_put4(&msg[8], (int32_t)(((int64_t)aid.longitude*10000000)/(1<<23)));
+    UBX_put4(&msg[12], aid.altitude);                   // cm
+    UBX_put4(&msg[16], GEOLOC_HOT_START_POS_ACC_M*100); // posAcc in cm
+    rtn = UBX_send(UBX_CLASS_MGA, UBX_MGA_INI, msg, 20);
+#ifdef GEOLOC_HOT_START_TIME_ACC_S
+    if ((i2cTransferDone==rtn) && GPS_GetTime(&utc, &date) && (GPS_UTC_INVALID!=utc) && (0!=date)) {
+        memset(msg, 0, sizeof(msg));
+        msg[0] = 0x10;  // type = TIME_UTC
+        msg[3] = 0x80;  // leapSecs = -128 unknown
+        msg[4] = (2000 + date%100)&0xFF;
+        msg[5] = (2000 + date%100)>>8;
+        msg[6] = (date/100)%100;                        // month
+        msg[7] = date/10000;                            // day
+        msg[8] = utc/3600000;
+        msg[9] = (utc/60000)%60;
+        msg[10] = (utc/1000)%60;
+        UBX_put4(&msg[12], (utc%1000)*1000000);         // ns
+        msg[16] = GEOLOC_HOT_START_TIME_ACC_S&0xFF;     // tAccS
+        msg[17] = GEOLOC_HOT_START_TIME_ACC_S>>8;
+        rtn = UBX_send(UBX_CLASS_MGA, UBX_MGA_INI, msg, 24);
+    }
+#endif
+    return(rtn);
+}
+#endif
+
+bool GPS_BackendConfigure(void) {
+    return(i2cTransferDone==UBX_configure());
+}
+
+bool GPS_BackendAid(void) {
+#ifdef GEOLOC_HOT_START
+    return(i2cTransferDone==UBX_aid());
+#else
+    return(true);
+#endif
+}
 
-static uint8_t * NMEA_sentence; // Build the GPS NMEA sentence with the string needed - "$G.GGA..."
-static bool NMEA_valid = false;
+#ifdef GEOLOC_GPS_POWER
+bool GPS_BackendSleep(uint32_t ms) {
+    return(i2cTransferDone==UBX_sleep(ms));
+}
 
-void NMEA_Init(uint8_t * ptr) { // Initialize the pointer to the NMEA buffer
-    NMEA_sentence=ptr;
+bool GPS_BackendWake(void) { // it woke itself at the end of the backup time - configure it on the next poll
+    return(false);
 }
-bool is_NMEA_Valid(void) { // Is the NEMA sentence in the buffer valid?
-    return(NMEA_valid);
+#endif
+
+/* @brief write the bytes to the receiver in one I2C write - assistance data goes straight to the input of the receiver
+ */
+uint16_t GPS_BackendWrite(const uint8_t * data, uint16_t len) {
+    I2C_TransferSeq_TypeDef seq;
+    seq.addr = I2C_GPS_ADDR<<1;
+    seq.flags = I2C_FLAG_WRITE;
+    seq.buf[0].data = (uint8_t *)data;
+    seq.buf[0].len = len;
+    seq.buf[1].data = (uint8_t *)data;
+    seq.buf[1].len = 0;
+    return((i2cTransferDone==GPS_I2CTransfer(&seq)) ? len : 0);
 }
 
-I2C_TransferReturn_TypeDef Fetch_GPS(void) { // fetch the GPS NMEA sentence from the GPS module over I2C and store it in the NMEA_sentence buffer
+bool GPS_BackendRead(void) { // fetch the GPS data from the GPS module over I2C and feed it to the NMEA or UBX parser
     static I2C_TransferSeq_TypeDef i2c_dat;
-    I2C_TransferReturn_TypeDef i2c_rtn;
-    static uint8_t i2c_txBuf[I2C_BUF_SIZE];
+    static uint8_t i2c_txBuf[1];
     static uint8_t i2c_rxBuf[I2C_BUF_SIZE];
-    int i2c_read=0; // index into the Rx buffer
-    bool i2c_done;
-    int blankcount=0;
+    uint16_t pending;   // bytes waiting in the receiver
+    uint16_t len;
+    uint16_t i;
 
-    // Setup the struct for I2CSPM to read data out of GPS module
+    // Read the number of bytes available from registers 0xFD (MSB) and 0xFE (LSB)
     i2c_dat.addr = I2C_GPS_ADDR<<1; // I2C address is 7-bits - the LSB is the READ/WRITE bit
+    i2c_dat.flags = I2C_FLAG_WRITE_READ;
+    i2c_txBuf[0]=DDC_REG_COUNT;
+    i2c_dat.buf[0].data= &i2c_txBuf[0];
+    i2c_dat.buf[0].len= 1;
+    i2c_dat.buf[1].data= &i2c_rxBuf[0];
+    i2c_dat.buf[1].len= 2;
+    if (i2cTransferDone!=GPS_I2CTransfer(&i2c_dat)) {
+        return(false); // failed
+    }
+    pending = ((uint16_t)i2c_rxBuf[0]<<8) | i2c_rxBuf[1];
+    if (pending>DDC_MAX_PENDING) pending=DDC_MAX_PENDING; // more than the receiver can buffer is bogus - just drain a buffer full
+
+    // The register pointer is now at 0xFF (the data stream) so plain reads drain exactly the pending bytes - no 0xFF filler
     i2c_dat.flags = I2C_FLAG_READ;
     i2c_dat.buf[0].data= &i2c_rxBuf[0];
-    i2c_dat.buf[0].len= sizeof(i2c_rxBuf);
-    i2c_txBuf[0]=0;
-    i2c_dat.buf[1].data= &i2c_txBuf[0];
-    i2c_dat.buf[1].len= 0;
-    i2c_done=false;
-    while (!i2c_done) {
-        i2c_rtn=I2CSPM_Transfer(SL_I2CSPM_GPS_PERIPHERAL, &i2c_dat);
-        if (i2cTransferDone!=i2c_rtn) {
-            return(i2c_rtn); // failed
+    while (pending>0) {
+        len = (pending>sizeof(i2c_rxBuf)) ? sizeof(i2c_rxBuf) : pending;
+        i2c_dat.buf[0].len= len;
+        if (i2cTransferDone!=GPS_I2CTransfer(&i2c_dat)) {
+            return(false); // failed
         }
-        for (i2c_read=0; (i2c_read<I2C_BUF_SIZE) && !i2c_done; i2c_read++) {
-            if (0xFF==i2c_rxBuf[i2c_read]) {
-                blankcount++;
-                if (blankcount>=I2C_BUF_SIZE) {
-                    i2c_done=true; // full buffer of 0x0a indicates there is no valid data - wait for the next sample
-                } 
-            } else {
-                blankcount=0;
-                if (NMEA_build(i2c_rxBuf[i2c_read])) { // Add each character to the Sentence, once the desired sentence is found, return TRUE
-                    NMEA_parse();   // parse the NMEA sentence and update coordinates
-                    i2c_done=true;
-                } 
+        for (i=0; i<len; i++) {
+            if (GPS_BUILD(i2c_rxBuf[i])) { // Add each character to the Sentence/message, once the desired one is found, return TRUE
+                GPS_PARSE();    // parse the NMEA sentence or UBX message and update coordinates
             }
         }
+        pending -= len;
     }
-    return(i2cTransferDone);
+    return(true);
 }
 
-// This callback fetches the GPS coordinates every GPS_POLLING_INTERVAL milliseconds
-void ZCB_I2CTimerCallBack(SSwTimer *pTimer) {
-  static uint8_t FailCount;
-  if (i2cTransferDone==Fetch_GPS()) {// fetch the GPS NMEA Sentence from the GPS module
-    // sometimes it fails to fetch the sentence in which case we just wait for the next interval
-      FailCount=0;
-  } else {
-      FailCount++;
-  }
-  if (FailCount<10) TimerRestart(pTimer); // If failed 10 times then the GPS is probably dead so give up
-}
+#endif // GEOLOC_GPS_UBLOX_I2C
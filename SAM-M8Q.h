@@ -5,8 +5,13 @@
 #include "CC_GeographicLoc.h"
 #include <em_i2c.h>
 
-// Size of the I2C buffer to fetch data - larger results in long I2C fetch which can delay other processing
-#define I2C_BUF_SIZE 32
+// Largest single I2C read - the pending bytes are drained in reads of up to this size. Larger results in long I2C fetch which can delay other processing
+#define I2C_BUF_SIZE 128
+
+// DDC (I2C) registers of the u-blox receivers - 0xFD/0xFE is the number of bytes available, 0xFF is the data stream
+#define DDC_REG_COUNT 0xFD
+// The receiver buffers at most 4KB - a larger count is bogus
+#define DDC_MAX_PENDING 4096
 
 // I2C address of the GPS module - the uBlox modules are all 0x42
 #define I2C_GPS_ADDR 0x42
@@ -14,10 +19,34 @@
 // GPS NMEA sentence buffer - must be large enough to hold an entire sentence
 #define NMEA_BUF_SIZE 80
 
-// The polling interval should typically be under 1s to avoid overruns which would require even more error handling
+// Time of the first poll - after that GPS_Scheduler.c picks the time of each poll
 #define GPS_POLLING_INTERVAL 933
+// The DDC port is not a wakeup source - the receiver wakes itself at the end of the backup time
+#define GPS_WAKE_ANYTIME false
+
+// Uncomment to read the binary UBX-NAV-PVT message instead of NMEA sentences.
+// The receiver is configured on the first poll to send only UBX on the I2C port with one NAV-PVT per epoch.
+//#define SAM_M8Q_UBX
 
-I2C_TransferReturn_TypeDef Fetch_GPS(void);
-void ZCB_I2CTimerCallBack(SSwTimer *pTimer);
+// UBX message framing
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_RXM 0x02
+#define UBX_CLASS_CFG 0x06
+#define UBX_CLASS_MGA 0x13
+#define UBX_NAV_PVT 0x07
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_RXM_PMREQ 0x41
+#define UBX_MGA_INI 0x40
+#define UBX_NAV_PVT_LEN 92
+#define UBX_CFG_MAX_LEN 24  // longest payload sent - UBX-MGA-INI-TIME_UTC
+
+#ifdef SAM_M8Q_UBX
+bool UBX_build(uint8_t c); // add a byte to the UBX message buffer, returns TRUE when a NAV-PVT with a good checksum is complete
+void UBX_parsePVT(void);   // decode the NAV-PVT message and publish the fix
+#endif
 
 #endif
@@ -0,0 +1,156 @@
+/* Host benchmark of the NMEA pipeline - NMEA_build() and NMEA_parse() over recorded receiver output.
+ * Usage: geobench [-n iterations] [-json] corpus.nmea ...
+ * Each corpus file is raw serial output in the style of a receiver - the ones in corpus/ are synthetic. Real captures can be passed in the same way.
+ * For each file it reports sentences/sec, ns/byte and the distribution of the cost of each sentence (line).
+ * The throughput is timed over whole passes of the file, the per sentence cost in a separate pass timing each line
+ * so the clock overhead (tens of ns) is only in the distribution.
+ * -json prints one JSON object per corpus so the results can be compared across parser changes.
+ * Build with make bench in this folder. Add BENCH_FLAGS="-DNMEA_USE_RMC -DNMEA_USE_VTG -DNMEA_USE_GSA" to merge all sentences.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ZAF_types.h"
+#include "CC_GeographicLoc.h"
+#include <ZW_TransportMulticast.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+// ZAF functions used by the command class
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) {
+    return(false);
+}
+TickType_t xTaskGetTickCount(void) {
+    return(0);
+}
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    return(JOB_STATUS_SUCCESS);
+}
+void NMEA_Init(uint8_t * ptr) { // normally in the GPS interface file
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec);
+}
+
+static int cmp_u32(const void * a, const void * b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return((x>y) - (x<y));
+}
+
+static uint8_t * load(const char * name, size_t * len) {
+    FILE * f = fopen(name, "rb");
+    if (NULL==f) return(NULL);
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t * buf = malloc(*len ? *len : 1);
+    if (buf && (fread(buf, 1, *len, f) != *len)) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return(buf);
+}
+
+// feed len bytes through the parser - returns the number of complete sentences
+static uint32_t feed(const uint8_t * data, size_t len) {
+    uint32_t sentences = 0;
+    for (size_t i=0; i<len; i++) {
+        if (NMEA_build(data[i])) {
+            NMEA_parse();
+            sentences++;
+        }
+    }
+    return(sentences);
+}
+
+static const char * basename_of(const char * path) {
+    const char * p = strrchr(path, '/');
+    return(p ? p+1 : path);
+}
+
+int main(int argc, char ** argv) {
+    int iterations = 200;
+    bool json = false;
+    int files = 0;
+
+    for (int a=1; a<argc; a++) {
+        if (0==strcmp(argv[a], "-n") && (a+1<argc)) {
+            iterations = atoi(argv[++a]);
+            if (iterations<1) iterations = 1;
+            continue;
+        }
+        if (0==strcmp(argv[a], "-json")) {
+            json = true;
+            continue;
+        }
+        size_t len;
+        uint8_t * data = load(argv[a], &len);
+        if (NULL==data) {
+            fprintf(stderr, "can't read %s\n", argv[a]);
+            return(1);
+        }
+        files++;
+
+        // lines are the unit of the per sentence cost - every sentence the receiver sent, used or not
+        uint32_t lines = 0;
+        for (size_t i=0; i<len; i++) if ('\n'==data[i]) lines++;
+        if (0==lines) lines = 1;
+
+        // throughput
+        uint32_t fixes = GetFixCount();
+        uint32_t parsed = feed(data, len); // warm up and count
+        fixes = GetFixCount() - fixes;
+        uint64_t t0 = now_ns();
+        for (int it=0; it<iterations; it++) feed(data, len);
+        uint64_t elapsed = now_ns() - t0;
+        double bytes = (double)len * iterations;
+        double nsPerByte = elapsed / bytes;
+        double sentencesPerSec = (double)lines * iterations * 1e9 / elapsed;
+
+        // per line cost
+        uint32_t passes = (iterations+9)/10;
+        uint32_t * cost = malloc(sizeof(uint32_t) * lines * passes);
+        uint32_t n = 0;
+        for (uint32_t p=0; p<passes; p++) {
+            size_t start = 0;
+            for (size_t i=0; i<len; i++) {
+                if (('\n'==data[i]) || (i+1==len)) {
+                    uint64_t s = now_ns();
+                    feed(&data[start], i+1-start);
+                    if (n < lines*passes) cost[n++] = (uint32_t)(now_ns() - s);
+                    start = i+1;
+                }
+            }
+        }
+        qsort(cost, n, sizeof(uint32_t), cmp_u32);
+        uint32_t p50 = cost[n/2];
+        uint32_t p90 = cost[(uint64_t)n*90/100];
+        uint32_t p99 = cost[(uint64_t)n*99/100];
+        uint32_t max = cost[n-1];
+
+        if (json) {
+            printf("{\"corpus\":\"%s\",\"bytes\":%zu,\"sentences\":%u,\"parsed\":%u,\"fixes\":%u,\"iterations\":%d,"
+                   "\"sentences_per_sec\":%.0f,\"ns_per_byte\":%.3f,\"sentence_ns\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}}\n",
+                   basename_of(argv[a]), len, lines, parsed, fixes, iterations, sentencesPerSec, nsPerByte, p50, p90, p99, max);
+        } else {
+            printf("%s: %zu bytes, %u sentences (%u parsed, %u fixes) x %d\n", basename_of(argv[a]), len, lines, parsed, fixes, iterations);
+            printf("  %.0f sentences/sec  %.2f ns/byte\n", sentencesPerSec, nsPerByte);
+            printf("  ns/sentence p50=%u p90=%u p99=%u max=%u\n", p50, p90, p99, max);
+        }
+        free(cost);
+        free(data);
+    }
+    if (0==files) {
+        fprintf(stderr, "usage: %s [-n iterations] [-json] corpus.nmea ...\n", argv[0]);
+        return(1);
+    }
+    return(0);
+}
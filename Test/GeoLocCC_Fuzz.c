@@ -0,0 +1,345 @@
+/* Worst case execution time and adversarial input harness for NMEA_build() and NMEA_parse().
+ * Usage: geofuzz [-n iterations] [-seed n] [-o worst.nmea] [-json] [corpus.nmea ...]
+ * The parser runs in the I2C timer callback or the UART event next to the radio stack so its worst case is what gets budgeted.
+ *  1. Crafted pathological inputs - the longest sentences, comma floods, no '*', long digit runs, fields past the table,
+ *     0x00/0xFF bytes and $ storms - and every line of the corpus files are fed first.
+ *  2. Coverage guided mutation - CC_GeographicLoc.c is built with -fsanitize-coverage=trace-pc so every basic block it executes
+ *     calls __sanitizer_cov_trace_pc() below. Mutated inputs that reach a block never seen before join the pool.
+ *     The make target adds ASan and UBSan so an out of bounds access or overflow stops the run with the input that caused it.
+ *  3. The cost of each NMEA_build() and NMEA_parse() call is counted in basic blocks executed. It is deterministic so the worst
+ *     inputs can be compared across builds and machines. -o writes the worst inputs to a file which make fuzz then times
+ *     with geobench since the instrumentation would inflate the time.
+ * After every parse the published coordinates are checked: on the globe or the default, altitude in 24 bits, time of day.
+ * The bound printed is the worst byte times the longest sentence plus the worst parse - NMEA_build() has no loops over the
+ * input and NMEA_parse() only walks the fields of the sentence buffer so no input can go past it.
+ * Build and run with make fuzz in this folder. With clang, -DGEOLOC_LIBFUZZER makes this a libFuzzer target instead (make fuzz-libfuzzer).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ZAF_types.h"
+#include "CC_GeographicLoc.h"
+#include <ZW_TransportMulticast.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#define MAX_INPUT 256       // longest mutated input
+#define POOL_SIZE 4096
+#define SENTENCE_MAX 100    // SENTENCE_BUF_LENGTH in CC_GeographicLoc.c
+
+// ZAF functions used by the command class
+static uint32_t ticks;
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) {
+    return(false);
+}
+TickType_t xTaskGetTickCount(void) {
+    return(ticks);
+}
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    return(JOB_STATUS_SUCCESS);
+}
+void NMEA_Init(uint8_t * ptr) { // normally in the GPS interface file
+}
+
+// basic block coverage and count of the instrumented code
+static uint64_t blocks;
+static uint8_t covered[1<<16];
+static uint32_t coveredCount;
+#ifndef GEOLOC_LIBFUZZER
+void __sanitizer_cov_trace_pc(void) {
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+    uint16_t h = (uint16_t)(pc ^ (pc>>16));
+    blocks++;
+    if (!covered[h]) {
+        covered[h] = 1;
+        coveredCount++;
+    }
+}
+#endif
+
+typedef struct Worst
+{
+    uint64_t cost;          // basic blocks
+    uint8_t input[MAX_INPUT];
+    size_t len;
+} Worst_t;
+static Worst_t worstByte;       // one NMEA_build() call - input is the bytes up to and including it
+static Worst_t worstParse;      // one NMEA_parse() call - input is the sentence
+static Worst_t worstSentence;   // NMEA_build() of each byte from the $ plus NMEA_parse()
+
+static void keep(Worst_t * w, uint64_t cost, const uint8_t * data, size_t len) {
+    if (cost <= w->cost) return;
+    if (len > MAX_INPUT) {
+        data += len - MAX_INPUT;
+        len = MAX_INPUT;
+    }
+    w->cost = cost;
+    memcpy(w->input, data, len);
+    w->len = len;
+}
+
+static void printEscaped(FILE * f, const uint8_t * data, size_t len, bool json) {
+    for (size_t i=0; i<len; i++) {
+        if ((data[i]<0x20) || (data[i]>0x7E) || ('"'==data[i]) || ('\\'==data[i])) fprintf(f, json ? "\\u%04x" : "\\x%02X", data[i]);
+        else fputc(data[i], f);
+    }
+}
+
+// the coordinates published after each parse must be usable - abort with the input that broke them
+static void check(const uint8_t * data, size_t len) {
+    GPS_fix_t fix;
+    ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME rpt;
+    const char * err = NULL;
+    int32_t lat = GetLatitude();
+    int32_t lon = GetLongitude();
+    int32_t alt = GetAltitude();
+    GetFix(&fix);
+    GetReport(&rpt);
+    if ((LAT_DEFAULT!=lat) && ((lat > (90<<23)) || (lat < -(90<<23)))) err = "latitude off the globe";
+    if ((LON_DEFAULT!=lon) && ((lon > (180<<23)) || (lon < -(180<<23)))) err = "longitude off the globe";
+    if (((int32_t)ALT_DEFAULT!=alt) && ((alt > 0x7FFFFF) || (alt < -0x7FFFFF))) err = "altitude does not fit in 24 bits";
+    if ((GPS_UTC_INVALID!=fix.utc) && (fix.utc >= 86401000)) err = "time past midnight";
+    if ((GetStatus()>>4) > 15) err = "quality out of range";
+    if ((rpt.latitude1!=(uint8_t)(lat>>24)) || (rpt.longitude4!=(uint8_t)lon) || (rpt.altitude3!=(uint8_t)alt)) err = "Report does not match";
+    if (NULL==err) return;
+    fprintf(stderr, "FAIL! %s: lat=%08x lon=%08x alt=%08x utc=%u after \"", err, lat, lon, alt, fix.utc);
+    printEscaped(stderr, data, len, false);
+    fprintf(stderr, "\"\n");
+    exit(1);
+}
+
+// feed the input through the parser one byte at a time and keep the most expensive calls
+static void run(const uint8_t * data, size_t len) {
+    uint64_t sentence = 0;
+    size_t start = 0;
+    for (size_t i=0; i<len; i++) {
+        uint64_t b = blocks;
+        NMEA_build_e built = NMEA_build(data[i]);
+        b = blocks - b;
+        if ('$'==data[i]) { // the cost of a sentence is counted from its $
+            sentence = 0;
+            start = i;
+        }
+        sentence += b;
+        keep(&worstByte, b, data, i+1);
+        if (NMEA_BUILD_BUSY!=built) {
+            uint64_t p = blocks;
+            NMEA_parse();
+            p = blocks - p;
+            ticks += 100;
+            check(&data[start], i+1-start);
+            keep(&worstParse, p, &data[start], i+1-start);
+            keep(&worstSentence, sentence + p, &data[start], i+1-start);
+            sentence = 0;
+            start = i+1;
+        }
+    }
+}
+
+#ifdef GEOLOC_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    run(data, size);
+    return(0);
+}
+#else
+
+// add the checksum and CR LF to the body of a sentence - returns the length
+static size_t sentence(uint8_t * buf, const char * body) {
+    uint8_t sum = 0;
+    size_t len = snprintf((char *)buf, MAX_INPUT-5, "$%s", body);
+    for (size_t i=1; i<len; i++) sum ^= buf[i];
+    return(len + snprintf((char *)&buf[len], 6, "*%02X\r\n", sum));
+}
+
+// the crafted inputs - returns 0 after the last one
+static size_t crafted(int n, uint8_t * buf) {
+    char body[MAX_INPUT];
+    size_t len;
+    switch (n) {
+        case 0: // a locked GGA with the longest fields that still fit the buffer - every decode path and a publish
+            return(sentence(buf, "GNGGA,235959.999,8959.999999999,S,17959.999999999,W,8,99,99.99,-99999.99,M,-99.9,M,,"));
+        case 1: // comma flood - more fields than the table holds
+            memset(body, ',', 90);
+            memcpy(body, "GPGGA", 5);
+            body[90] = '\0';
+            return(sentence(buf, body));
+        case 2: // no * - runs into the end of the buffer
+            len = snprintf((char *)buf, MAX_INPUT, "$GPGGA,");
+            memset(&buf[len], '7', MAX_INPUT-len);
+            return(MAX_INPUT);
+        case 3: // long digit runs in every numeric field
+            return(sentence(buf, "GPGGA,1200000000000000,48070000000000000000,N,011310000000000000000,E,1,00000000012,0000000001.0,0000000000545.4,M,,"));
+        case 4: // NUL and 0xFF bytes inside and around a sentence
+            len = sentence(buf, "GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+            buf[20] = 0x00;
+            buf[30] = 0xFF;
+            memset(&buf[len], 0xFF, 64);
+            return(len+64);
+        case 5: // $ storm - every byte restarts the sentence
+            memset(buf, '$', MAX_INPUT);
+            return(MAX_INPUT);
+        case 6: // all 20 fields used and data past them
+            return(sentence(buf, "GPGGA,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26"));
+        case 7: // bad checksum digits and a * at the very end
+            memcpy(buf, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*ZZ\r\n$GPGGA,1*", 77);
+            return(77);
+        case 8: // numbers that overflow int32 and the degree limits
+            return(sentence(buf, "GPGGA,999999.999,9999.9999,N,99999.9999,E,1,99999999999,99999999999,99999999999.99,M,,M,,"));
+        case 9: // a move of a few km each fix - the Lifeline distance and report path
+            return(sentence(buf, "GPGGA,123520,4817.038,S,00131.000,W,1,08,0.9,545.4,M,46.9,M,,"));
+        default:
+            return(0);
+    }
+}
+
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+static uint32_t random32(void) { // xorshift64
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return((uint32_t)(rng >> 32));
+}
+
+// change the input a little - returns the new length
+static size_t mutate(uint8_t * buf, size_t len, const uint8_t * other, size_t otherLen) {
+    static const uint8_t dict[] = {'$', ',', '*', '.', '-', '0', '9', 'G', 'A', 'N', 'S', 'E', 'W', '\r', '\n', 0x00, 0xFF};
+    int changes = 1 + random32()%4;
+    for (int c=0; c<changes; c++) {
+        size_t at = len ? random32()%len : 0;
+        switch (random32()%6) {
+            case 0: // flip a bit
+                if (len) buf[at] ^= 1 << (random32()%8);
+                break;
+            case 1: // replace with a dictionary byte
+                if (len) buf[at] = dict[random32()%sizeof(dict)];
+                break;
+            case 2: // insert a dictionary byte
+                if (len<MAX_INPUT) {
+                    memmove(&buf[at+1], &buf[at], len-at);
+                    buf[at] = dict[random32()%sizeof(dict)];
+                    len++;
+                }
+                break;
+            case 3: // delete a run
+                if (len) {
+                    size_t n = 1 + random32()%8;
+                    if (n > len-at) n = len-at;
+                    memmove(&buf[at], &buf[at+n], len-at-n);
+                    len -= n;
+                }
+                break;
+            case 4: // repeat a run
+                if (len) {
+                    size_t n = 1 + random32()%16;
+                    if (n > len-at) n = len-at;
+                    if (len+n > MAX_INPUT) n = MAX_INPUT-len;
+                    memmove(&buf[at+n], &buf[at], len-at);
+                    len += n;
+                }
+                break;
+            default: // splice in the tail of another input
+                if (otherLen) {
+                    size_t from = random32()%otherLen;
+                    size_t n = otherLen-from;
+                    if (at+n > MAX_INPUT) n = MAX_INPUT-at;
+                    memcpy(&buf[at], &other[from], n);
+                    len = at+n;
+                }
+                break;
+        }
+    }
+    return(len);
+}
+
+typedef struct {
+    uint8_t data[MAX_INPUT];
+    size_t len;
+} Input_t;
+static Input_t pool[POOL_SIZE];
+static uint32_t poolCount;
+
+// run an input and keep it in the pool if it reached new code
+static void try(const uint8_t * data, size_t len) {
+    uint32_t before = coveredCount;
+    run(data, len);
+    if ((coveredCount!=before) && (poolCount<POOL_SIZE)) {
+        memcpy(pool[poolCount].data, data, len);
+        pool[poolCount].len = len;
+        poolCount++;
+    }
+}
+
+// write the worst inputs one per line so make fuzz can time them with geobench which is not instrumented
+static void writeWorst(const char * name) {
+    FILE * f = fopen(name, "wb");
+    if (NULL==f) {
+        fprintf(stderr, "can't write %s\n", name);
+        exit(1);
+    }
+    const Worst_t * w[] = {&worstSentence, &worstParse, &worstByte};
+    for (int i=0; i<3; i++) {
+        fwrite(w[i]->input, 1, w[i]->len, f);
+        if ((0==w[i]->len) || ('\n'!=w[i]->input[w[i]->len-1])) fputc('\n', f);
+    }
+    fclose(f);
+}
+
+static void feedFile(const char * name) {
+    FILE * f = fopen(name, "rb");
+    char line[MAX_INPUT];
+    if (NULL==f) {
+        fprintf(stderr, "can't read %s\n", name);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) try((const uint8_t *)line, strlen(line));
+    fclose(f);
+}
+
+int main(int argc, char ** argv) {
+    long iterations = 200000;
+    bool json = false;
+    const char * out = NULL;
+    uint8_t buf[MAX_INPUT];
+    size_t len;
+
+    for (int n=0; (len = crafted(n, buf)); n++) try(buf, len);
+    for (int a=1; a<argc; a++) {
+        if (0==strcmp(argv[a], "-n") && (a+1<argc)) iterations = atol(argv[++a]);
+        else if (0==strcmp(argv[a], "-seed") && (a+1<argc)) rng = strtoull(argv[++a], NULL, 0) | 1;
+        else if (0==strcmp(argv[a], "-o") && (a+1<argc)) out = argv[++a];
+        else if (0==strcmp(argv[a], "-json")) json = true;
+        else feedFile(argv[a]);
+    }
+    for (long i=0; (i<iterations) && poolCount; i++) {
+        const Input_t * in = &pool[random32()%poolCount];
+        const Input_t * other = &pool[random32()%poolCount];
+        memcpy(buf, in->data, in->len);
+        len = mutate(buf, in->len, other->data, other->len);
+        try(buf, len);
+    }
+
+    uint64_t bound = worstByte.cost*SENTENCE_MAX + worstParse.cost;
+    if (out) writeWorst(out);
+    if (json) {
+        printf("{\"iterations\":%ld,\"pool\":%u,\"blocks_covered\":%u,\"byte_blocks\":%lu,\"parse_blocks\":%lu,\"sentence_blocks\":%lu,"
+               "\"bound_blocks\":%lu,\"worst_sentence\":\"",
+               iterations, poolCount, coveredCount, (unsigned long)worstByte.cost, (unsigned long)worstParse.cost,
+               (unsigned long)worstSentence.cost, (unsigned long)bound);
+        printEscaped(stdout, worstSentence.input, worstSentence.len, true);
+        printf("\"}\n");
+    } else {
+        printf("%ld mutations, %u inputs in the pool, %u basic blocks covered\n", iterations, poolCount, coveredCount);
+        printf("  worst byte     %4lu blocks\n", (unsigned long)worstByte.cost);
+        printf("  worst parse    %4lu blocks  \"", (unsigned long)worstParse.cost);
+        printEscaped(stdout, worstParse.input, worstParse.len, false);
+        printf("\"\n  worst sentence %4lu blocks  \"", (unsigned long)worstSentence.cost);
+        printEscaped(stdout, worstSentence.input, worstSentence.len, false);
+        printf("\"\n");
+        printf("  bound          %4lu blocks per sentence (%d bytes x %lu + %lu)\n",
+               (unsigned long)bound, SENTENCE_MAX, (unsigned long)worstByte.cost, (unsigned long)worstParse.cost);
+    }
+    return(0);
+}
+#endif
@@ -0,0 +1,98 @@
+/* Test of the epoch merge with NMEA_USE_RMC, NMEA_USE_VTG and NMEA_USE_GSA - the sentences of one UTC second are merged into
+ * one fix which is published once all of the enabled types have arrived.
+ * Build and run with make test in this folder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ZAF_types.h"
+#include "CC_GeographicLoc.h"
+#include <ZW_TransportMulticast.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#if !defined(NMEA_USE_RMC) || !defined(NMEA_USE_VTG) || !defined(NMEA_USE_GSA)
+#error "build with -DNMEA_USE_RMC -DNMEA_USE_VTG -DNMEA_USE_GSA"
+#endif
+
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) { // not testing multicast
+    return(false);
+}
+TickType_t xTaskGetTickCount(void) {
+    return(0);
+}
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    return(JOB_STATUS_SUCCESS);
+}
+
+uint8_t * NMEA_sentence;
+void NMEA_Init( uint8_t * ptr) {
+    NMEA_sentence=ptr;
+}
+
+extern const cc_registration_t cc_registration;
+
+/* feed the sentence body (between the $ and the *) with the checksum added - returns true if a fix was published
+ */
+static bool feed(const char * body) {
+    char sentence[120];
+    unsigned char sum = 0;
+    uint32_t before = GetFixCount();
+    for (int i=0; body[i]; i++) sum ^= body[i];
+    snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, sum);
+    NMEA_feed((const uint8_t *)sentence, strlen(sentence));
+    return(before!=GetFixCount());
+}
+
+// feed the sentences of an epoch and check that only the last one publishes
+static void epoch(const char * what, const char * const * sentences, int n) {
+    for (int i=0; i<n; i++) {
+        if (feed(sentences[i]) != (i==n-1)) {
+            printf("FAIL! %s: sentence %d %s\r\n", what, i, (i==n-1) ? "did not publish the epoch" : "published before the epoch was complete");
+            exit(1);
+        }
+    }
+}
+
+int main(void) {
+    GPS_fix_t fix;
+    printf("Testing the epoch merge of GGA, RMC, VTG and GSA:\r\n");
+    cc_registration.init();
+    static const char * const first[] = { // u-blox order - RMC starts the epoch
+        "GNRMC,083559.00,A,4717.11437,N,00833.91522,E,10.000,77.52,091202,,,A",
+        "GNVTG,77.52,T,,M,10.000,N,18.520,K,A",
+        "GNGGA,083559.00,4717.11437,N,00833.91522,E,1,08,1.01,499.6,M,48.0,M,,",
+        "GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47",
+    };
+    epoch("first epoch", first, 4);
+    GetFix(&fix);
+    if ((fix.utc != (8*3600+35*60+59)*1000) || (91202!=fix.date) || (fix.latitude!=GetLatitude()) || (0x17a482ba!=fix.latitude) ||
+        (49960!=fix.altitude) || (514!=fix.speed) || (7752!=fix.course) || (183!=fix.pdop) || (109!=fix.hdop) || (147!=fix.vdop) ||
+        (8!=fix.quality) || ((GPS_FIX_HAVE_GGA|GPS_FIX_HAVE_RMC|GPS_FIX_HAVE_VTG|GPS_FIX_HAVE_GSA)!=fix.have)) {
+        printf("FAIL! merged fix\r\n"); exit(1);
+    }
+    // the GSA of the next constellation is not published - the first one of the epoch is
+    if (feed("GNGSA,A,3,01,02,03,04,,,,,,,,,2.50,2.00,1.50")) { printf("FAIL! second GSA published\r\n"); exit(1); }
+    GetFix(&fix);
+    if ((183!=fix.pdop) || (109!=fix.hdop)) { printf("FAIL! second GSA changed the fix\r\n"); exit(1); }
+    static const char * const torn[] = { // the GSA of 08:36:00 was lost - the epoch is dropped when the next one starts
+        "GNRMC,083600.00,A,4717.12437,N,00833.91522,E,10.000,77.52,091202,,,A",
+        "GNVTG,77.52,T,,M,10.000,N,18.520,K,A",
+        "GNGGA,083600.00,4717.12437,N,00833.91522,E,1,08,1.01,499.6,M,48.0,M,,",
+    };
+    for (int i=0; i<3; i++) {
+        if (feed(torn[i])) { printf("FAIL! incomplete epoch published\r\n"); exit(1); }
+    }
+    static const char * const next[] = {
+        "GNRMC,083601.00,A,4717.13437,N,00833.91522,E,0.000,,091202,,,A",
+        "GNGGA,083601.00,4717.13437,N,00833.91522,E,1,09,0.90,500.1,M,48.0,M,,",
+        "GNVTG,,T,,M,0.000,N,0.000,K,A",
+        "GNGSA,A,3,80,71,73,79,69,70,,,,,,,1.50,0.90,1.20",
+    };
+    epoch("next epoch", next, 4);
+    GetFix(&fix);
+    if ((fix.utc != (8*3600+36*60+1)*1000) || (0!=fix.speed) || (0!=fix.course) || (150!=fix.pdop) || (9!=fix.quality)) { printf("FAIL! fields of the last epoch\r\n"); exit(1); }
+    printf("Tests PASS\r\n");
+    return(0);
+}
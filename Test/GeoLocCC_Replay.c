@@ -0,0 +1,310 @@
+/* Replay of raw NMEA logs from range test units through the firmware parser - writes every published fix as CSV.
+ * Usage: georeplay [-j jobs] [-chunk bytes] [-warmup bytes] [-o out.csv] [-check] [-stats] log.nmea
+ * The log is mmapped and split into chunks at $ boundaries which are parsed by jobs worker processes (default all cores).
+ * The parser is CC_GeographicLoc.c itself, included below so the workers can save and restore its state - the output is
+ * the fixes the firmware would have published byte for byte, in the order of the log, for any jobs or chunk size:
+ *  1. A worker parses warmup bytes before its chunk so the sentence and epoch being assembled are the same as if the
+ *     whole log had been parsed. It saves the parser state at the start and at the end of the chunk.
+ *  2. The fixes published inside the chunk go into shared memory - each is the GPS_fix_t the firmware would report.
+ *  3. The chunks are then chained in order: if the state at the start of a chunk is not the state the previous chunk
+ *     ended with (an epoch or a sentence longer than the warmup) the chunk is parsed again from the right state.
+ * Workers are processes rather than threads because the parser state is the static variables of the command class.
+ * -check also parses the whole log in one pass and compares. -stats prints the chunks, reparses and MB/s to stderr.
+ * Columns: offset of the last byte of the sentence that published the fix, then the GPS_fix_t fields. latitude and longitude
+ * are the signed 23 bit fraction fixed point degrees and altitude the cm of the Report. quality 1 is a checksum failure.
+ * Build with make replay in this folder. Add REPLAY_FLAGS="-DNMEA_USE_RMC ..." to match the sentences of the firmware.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "CC_GeographicLoc.c"
+#include <ZW_TransportMulticast.h>
+
+// ZAF functions used by the command class
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) {
+    return(false);
+}
+TickType_t xTaskGetTickCount(void) {
+    return(0);
+}
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    return(JOB_STATUS_SUCCESS);
+}
+void NMEA_Init(uint8_t * ptr) { // normally in the GPS interface file
+}
+
+#define MIN_SENTENCE 10     // $GPGGA,*00 - the shortest sentence NMEA_build() completes, bounds the fixes per chunk
+
+// everything in CC_GeographicLoc.c that the next fix depends on
+typedef struct ParserState
+{
+    uint8_t buf[SENTENCE_BUF_LENGTH];
+    NMEA_field_t field[NMEA_MAX_FIELDS];
+    GPS_fix_t epoch;
+    GPS_fix_t fix;      // a checksum failure publishes the previous fix with quality 1
+    uint8_t state;
+    uint8_t index;
+    uint8_t fieldCount;
+    uint8_t sum;
+    uint8_t check;
+    uint8_t candidates;
+    bool sumOK;
+} ParserState_t;
+
+typedef struct Record
+{
+    uint64_t offset;
+    GPS_fix_t fix;
+} Record_t;
+
+typedef struct Chunk
+{
+    size_t start;           // first byte - a $ except for chunk 0
+    size_t end;
+    size_t warm;            // parsing starts here
+    size_t first;           // index of the first record in the shared records
+    size_t count;           // records published
+    ParserState_t in;       // state at start
+    ParserState_t out;      // state at end
+} Chunk_t;
+
+// only what is still to be read is saved so the states of the chunks compare with memcmp - between sentences that is the fix and epoch
+static void save(ParserState_t * s) {
+    memset(s, 0, sizeof(*s));
+    s->epoch = NMEA_epoch;
+    s->fix = gps_fix;
+    s->state = NMEAState;
+    if (NMEA_search==NMEAState) return; // the next $ starts the sentence over
+    memcpy(s->buf, SentenceBufRaw, NMEA_index);
+    memcpy(s->field, NMEA_field, NMEA_fieldCount*sizeof(NMEA_field_t));
+    s->index = NMEA_index;
+    s->fieldCount = NMEA_fieldCount;
+    s->sum = NMEA_sum;
+    s->check = NMEA_check;
+    s->candidates = NMEA_candidates;
+    s->sumOK = NMEA_sumOK;
+}
+
+static void restore(const ParserState_t * s) {
+    memcpy(SentenceBufRaw, s->buf, sizeof(s->buf));
+    memcpy(NMEA_field, s->field, sizeof(s->field));
+    NMEA_epoch = s->epoch;
+    gps_fix = s->fix;
+    NMEA_index = s->index;
+    NMEA_fieldCount = s->fieldCount;
+    NMEAState = s->state;
+    NMEA_sum = s->sum;
+    NMEA_check = s->check;
+    NMEA_candidates = s->candidates;
+    NMEA_sumOK = s->sumOK;
+}
+
+// parse data[from..to) and append each published fix to rec - returns the number of records
+static size_t parse(const uint8_t * data, size_t from, size_t to, Record_t * rec) {
+    size_t n = 0;
+    for (size_t i=from; i<to; i++) {
+        if (NMEA_build(data[i])) {
+            uint32_t seq = geo_seq;
+            NMEA_parse();
+            if (rec && (seq!=geo_seq)) { // published
+                rec[n].offset = i;
+                rec[n].fix = gps_fix;
+                n++;
+            }
+        }
+    }
+    return(n);
+}
+
+// parse the warmup then the chunk from the power on state
+static void parseChunk(const uint8_t * data, Chunk_t * c, Record_t * rec, const ParserState_t * powerOn) {
+    restore(powerOn);
+    parse(data, c->warm, c->start, NULL);
+    save(&c->in);
+    c->count = parse(data, c->start, c->end, &rec[c->first]);
+    save(&c->out);
+}
+
+// shared with the workers - MAP_NORESERVE so only the pages written take memory
+static void * shared(size_t len) {
+    void * p = mmap(NULL, len ? len : 1, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED==p) {
+        perror("mmap");
+        exit(1);
+    }
+    return(p);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec);
+}
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [-j jobs] [-chunk bytes] [-warmup bytes] [-o out.csv] [-check] [-stats] log.nmea\n", name);
+    exit(1);
+}
+
+int main(int argc, char ** argv) {
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t chunkSize = 16<<20;
+    size_t warmup = 4096;
+    const char * in = NULL;
+    const char * out = NULL;
+    bool check = false;
+    bool stats = false;
+
+    for (int a=1; a<argc; a++) {
+        if (0==strcmp(argv[a], "-j") && (a+1<argc)) jobs = atol(argv[++a]);
+        else if (0==strcmp(argv[a], "-chunk") && (a+1<argc)) chunkSize = strtoul(argv[++a], NULL, 0);
+        else if (0==strcmp(argv[a], "-warmup") && (a+1<argc)) warmup = strtoul(argv[++a], NULL, 0);
+        else if (0==strcmp(argv[a], "-o") && (a+1<argc)) out = argv[++a];
+        else if (0==strcmp(argv[a], "-check")) check = true;
+        else if (0==strcmp(argv[a], "-stats")) stats = true;
+        else if (('-'!=argv[a][0]) && (NULL==in)) in = argv[a];
+        else usage(argv[0]);
+    }
+    if (NULL==in) usage(argv[0]);
+    if (jobs<1) jobs = 1;
+    if (chunkSize<MIN_SENTENCE) chunkSize = MIN_SENTENCE;
+
+    int fd = open(in, O_RDONLY);
+    struct stat st;
+    if ((fd<0) || fstat(fd, &st)) {
+        fprintf(stderr, "can't read %s\n", in);
+        return(1);
+    }
+    size_t len = st.st_size;
+    const uint8_t * data = (const uint8_t *)"";
+    if (len>0) {
+        data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED==data) {
+            perror("mmap");
+            return(1);
+        }
+        madvise((void *)data, len, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    uint64_t t0 = now_ns();
+
+    ParserState_t powerOn;
+    save(&powerOn);
+
+    // chunks start on a $ so most of them start in the search state
+    size_t nChunks = len/chunkSize + 1;
+    Chunk_t * chunk = shared(nChunks*sizeof(Chunk_t));
+    size_t records = 0;
+    size_t n = 0;
+    size_t start = 0;
+    do {
+        size_t end = (start+chunkSize < len) ? start+chunkSize : len;
+        const uint8_t * dollar = (end<len) ? memchr(&data[end], '$', len-end) : NULL;
+        if (end<len) end = dollar ? (size_t)(dollar-data) : len;
+        size_t warm = (start>warmup) ? start-warmup : 0;
+        while ((warm>0) && ('$'!=data[warm])) warm--;
+        chunk[n].start = start;
+        chunk[n].end = end;
+        chunk[n].warm = warm;
+        chunk[n].first = records;
+        records += (end-start)/MIN_SENTENCE + 1; // sentences end at least MIN_SENTENCE bytes apart
+        start = end;
+        n++;
+    } while (start<len);
+    nChunks = n;
+    Record_t * rec = shared(records*sizeof(Record_t));
+
+    // workers take the next chunk until there are none left
+    size_t * next = shared(sizeof(size_t));
+    if (jobs > (long)nChunks) jobs = nChunks;
+    for (long j=0; j<jobs; j++) {
+        pid_t pid = fork();
+        if (pid<0) {
+            perror("fork");
+            return(1);
+        }
+        if (0==pid) {
+            size_t k;
+            while ((k = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < nChunks) {
+                parseChunk(data, &chunk[k], rec, &powerOn);
+            }
+            _exit(0);
+        }
+    }
+    for (long j=0; j<jobs; j++) {
+        int status;
+        if ((wait(&status)<0) || !WIFEXITED(status) || (0!=WEXITSTATUS(status))) {
+            fprintf(stderr, "a worker failed\n");
+            return(1);
+        }
+    }
+
+    // chain the chunks - reparse any that did not start from the state the previous one ended with
+    uint32_t reparsed = 0;
+    const ParserState_t * state = &powerOn;
+    for (size_t k=0; k<nChunks; k++) {
+        if (memcmp(state, &chunk[k].in, sizeof(ParserState_t))) {
+            restore(state);
+            chunk[k].in = *state;
+            chunk[k].count = parse(data, chunk[k].start, chunk[k].end, &rec[chunk[k].first]);
+            save(&chunk[k].out);
+            reparsed++;
+        }
+        state = &chunk[k].out;
+    }
+    uint64_t elapsed = now_ns() - t0;
+
+    FILE * f = out ? fopen(out, "w") : stdout;
+    if (NULL==f) {
+        fprintf(stderr, "can't write %s\n", out);
+        return(1);
+    }
+    static char obuf[1<<20];
+    setvbuf(f, obuf, _IOFBF, sizeof(obuf));
+    fprintf(f, "offset,utc,date,latitude,longitude,altitude,quality,have,hdop,pdop,vdop,speed,course\n");
+    size_t fixes = 0;
+    for (size_t k=0; k<nChunks; k++) {
+        for (size_t i=0; i<chunk[k].count; i++) {
+            const Record_t * r = &rec[chunk[k].first + i];
+            fprintf(f, "%llu,%u,%u,%d,%d,%d,%u,%u,%u,%u,%u,%u,%u\n", (unsigned long long)r->offset, r->fix.utc, r->fix.date,
+                    r->fix.latitude, r->fix.longitude, r->fix.altitude, r->fix.quality, r->fix.have,
+                    r->fix.hdop, r->fix.pdop, r->fix.vdop, r->fix.speed, r->fix.course);
+        }
+        fixes += chunk[k].count;
+    }
+    if (f!=stdout) fclose(f);
+    else fflush(f);
+
+    if (stats) {
+        fprintf(stderr, "%s: %zu bytes, %zu fixes, %zu chunks on %ld jobs, %u reparsed, %.1f MB/s\n", in, len, fixes,
+                nChunks, jobs, reparsed, elapsed ? len*1000.0/elapsed : 0);
+    }
+
+    if (check) { // the same log in one pass from power on
+        Record_t * seq = shared((len/MIN_SENTENCE + 1)*sizeof(Record_t));
+        restore(&powerOn);
+        size_t count = parse(data, 0, len, seq);
+        size_t i = 0;
+        for (size_t k=0; (k<nChunks) && (i<=count); k++) {
+            if ((i+chunk[k].count > count) || memcmp(&seq[i], &rec[chunk[k].first], chunk[k].count*sizeof(Record_t))) {
+                fprintf(stderr, "FAIL! chunk %zu at offset %zu does not match the single pass\n", k, chunk[k].start);
+                return(1);
+            }
+            i += chunk[k].count;
+        }
+        if (i!=count) {
+            fprintf(stderr, "FAIL! %zu fixes vs %zu in the single pass\n", i, count);
+            return(1);
+        }
+        fprintf(stderr, "%s: %zu fixes match the single pass\n", in, count);
+    }
+    return(0);
+}
@@ -0,0 +1,131 @@
+/* Test of the command class without a GPS receiver (GEOLOC_NO_GPS) - the coordinates come from SET and are kept in NVM.
+ * A SET is written to NVM GEOLOC_NVM_COMMIT_MS after it arrives and only if the value changed so repeated SETs from a
+ * commissioning app are a single write and the frame handler never waits for the flash.
+ * Build and run with make test in this folder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ZAF_types.h"
+#include "CC_GeographicLoc.h"
+#include <AppTimer.h>
+
+#define FILE_ID_GPS_COORDINATES (4200) // CC_GeographicLoc.c
+
+extern const cc_registration_t cc_registration;
+
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) { // not testing multicast
+    return(false);
+}
+
+// NVM with the one file and a count of the writes
+static SgpsCoordinates nvmCoords;
+static bool nvmWritten;
+static int nvmWrites;
+zpal_status_t ZAF_nvm_app_read(uint16_t id, void *data, size_t len) {
+    if ((FILE_ID_GPS_COORDINATES!=id) || (sizeof(nvmCoords)!=len) || !nvmWritten) return(ZPAL_STATUS_FAIL);
+    memcpy(data, &nvmCoords, len);
+    return(ZPAL_STATUS_OK);
+}
+zpal_status_t ZAF_nvm_app_write(uint16_t id, const void *data, size_t len) {
+    if ((FILE_ID_GPS_COORDINATES!=id) || (sizeof(nvmCoords)!=len)) return(ZPAL_STATUS_FAIL);
+    memcpy(&nvmCoords, data, len);
+    nvmWritten = true;
+    nvmWrites++;
+    return(ZPAL_STATUS_OK);
+}
+
+// one shot timers in ms
+static uint64_t now;
+static SSwTimer * timer;
+bool AppTimerRegister(SSwTimer *pTimer, bool bAutoReload, void (*pCallback)(SSwTimer *pTimer)) {
+    pTimer->pCallback = pCallback;
+    pTimer->running = false;
+    timer = pTimer;
+    return(true);
+}
+ESwTimerStatus TimerStart(SSwTimer *pTimer, uint32_t iTimeout) {
+    pTimer->expiry = now + iTimeout;
+    pTimer->running = true;
+    return(ESWTIMER_STATUS_SUCCESS);
+}
+static void advance(uint32_t ms) {
+    now += ms;
+    if (timer && timer->running && (timer->expiry <= now)) {
+        timer->running = false;
+        timer->pCallback(timer);
+    }
+}
+
+static ZW_APPLICATION_TX_BUFFER rxFrame;
+static ZW_APPLICATION_TX_BUFFER txFrame;
+static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+
+static void set(int32_t lat, int32_t lon, int32_t alt) {
+    ZW_GEOGRAPHIC_LOCATION_SET_V2_FRAME * f = &rxFrame.ZW_GeographicLocationSetV2Frame;
+    cc_handler_input_t in = {&rxFrame, &rxOpt, sizeof(*f)};
+    cc_handler_output_t out = {&txFrame, 0};
+    f->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+    f->cmd = GEOGRAPHIC_LOCATION_SET_V2;
+    f->longitude1 = lon>>24; f->longitude2 = lon>>16; f->longitude3 = lon>>8; f->longitude4 = lon;
+    f->latitude1 = lat>>24; f->latitude2 = lat>>16; f->latitude3 = lat>>8; f->latitude4 = lat;
+    f->altitude1 = alt>>16; f->altitude2 = alt>>8; f->altitude3 = alt;
+    if (RECEIVED_FRAME_STATUS_SUCCESS != cc_registration.handler(&in, &out)) {
+        printf("FAIL! SET not handled\r\n");
+        exit(1);
+    }
+}
+
+// the Report to a GET and the NVM must have these coordinates
+static void check(const char * what, int32_t lat, int32_t lon, int32_t alt, int32_t nvmLat, int writes) {
+    ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME * r = &txFrame.ZW_GeographicLocationReportV2Frame;
+    cc_handler_input_t in = {&rxFrame, &rxOpt, 2};
+    cc_handler_output_t out = {&txFrame, 0};
+    rxFrame.ZW_Common.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+    rxFrame.ZW_Common.cmd = GEOGRAPHIC_LOCATION_GET_V2;
+    cc_registration.handler(&in, &out);
+    int32_t rLat = (int32_t)((uint32_t)r->latitude1<<24 | r->latitude2<<16 | r->latitude3<<8 | r->latitude4);
+    int32_t rLon = (int32_t)((uint32_t)r->longitude1<<24 | r->longitude2<<16 | r->longitude3<<8 | r->longitude4);
+    int32_t rAlt = (int32_t)((uint32_t)r->altitude1<<24 | r->altitude2<<16 | r->altitude3<<8)>>8;
+    printf("%s: Report %08x %08x %d, NVM %08x after %d writes\r\n", what, rLat, rLon, rAlt, nvmCoords.latitude, nvmWrites);
+    if ((sizeof(*r)!=out.length) || (rLat!=lat) || (rLon!=lon) || (rAlt!=alt)) {
+        printf("FAIL! Report expected %08x %08x %d\r\n", lat, lon, alt);
+        exit(1);
+    }
+    if ((nvmWrites!=writes) || (nvmWritten && (nvmCoords.latitude!=nvmLat))) {
+        printf("FAIL! NVM expected %08x after %d writes\r\n", nvmLat, writes);
+        exit(1);
+    }
+}
+
+int main(void) {
+    printf("Testing SET without a GPS:\r\n");
+    cc_registration.init();
+    check("erased", LAT_DEFAULT, LON_DEFAULT, (int32_t)ALT_DEFAULT, 0, 0);
+    for (int i=0; i<10; i++) { // a commissioning app sending the same SET again and again
+        set(0x186df4cd, 0x0125b1a1, 3700);
+        advance(GEOLOC_NVM_COMMIT_MS/4);
+        if ((0!=nvmWrites) && (i<3)) { printf("FAIL! NVM written in the frame handler\r\n"); exit(1); }
+    }
+    check("10 SETs", 0x186df4cd, 0x0125b1a1, 3700, 0x186df4cd, 1);
+    set(0x121d89c3, 0xc59ba211, -8690); // moved and moved back within the window
+    set(0x186df4cd, 0x0125b1a1, 3700);
+    advance(GEOLOC_NVM_COMMIT_MS);
+    check("unchanged", 0x186df4cd, 0x0125b1a1, 3700, 0x186df4cd, 1);
+    for (int i=0; i<5; i++) set(0xef1259d7 + i, 0x4b9b900a, 421); // corrections - only the last is written
+    advance(GEOLOC_NVM_COMMIT_MS);
+    check("5 corrections", 0xef1259d7+4, 0x4b9b900a, 421, 0xef1259d7+4, 2);
+    set(0xd9139c2e, 0x5355e400, 11811);
+    GeoLoc_Flush(); // going to sleep
+    check("flush", 0xd9139c2e, 0x5355e400, 11811, 0xd9139c2e, 3);
+    advance(GEOLOC_NVM_COMMIT_MS);
+    check("timer after flush", 0xd9139c2e, 0x5355e400, 11811, 0xd9139c2e, 3);
+    cc_registration.init(); // power cycle
+    check("power cycle", 0xd9139c2e, 0x5355e400, 11811, 0xd9139c2e, 3);
+    cc_registration.reset(); // factory reset
+    check("factory reset", LAT_DEFAULT, LON_DEFAULT, (int32_t)ALT_DEFAULT, LAT_DEFAULT, 4);
+    cc_registration.init();
+    check("after reset", LAT_DEFAULT, LON_DEFAULT, (int32_t)ALT_DEFAULT, LAT_DEFAULT, 4);
+    printf("Tests PASS\r\n");
+    return(0);
+}
@@ -0,0 +1,441 @@
+/* Host simulation of the GPS drivers - the real GPS_Driver.c with the SAM-M8Q.c, xa1110.c or GPS_UART.c and UART_DRZ.c backend
+ * runs unmodified against the simulated receivers and EUSART in sim/ so the polling and receive paths can be measured without a bench rig.
+ * Usage: geosim-<driver> [options] corpus.nmea
+ *   -poll ms      poll the I2C receiver on a fixed timer instead of the interval GPS_Scheduler.c asks for
+ *   -baud n       serial line rate (EUSART), or the rate the receiver fills its I2C buffer (default 9600)
+ *   -period ms    measurement period of the receiver until the driver configures it (default 1000)
+ *   -delay ms     time from the measurement to the first byte of the epoch (default 50)
+ *   -phase ms     time of the first measurement (default 300)
+ *   -buf n        I2C buffer of the receiver in bytes (default 4096)
+ *   -i2c hz       I2C clock (default 400000)
+ *   -app us       time for the application task to handle an event (default 200)
+ *   -mask us -maskperiod ms   block the EUSART interrupt for us every ms
+ *   -ttff ms      time the receiver takes to output again after a sleep (default 2000)
+ *   -get ms       send a GET this often (I2C receivers)
+ *   -cold ms      time the receiver takes to the first fix after power up without aiding (default 0)
+ *   -lost ms      the receiver loses the lock for good at this time - the run FAILs unless it is put to sleep after that (GEOLOC_GPS_POWER)
+ *   -aid          start with the first fix of the corpus saved in NVM as if the node was reset (GEOLOC_HOT_START)
+ *   -rtc          GPS_GetTime() runs from the time of the first epoch as if an RTC kept running over the reset (GEOLOC_HOT_START_TIME_ACC_S)
+ *   -assist n     the controller sends n assistance messages for the receiver with ASSIST_DATA before the run - the node is reset
+ *                 half way and the transfer resumes where ASSIST_GET says (GEOLOC_ASSIST). The transfer takes no simulated time.
+ *   -json         print the results as one JSON object
+ * It prints the I2C transactions and bus bytes per fix, the bytes dropped and the fix latency from the start of the output
+ * of each epoch to its fix being published. The CPU takes no time so the latency is only from the polling and the bus or line.
+ * Built with GEOLOC_GPS_POWER it also prints the time to the first fix, how often and how long the receiver slept and the wake
+ * lead GPS_Power.c settled on.
+ * Build and run a sweep of intervals and baud rates with make sim in this folder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ZAF_types.h"
+#include "CC_GeographicLoc.h"
+#include <ZW_TransportMulticast.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <zaf_event_distributor_soc.h>
+#include "events.h"
+#include "sim/Sim.h"
+#ifdef GEOLOC_GPS_POWER
+#include "GPS_Power.h"
+#endif
+#ifdef GEOLOC_ASSIST
+#include "GPS_Assist.h"
+#endif
+#include "GPS_Driver.h"
+
+uint64_t sim_now;
+SimConfig_t sim_cfg = {
+    .periodMs = 1000,
+    .baud = 9600,
+    .delayMs = 50,
+    .phaseMs = 300,
+    .bufSize = 4096,
+    .i2cHz = 400000,
+    .appUs = 200,
+    .ttffMs = 2000,
+};
+SimStats_t sim_stats;
+static uint32_t fixedPollMs; // 0 = GPS_Scheduler
+
+// ZAF functions used by the command class and the drivers
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) {
+    return(false);
+}
+TickType_t xTaskGetTickCount(void) {
+    return(sim_now/1000);
+}
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    return(JOB_STATUS_SUCCESS);
+}
+#if defined(GEOLOC_HOT_START) || defined(GEOLOC_ASSIST)
+// NVM with the saved fix and the assistance data - files are found by their ID
+#define NVM_FILES 48
+static struct { uint16_t id; uint16_t len; uint8_t data[128]; } nvm[NVM_FILES];
+static int nvmFiles;
+zpal_status_t ZAF_nvm_app_read(uint16_t id, void *data, size_t len) {
+    for (int i=0; i<nvmFiles; i++) {
+        if (id==nvm[i].id) {
+            if (len!=nvm[i].len) return(ZPAL_STATUS_FAIL);
+            memcpy(data, nvm[i].data, len);
+            return(ZPAL_STATUS_OK);
+        }
+    }
+    return(ZPAL_STATUS_FAIL);
+}
+zpal_status_t ZAF_nvm_app_write(uint16_t id, const void *data, size_t len) {
+    int i;
+    for (i=0; (i<nvmFiles) && (id!=nvm[i].id); i++);
+    if ((i>=NVM_FILES) || (len>sizeof(nvm[i].data))) return(ZPAL_STATUS_FAIL);
+    if (i==nvmFiles) nvmFiles++;
+    nvm[i].id = id;
+    nvm[i].len = len;
+    memcpy(nvm[i].data, data, len);
+    return(ZPAL_STATUS_OK);
+}
+#endif
+#ifdef GEOLOC_HOT_START_TIME_ACC_S
+// the time source of the application - not set without -rtc
+static uint32_t rtcUtc = GPS_UTC_INVALID;
+static uint32_t rtcDate;
+bool GPS_GetTime(uint32_t * utc, uint32_t * date) {
+    if (GPS_UTC_INVALID==rtcUtc) return(false);
+    *utc = (rtcUtc + (uint32_t)(sim_now/1000)) % 86400000;
+    *date = rtcDate;
+    return(true);
+}
+#endif
+
+bool AppTimerRegister(SSwTimer *pTimer, bool bAutoReload, void (*pCallback)(SSwTimer *pTimer)) {
+    pTimer->pCallback = pCallback;
+    pTimer->running = false;
+    return(true);
+}
+ESwTimerStatus TimerStart(SSwTimer *pTimer, uint32_t iTimeout) {
+    pTimer->expiry = sim_now + (uint64_t)(fixedPollMs ? fixedPollMs : iTimeout)*1000;
+    pTimer->running = true;
+    return(ESWTIMER_STATUS_SUCCESS);
+}
+
+// application event queue - each event is handled sim_cfg.appUs after it is queued, one at a time
+#define EVENT_QUEUE_SIZE 8
+static struct { uint8_t event; uint64_t time; } eventQueue[EVENT_QUEUE_SIZE];
+static uint32_t eventHead;
+static uint32_t eventTail;
+static uint32_t events;
+
+bool zaf_event_distributor_enqueue_app_event(const uint8_t event) {
+    if (eventHead - eventTail >= EVENT_QUEUE_SIZE) return(false);
+    uint64_t t = sim_now + sim_cfg.appUs;
+    if ((eventHead!=eventTail) && (eventQueue[(eventHead-1) % EVENT_QUEUE_SIZE].time > t)) t = eventQueue[(eventHead-1) % EVENT_QUEUE_SIZE].time;
+    eventQueue[eventHead % EVENT_QUEUE_SIZE].event = event;
+    eventQueue[eventHead % EVENT_QUEUE_SIZE].time = t;
+    eventHead++;
+    events++;
+    return(true);
+}
+bool zaf_event_distributor_enqueue_app_event_from_isr(const uint8_t event) {
+    return(zaf_event_distributor_enqueue_app_event(event));
+}
+
+static int cmp_u32(const void * a, const void * b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return((x>y) - (x<y));
+}
+
+static const char * basename_of(const char * path) {
+    const char * p = strrchr(path, '/');
+    return(p ? p+1 : path);
+}
+
+#ifdef GEOLOCCC_INTERFACE_UART
+// the application task - GPS_Poll() drains the RxFIFO
+static void appEvent(uint8_t event) {
+    if (EVENT_EUSART1_CHARACTER_RECEIVED==event) {
+        GPS_Poll();
+    }
+}
+
+static void run(void) {
+    SimEUSART_Init();
+    GPS_Init(NULL);
+    UART_Init(EUSART1, sim_cfg.baud, eusartDataBits8, eusartStopbits1, eusartNoParity, gpioPortA, 5, gpioPortA, 6);
+    for (;;) {
+        uint64_t line = SimEUSART_Next();
+        uint64_t app = (eventHead!=eventTail) ? eventQueue[eventTail % EVENT_QUEUE_SIZE].time : SIM_NEVER;
+        if ((SIM_NEVER==line) && (SIM_NEVER==app)) break;
+        if (app <= line) {
+            sim_now = app;
+            appEvent(eventQueue[eventTail++ % EVENT_QUEUE_SIZE].event);
+            SimGPS_CheckFix();
+        } else {
+            sim_now = line;
+            SimEUSART_Step();
+        }
+    }
+}
+#else
+// a GET from the controller through the command class
+static void get(void) {
+    extern const cc_registration_t cc_registration;
+    static ZW_APPLICATION_TX_BUFFER rx;
+    static ZW_APPLICATION_TX_BUFFER tx;
+    static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+    cc_handler_input_t in = {&rx, &rxOpt, 2};
+    cc_handler_output_t out = {&tx, 0};
+    rx.ZW_Common.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+    rx.ZW_Common.cmd = GEOGRAPHIC_LOCATION_GET_V2;
+    cc_registration.handler(&in, &out);
+    sim_stats.gets++;
+}
+
+#ifdef GEOLOC_ASSIST
+static uint8_t assistBlob[GPS_ASSIST_MAX];
+static uint16_t assistSize;
+static uint32_t assistFrames;   // ASSIST_DATA frames sent
+static uint32_t assistResume;   // offset the transfer resumed at after the reset
+
+static received_frame_status_t controllerSend(ZW_APPLICATION_TX_BUFFER * rx, uint8_t len, ZW_APPLICATION_TX_BUFFER * tx) {
+    extern const cc_registration_t cc_registration;
+    static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+    cc_handler_input_t in = {rx, &rxOpt, len};
+    cc_handler_output_t out = {tx, 0};
+    rx->ZW_Common.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+    return(cc_registration.handler(&in, &out));
+}
+
+// ASSIST_GET - returns the status and the offset to send next
+static uint8_t controllerGet(uint16_t * offset) {
+    static ZW_APPLICATION_TX_BUFFER rx;
+    static ZW_APPLICATION_TX_BUFFER tx;
+    rx.ZW_Common.cmd = GEOGRAPHIC_LOCATION_ASSIST_GET_V2;
+    controllerSend(&rx, 2, &tx);
+    *offset = (tx.ZW_GeographicLocationAssistReportV2Frame.offset1<<8) | tx.ZW_GeographicLocationAssistReportV2Frame.offset2;
+    return(tx.ZW_GeographicLocationAssistReportV2Frame.status);
+}
+
+// ASSIST_DATA with the chunks of assistBlob from offset up to end - stops at the first one refused
+static uint16_t controllerData(uint16_t offset, uint16_t end) {
+    static ZW_APPLICATION_TX_BUFFER rx;
+    static ZW_APPLICATION_TX_BUFFER tx;
+    ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME * f = &rx.ZW_GeographicLocationAssistDataV2Frame;
+    uint16_t crc = GPS_AssistCRC(GPS_ASSIST_CRC_INIT, assistBlob, assistSize);
+    while (offset < end) {
+        uint8_t len = (end-offset > GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX) ? GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX : end-offset;
+        f->cmd = GEOGRAPHIC_LOCATION_ASSIST_DATA_V2;
+        f->size1 = assistSize>>8;
+        f->size2 = assistSize;
+        f->crc1 = crc>>8;
+        f->crc2 = crc;
+        f->offset1 = offset>>8;
+        f->offset2 = offset;
+        memcpy(f->data, &assistBlob[offset], len);
+        assistFrames++;
+        if (RECEIVED_FRAME_STATUS_SUCCESS!=controllerSend(&rx, offsetof(ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME, data)+len, &tx)) break;
+        offset += len;
+    }
+    return(offset);
+}
+
+/* @brief the controller sends n assistance messages in the format of the receiver - UBX-MGA-ANO or PMTK721 sentences of EPO data
+ * The node is reset half way through so the transfer has to resume. Returns false if the node does not end up with valid data.
+ */
+static bool controller(int n) {
+    extern const cc_registration_t cc_registration;
+    uint32_t x = 0x2545F491;
+    uint16_t offset;
+    assistSize = 0;
+    for (int i=0; i<n; i++) {
+        uint8_t * m = &assistBlob[assistSize];
+#if GEOLOC_GPS_BACKEND == GEOLOC_GPS_MTK_I2C
+        int len = snprintf((char *)m, sizeof(assistBlob)-assistSize, "$PMTK721,%02X", 1+i%32);
+        for (int w=0; w<18; w++) {
+            x ^= x<<13; x ^= x>>17; x ^= x<<5;
+            len += snprintf((char *)&m[len], sizeof(assistBlob)-assistSize-len, ",%08X", x);
+        }
+        uint8_t sum = 0;
+        for (int j=1; j<len; j++) sum ^= m[j];
+        len += snprintf((char *)&m[len], sizeof(assistBlob)-assistSize-len, "*%02X\r\n", sum);
+        if (assistSize+len >= sizeof(assistBlob)) break;
+        assistSize += len;
+#else
+        uint8_t a = 0, b = 0;
+        if (assistSize+84 > sizeof(assistBlob)) break;
+        m[0] = 0xB5; m[1] = 0x62; m[2] = 0x13; m[3] = 0x20; m[4] = 76; m[5] = 0; // UBX-MGA-ANO
+        for (int j=6; j<82; j++) {
+            x ^= x<<13; x ^= x>>17; x ^= x<<5;
+            m[j] = x;
+        }
+        m[6] = 0x00;    // type
+        m[8] = 1+i%32;  // svId
+        m[9] = 0;       // gnssId = GPS
+        for (int j=2; j<82; j++) {
+            a += m[j];
+            b += a;
+        }
+        m[82] = a;
+        m[83] = b;
+        assistSize += 84;
+#endif
+    }
+    cc_registration.init();
+    controllerGet(&offset);
+    controllerData(0, assistSize/2);
+    cc_registration.init(); // reset - the chunks since the last full block are lost
+    controllerGet(&offset);
+    assistResume = offset;
+    controllerData(offset, assistSize);
+    return(GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2==controllerGet(&offset));
+}
+#endif
+
+static void run(void) {
+    extern const cc_registration_t cc_registration;
+    static SSwTimer timer;
+    cc_registration.init(); // the saved fix is read from NVM
+    uint64_t nextGet = sim_cfg.getMs ? (uint64_t)sim_cfg.getMs*1000 : SIM_NEVER;
+    GPS_Init(&timer);
+    while (timer.running) {
+        if (nextGet < timer.expiry) {
+            if (nextGet > sim_now) sim_now = nextGet;
+            get();
+            nextGet += (uint64_t)sim_cfg.getMs*1000;
+            continue;
+        }
+        if (timer.expiry > sim_now) sim_now = timer.expiry;
+        timer.running = false;
+        timer.pCallback(&timer);
+        SimGPS_CheckFix();
+        if ((SIM_NEVER==SimGPS_Next()) && (0==SimGPS_Buffered())) break; // the last epoch has been read
+        if (sim_now > SimGPS_LastEpoch() + 60000000ull) break; // gave up on the rest
+    }
+}
+#endif
+
+int main(int argc, char ** argv) {
+    const char * file = NULL;
+    bool json = false;
+    bool aid = false;
+    bool rtc = false;
+    uint32_t assist = 0;
+    for (int a=1; a<argc; a++) {
+        uint32_t * opt = NULL;
+        if (0==strcmp(argv[a], "-json")) json = true;
+        else if (0==strcmp(argv[a], "-aid")) aid = true;
+        else if (0==strcmp(argv[a], "-rtc")) rtc = true;
+        else if (0==strcmp(argv[a], "-poll")) opt = &fixedPollMs;
+        else if (0==strcmp(argv[a], "-baud")) opt = &sim_cfg.baud;
+        else if (0==strcmp(argv[a], "-period")) opt = &sim_cfg.periodMs;
+        else if (0==strcmp(argv[a], "-delay")) opt = &sim_cfg.delayMs;
+        else if (0==strcmp(argv[a], "-phase")) opt = &sim_cfg.phaseMs;
+        else if (0==strcmp(argv[a], "-buf")) opt = &sim_cfg.bufSize;
+        else if (0==strcmp(argv[a], "-i2c")) opt = &sim_cfg.i2cHz;
+        else if (0==strcmp(argv[a], "-app")) opt = &sim_cfg.appUs;
+        else if (0==strcmp(argv[a], "-mask")) opt = &sim_cfg.maskUs;
+        else if (0==strcmp(argv[a], "-maskperiod")) opt = &sim_cfg.maskPeriodMs;
+        else if (0==strcmp(argv[a], "-ttff")) opt = &sim_cfg.ttffMs;
+        else if (0==strcmp(argv[a], "-get")) opt = &sim_cfg.getMs;
+        else if (0==strcmp(argv[a], "-cold")) opt = &sim_cfg.coldMs;
+        else if (0==strcmp(argv[a], "-lost")) opt = &sim_cfg.lostMs;
+        else if (0==strcmp(argv[a], "-assist")) opt = &assist;
+        else file = argv[a];
+        if (opt && (a+1<argc)) *opt = strtoul(argv[++a], NULL, 0);
+    }
+    if ((0==sim_cfg.baud) || (0==sim_cfg.i2cHz) || (sim_cfg.bufSize>65536)) file = NULL;
+    if ((NULL==file) || !SimGPS_Load(file)) {
+        fprintf(stderr, "usage: %s [-poll ms] [-baud n] [-period ms] [-delay ms] [-phase ms] [-buf n] [-i2c hz] [-app us]"
+                        " [-mask us -maskperiod ms] [-ttff ms] [-get ms] [-cold ms] [-lost ms] [-aid] [-rtc] [-assist n] [-json] corpus.nmea\n", argv[0]);
+        return(1);
+    }
+#ifdef GEOLOC_HOT_START
+    GPS_aid_t saved;
+    bool first = SimGPS_FirstFix(&saved.latitude, &saved.longitude, &saved.altitude, &saved.utc, &saved.date);
+    if (aid && first) {
+        ZAF_nvm_app_write(FILE_ID_GPS_AID, &saved, sizeof(saved));
+    }
+#ifdef GEOLOC_HOT_START_TIME_ACC_S
+    if (rtc && first) {
+        rtcUtc = saved.utc;
+        rtcDate = saved.date;
+    }
+#else
+    (void)rtc; // no time source in this build
+#endif
+#else
+    (void)aid; // no hot start in this build
+    (void)rtc;
+#endif
+#ifdef GEOLOC_ASSIST
+    if (assist && !controller(assist)) {
+        fprintf(stderr, "%s: the transfer of %u bytes of assistance data failed\n", argv[0], assistSize);
+        return(1);
+    }
+#else
+    (void)assist;
+#endif
+
+    run();
+
+    uint32_t n = sim_stats.matched;
+    qsort(sim_stats.latency, n, sizeof(uint32_t), cmp_u32);
+    double p50 = n ? sim_stats.latency[n/2]/1000.0 : 0;
+    double p90 = n ? sim_stats.latency[(uint64_t)n*90/100]/1000.0 : 0;
+    double max = n ? sim_stats.latency[n-1]/1000.0 : 0;
+    double fixes = sim_stats.fixes ? sim_stats.fixes : 1;
+#ifdef GEOLOCCC_INTERFACE_UART
+    EUSART_RxStats_t rx;
+    EUSART_GetRxStats(EUSART1, &rx);
+    if (json) {
+        printf("{\"sim\":\"%s\",\"corpus\":\"%s\",\"baud\":%u,\"app_us\":%u,\"mask_us\":%u,\"mask_period_ms\":%u,\"epochs\":%u,\"fixes\":%u,"
+               "\"irqs_per_fix\":%.1f,\"events_per_fix\":%.1f,\"drops\":%u,\"overruns\":%u,\"bytes_lost\":%u,"
+               "\"latency_ms\":{\"p50\":%.1f,\"p90\":%.1f,\"max\":%.1f}}\n",
+               basename_of(argv[0]), basename_of(file), sim_cfg.baud, sim_cfg.appUs, sim_cfg.maskUs, sim_cfg.maskPeriodMs,
+               sim_stats.epochs, sim_stats.fixes, sim_stats.irqs/fixes, events/fixes, rx.drops, rx.overruns, sim_stats.hwOverruns, p50, p90, max);
+    } else {
+        printf("%s %s baud=%u app=%uus mask=%uus/%ums: %u epochs %u fixes, %.1f irqs/fix %.1f events/fix, %u drops %u overruns (%u bytes lost), "
+               "latency ms p50=%.1f p90=%.1f max=%.1f\n",
+               basename_of(argv[0]), basename_of(file), sim_cfg.baud, sim_cfg.appUs, sim_cfg.maskUs, sim_cfg.maskPeriodMs,
+               sim_stats.epochs, sim_stats.fixes, sim_stats.irqs/fixes, events/fixes, rx.drops, rx.overruns, sim_stats.hwOverruns, p50, p90, max);
+    }
+#else
+    char power[384] = "";
+#ifdef GEOLOC_GPS_POWER
+    double awake = sim_now ? 100.0*(sim_now - sim_stats.sleptUs)/sim_now : 100.0;
+    snprintf(power, sizeof(power), json ? ",\"ttff_ms\":%u,\"cold_ms\":%u,\"aids\":%u,\"first_fix_ms\":%u,\"gets\":%u,\"sleeps\":%u,\"awake_pct\":%.1f,\"lead_ms\":%u,\"reacquire_ms\":%u"
+                                        : ", ttff=%ums cold=%ums %u aids: first fix %ums, %u gets, %u sleeps awake %.1f%% lead=%ums reacquire=%ums",
+             sim_cfg.ttffMs, sim_cfg.coldMs, sim_stats.aids, GetTTFF(), sim_stats.gets, sim_stats.sleeps, awake, GPS_PowerLead(), GPS_PowerReacquire());
+#endif
+#ifdef GEOLOC_ASSIST
+    size_t used = strlen(power);
+    if (assistSize) snprintf(&power[used], sizeof(power)-used, json ? ",\"assist_bytes\":%u,\"assist_frames\":%u,\"assist_resume\":%u,\"assists\":%u,\"assist_bad\":%u"
+                                                   : ", assistance %u bytes in %u frames resumed at %u: %u messages %u bad",
+             assistSize, assistFrames, assistResume, sim_stats.assists, sim_stats.assistBad);
+#endif
+    GPS_stats_t stats;
+    GetStats(&stats);
+    if (json) {
+        printf("{\"sim\":\"%s\",\"corpus\":\"%s\",\"poll_ms\":%u,\"baud\":%u,\"period_ms\":%u,\"epochs\":%u,\"fixes\":%u,"
+               "\"transfers_per_fix\":%.1f,\"bus_bytes_per_fix\":%.0f,\"pad_bytes_per_fix\":%.1f,\"dropped\":%u,\"bus_errors\":%u,\"nacks\":%u,"
+               "\"latency_ms\":{\"p50\":%.1f,\"p90\":%.1f,\"max\":%.1f}%s}\n",
+               basename_of(argv[0]), basename_of(file), fixedPollMs, sim_cfg.baud, SimGPS_PeriodMs(), sim_stats.epochs, sim_stats.fixes,
+               sim_stats.transfers/fixes, sim_stats.busBytes/fixes, sim_stats.padBytes/fixes, sim_stats.dropped, stats.busErrors, stats.nacks, p50, p90, max, power);
+    } else {
+        char poll[16] = "sched";
+        if (fixedPollMs) snprintf(poll, sizeof(poll), "%ums", fixedPollMs);
+        printf("%s %s poll=%s baud=%u period=%ums: %u epochs %u fixes, %.1f transfers/fix %.0f bus bytes/fix %.1f pad bytes/fix, %u dropped, %u I2C errors (%u NACKs), "
+               "latency ms p50=%.1f p90=%.1f max=%.1f%s\n",
+               basename_of(argv[0]), basename_of(file), poll, sim_cfg.baud, SimGPS_PeriodMs(), sim_stats.epochs, sim_stats.fixes,
+               sim_stats.transfers/fixes, sim_stats.busBytes/fixes, sim_stats.padBytes/fixes, sim_stats.dropped, stats.busErrors, stats.nacks, p50, p90, max, power);
+    }
+#ifdef GEOLOC_GPS_POWER
+    if (sim_cfg.lostMs && (0==sim_stats.lostSleeps)) { // tracking for nothing until the lock comes back
+        printf("FAIL! the receiver stayed awake after losing the lock at %ums\n", sim_cfg.lostMs);
+        return(1);
+    }
+#endif
+#endif
+    return(0);
+}
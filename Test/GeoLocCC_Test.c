@@ -8,6 +8,15 @@
 #include <stdlib.h>
 #include "ZAF_types.h"
 #include "CC_GeographicLoc.h"
+#include <ZW_TransportMulticast.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#ifdef GEOLOC_TRACK_LOG
+#include "TrackLog.h"
+#endif
+#ifdef GEOLOC_ASSIST
+#include "GPS_Assist.h"
+#endif
 
 //#define NO_DEBUGPRINT
 //#define DPRINT(...) do {} while(0)
@@ -23,6 +32,7 @@ unsigned char GPSData[] = {
 "Bad CRC        : $GPGGA,221800.175,7750.807777,S,16640.261234,E,1,12,1.0,118,M,0.0,M,,*66\r\n" \
 "Bad CRC        : $GPGGA,221800.175,7750.807777,S,16640.261234,E,1,12,1.0,118,M,0.0,M,,*68\r\n" \
 "Bad CRC        : $GPGGA,221800.175,7750.807777,S,16640.261234, E,1,12,1.0,118,M,0.0,M,,*67\r\n\x00" \
+"ZED-F9P 7 digits: $GNGGA,092725.00,4717.1133547,N,00833.9157362,E,1,12,0.50,499.6,M,48.0,M,,*47\r\n" \
 };
 
 
@@ -35,6 +45,106 @@ uint32_t CORE_EnterAtomic(void) { // ignore
 void CORE_ExitAtomic(uint32_t dummy) { // ignore
 }
 
+static uint32_t ticks; // ms
+TickType_t xTaskGetTickCount(void) {
+    return(ticks);
+}
+static int reportsSent; // unsolicited Reports to the Lifeline
+static int batchesSent; // unsolicited Batch Reports
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    if (GEOGRAPHIC_LOCATION_REPORT_V2==p_frame[1]) reportsSent++;
+    else batchesSent++;
+    return(JOB_STATUS_SUCCESS);
+}
+
+#ifdef GEOLOC_TRACK_LOG
+// NVM files of the track log, the saved fix and the assistance data - a reset is TrackLog_Init() again
+#ifdef GEOLOC_ASSIST
+#define NVM_ASSIST (TRACKLOG_BLOCKS+2)
+#define NVM_FILES (NVM_ASSIST+1+GPS_ASSIST_BLOCKS)
+#else
+#define NVM_FILES (TRACKLOG_BLOCKS+2)
+#endif
+static uint8_t nvm[NVM_FILES][sizeof(TrackBlock_t)];
+static size_t nvmLen[NVM_FILES];
+static int nvmWrites;
+static int aidWrites;
+static int assistWrites;
+static int nvmIndex(uint16_t id) {
+    if (FILE_ID_TRACKLOG_ACK==id) return(TRACKLOG_BLOCKS);
+#ifdef GEOLOC_HOT_START
+    if (FILE_ID_GPS_AID==id) return(TRACKLOG_BLOCKS+1);
+#endif
+#ifdef GEOLOC_ASSIST
+    if (FILE_ID_GPS_ASSIST_INFO==id) return(NVM_ASSIST);
+    if ((id>=FILE_ID_GPS_ASSIST) && (id<FILE_ID_GPS_ASSIST+GPS_ASSIST_BLOCKS)) return(NVM_ASSIST+1+id-FILE_ID_GPS_ASSIST);
+#endif
+    if ((id>=FILE_ID_TRACKLOG) && (id<FILE_ID_TRACKLOG+TRACKLOG_BLOCKS)) return(id-FILE_ID_TRACKLOG);
+    return(-1);
+}
+zpal_status_t ZAF_nvm_app_read(uint16_t id, void *data, size_t len) {
+    int i = nvmIndex(id);
+    if ((i<0) || (nvmLen[i]!=len)) return(ZPAL_STATUS_FAIL);
+    memcpy(data, nvm[i], len);
+    return(ZPAL_STATUS_OK);
+}
+zpal_status_t ZAF_nvm_app_write(uint16_t id, const void *data, size_t len) {
+    int i = nvmIndex(id);
+    if ((i<0) || (len>sizeof(nvm[0]))) return(ZPAL_STATUS_FAIL);
+    memcpy(nvm[i], data, len);
+    nvmLen[i] = len;
+    if (TRACKLOG_BLOCKS+1==i) aidWrites++;
+    else if (i>=TRACKLOG_BLOCKS+2) assistWrites++;
+    else nvmWrites++;
+    return(ZPAL_STATUS_OK);
+}
+
+// the n'th point of a walk that crosses the date line and goes below sea level - fix gets it at 1 Hz
+static TrackPoint_t trackPoint(int n, GPS_fix_t * fix) {
+    TrackPoint_t pt;
+    pt.time = 49600 + n*TRACKLOG_INTERVAL_S; // 13:46:40 - no date so the time counts from midnight of the first day
+    pt.latitude = -(45<<23) + n*37 - (n%7)*11;
+    pt.longitude = (int32_t)((uint32_t)(180<<23) - 40000 + (uint32_t)n*901); // about 10m a minute - crosses to -180 after 45 points
+    pt.altitude = 150 - n*3 + (n%5)*2;
+    pt.quality = 4 + (n%12);
+    memset(fix, 0, sizeof(*fix));
+    fix->latitude = pt.latitude;
+    fix->longitude = pt.longitude;
+    fix->altitude = pt.altitude;
+    fix->quality = pt.quality;
+    fix->utc = (pt.time%86400)*1000;
+    fix->date = 0;
+    fix->have = GPS_FIX_HAVE_GGA;
+    return(pt);
+}
+
+// read all of the log from the oldest point not acknowledged and compare it with the walk from point first to end
+static bool trackCheck(int first, int end) {
+    TrackLog_cursor_t cur;
+    TrackPoint_t pts[7];
+    GPS_fix_t fix;
+    uint8_t n;
+    int i = first;
+    TrackLog_Open(&cur);
+    while ((n = TrackLog_Read(&cur, pts, 7)) > 0) {
+        for (uint8_t k=0; k<n; k++, i++) {
+            TrackPoint_t want = trackPoint(i, &fix);
+            if ((want.time!=pts[k].time) || (want.latitude!=pts[k].latitude) || (want.longitude!=pts[k].longitude) ||
+                (want.altitude!=pts[k].altitude) || (want.quality!=pts[k].quality)) {
+                printf("FAIL! track point %d is %u %08x %08x %d %d\r\n", i, pts[k].time, pts[k].latitude, pts[k].longitude, pts[k].altitude, pts[k].quality);
+                return(false);
+            }
+        }
+    }
+    if (i!=end) {
+        printf("FAIL! read track points %d to %d, expected %d to %d\r\n", first, i, first, end);
+        return(false);
+    }
+    return(true);
+}
+#endif
+
 unsigned char * NMEA_sentence;
 void NMEA_Init( uint8_t * ptr) {
     NMEA_sentence=ptr;
@@ -43,6 +153,15 @@ void NMEA_Init( uint8_t * ptr) {
 uint8_t buf[128]; // buffer for processing the NMEA sentence
 
 bool checkOK( int32_t lat, int32_t lon, int32_t alt) { // compares the current coordinates with the hardcoded values passed in and returns false if it fails
+    ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME rpt;
+    GetReport(&rpt); // the pre-encoded Report frame must match the coordinates
+    int32_t rptLat = (int32_t)((uint32_t)rpt.latitude1<<24 | rpt.latitude2<<16 | rpt.latitude3<<8 | rpt.latitude4);
+    int32_t rptLon = (int32_t)((uint32_t)rpt.longitude1<<24 | rpt.longitude2<<16 | rpt.longitude3<<8 | rpt.longitude4);
+    int32_t rptAlt = (int32_t)((uint32_t)rpt.altitude1<<24 | rpt.altitude2<<16 | rpt.altitude3<<8)>>8;
+    if ((rptLat != GetLatitude()) || (rptLon != GetLongitude()) || (rptAlt != GetAltitude()) || (rpt.status != GetStatus())) {
+        printf("FAIL! Report %08x %08x %06x %02x does not match the coordinates\r\n", rptLat, rptLon, rptAlt, rpt.status);
+        return(false);
+    }
     if ((GetLatitude() == lat) && (GetLongitude() == lon) && (GetAltitude() == alt)) return(true);
     printf("FAIL! Lat Expected %08x got %08x ", lat, GetLatitude());
     printf("Lon Expected %08x got %08x ", lon, GetLongitude());
@@ -50,6 +169,121 @@ bool checkOK( int32_t lat, int32_t lon, int32_t alt) { // compares the current c
     return(false);
 }
 
+/* feed a GGA sentence at latitude lat (NMEA ddmm.mmmm) with the checksum added - returns the number of Reports sent to the Lifeline
+ */
+int feedGGA(const char * lat, int qual) {
+    char sentence[100];
+    int before = reportsSent;
+    unsigned char sum = 0;
+    int len = snprintf(sentence, sizeof(sentence), "$GNGGA,092725.00,%s,N,00833.9157362,E,%d,12,0.50,499.6,M,48.0,M,,", lat, qual);
+    for (int i=1; i<len; i++) sum ^= sentence[i];
+    snprintf(&sentence[len], sizeof(sentence)-len, "*%02X\r\n", sum);
+    for (int i=0; sentence[i]; i++) {
+        if (NMEA_build(sentence[i])) NMEA_parse();
+    }
+    ticks += 1000;
+    return(reportsSent-before);
+}
+
+#ifdef GEOLOC_ASSIST
+static uint8_t assistBlob[1700];
+
+/* send the chunk of assistBlob at offset as an ASSIST_DATA frame of a transfer of size bytes - returns the handler status
+ */
+static received_frame_status_t assistSend(uint16_t size, uint16_t crc, uint16_t offset, uint8_t len) {
+    extern const cc_registration_t cc_registration;
+    static ZW_APPLICATION_TX_BUFFER rx, tx;
+    static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+    ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME * f = &rx.ZW_GeographicLocationAssistDataV2Frame;
+    cc_handler_input_t in = {&rx, &rxOpt, (uint8_t)(offsetof(ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME, data) + len)};
+    cc_handler_output_t out = {&tx, 0};
+    f->cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+    f->cmd = GEOGRAPHIC_LOCATION_ASSIST_DATA_V2;
+    f->size1 = size>>8;
+    f->size2 = size;
+    f->crc1 = crc>>8;
+    f->crc2 = crc;
+    f->offset1 = offset>>8;
+    f->offset2 = offset;
+    memcpy(f->data, &assistBlob[offset], len);
+    received_frame_status_t rtn = cc_registration.handler(&in, &out);
+    if (0!=out.length) { printf("FAIL! ASSIST_DATA was answered\r\n"); exit(1); }
+    return(rtn);
+}
+
+/* ASSIST_GET - returns the status and the offset to send next
+ */
+static uint8_t assistGet(uint16_t * offset) {
+    extern const cc_registration_t cc_registration;
+    static ZW_APPLICATION_TX_BUFFER rx, tx;
+    static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+    cc_handler_input_t in = {&rx, &rxOpt, 2};
+    cc_handler_output_t out = {&tx, 0};
+    rx.ZW_Common.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+    rx.ZW_Common.cmd = GEOGRAPHIC_LOCATION_ASSIST_GET_V2;
+    const ZW_GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2_FRAME * r = &tx.ZW_GeographicLocationAssistReportV2Frame;
+    if ((RECEIVED_FRAME_STATUS_SUCCESS!=cc_registration.handler(&in, &out)) || (sizeof(*r)!=out.length) ||
+        (GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2!=r->cmd) || (GPS_ASSIST_MAX!=((r->max1<<8) | r->max2))) {
+        printf("FAIL! ASSIST_REPORT\r\n");
+        exit(1);
+    }
+    *offset = (r->offset1<<8) | r->offset2;
+    return(r->status);
+}
+
+/* send assistBlob from offset up to end in chunks as a controller would - returns the number of chunks refused
+ */
+static int assistSendFrom(uint16_t size, uint16_t crc, uint16_t offset, uint16_t end) {
+    int refused = 0;
+    while (offset < end) {
+        uint8_t len = (end-offset > GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX) ? GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX : end-offset;
+        if (RECEIVED_FRAME_STATUS_SUCCESS!=assistSend(size, crc, offset, len)) refused++;
+        offset += len;
+    }
+    return(refused);
+}
+
+/* fill assistBlob with n UBX-MGA-ANO messages and a PMTK sentence after every 5th - returns the size
+ */
+static uint16_t assistMake(int n, uint32_t seed) {
+    uint16_t len = 0;
+    for (int i=0; i<n; i++) {
+        uint8_t * m = &assistBlob[len];
+        uint8_t sumA = 0, sumB = 0;
+        m[0] = 0xB5; m[1] = 0x62; m[2] = 0x13; m[3] = 0x20; m[4] = 76; m[5] = 0;
+        for (int j=0; j<76; j++) {
+            seed ^= seed<<13; seed ^= seed>>17; seed ^= seed<<5;
+            m[6+j] = seed;
+        }
+        m[8] = 1+i%32; // svId
+        for (int j=2; j<82; j++) {
+            sumA += m[j];
+            sumB += sumA;
+        }
+        m[82] = sumA;
+        m[83] = sumB;
+        len += 84;
+        if (4==i%5) len += snprintf((char *)&assistBlob[len], sizeof(assistBlob)-len, "$PMTK000*32\r\n");
+    }
+    return(len);
+}
+
+/* the messages the drivers would send - step bytes at a time like a UART Tx FIFO, or whole messages if 0
+ */
+static uint16_t assistFeed(uint8_t * dst, uint16_t max, uint16_t step) {
+    const uint8_t * data;
+    uint16_t len, got = 0;
+    while ((len = GPS_AssistSpan(&data)) > 0) {
+        if (step && (len > step)) len = step;
+        if (got+len > max) break;
+        memcpy(&dst[got], data, len);
+        got += len;
+        GPS_AssistConsume(len);
+    }
+    return(got);
+}
+#endif
+
 int main(void) {
     int index = 0;
     int index_last = 0;
@@ -67,8 +301,8 @@ int main(void) {
             printf("Alt=%06x %f \r\n",GetAltitude(), ((float)GetAltitude())/100);
             switch (TestNum++) {
                 case 1: if (!checkOK(0x7FFFFFFF, 0x7FFFFFFF, 0xFF800000)) exit(1); break;
-                case 2: if (!checkOK(0x186df4cd, 0x0125b1a1, 0xe7a)) exit(1); break; // these were computed manually
-                case 3: if (!checkOK(0x121d89c3, 0xc59ba211, 0xffffde07)) exit(1); break;
+                case 2: if (!checkOK(0x186df4cd, 0x0125b1a1, 0xe74)) exit(1); break; // these were computed manually
+                case 3: if (!checkOK(0x121d89c3, 0xc59ba211, 0xffffde0e)) exit(1); break; // altitudes for 2 & 3 used to include a stray digit left over in tmp[]
                 case 4: if (!checkOK(0xef1259d7, 0x4b9b900a, 0x01a5)) exit(1); break;
                 case 5: if (!checkOK(0xf4862825, 0xea65119d, 0x01129f)) exit(1); break;
                 case 6: if (!checkOK(0xd9139c2e, 0x5355e400, 0x002e23)) exit(1); break;
@@ -90,11 +324,309 @@ int main(void) {
                                 exit(1);
                             }
                         break;
+                case 10: if (!checkOK(0x17a4822c, 0x04485a83, 0x00c328)) exit(1); break;
                 default: printf("not coded yet\r\n"); break;
             }
             index_last=index+1;
         }
     }
+
+    printf("Testing Lifeline Reports:\r\n");
+    for (int i=0; i<GEOLOC_REPORT_CONFIRM; i++) feedGGA("4717.1133547", 1); // settle at the last test position
+    if (0!=feedGGA("4717.1133547", 1)) { printf("FAIL! Report without a change\r\n"); exit(1); }
+    for (int i=0; i<5; i++) { // 10m of jitter
+        if (0!=feedGGA((i&1) ? "4717.1187547" : "4717.1133547", 1)) { printf("FAIL! Report for jitter\r\n"); exit(1); }
+    }
+    if (0!=feedGGA("4717.2213547", 1) + feedGGA("4717.1133547", 1)) { printf("FAIL! Report for a single jump\r\n"); exit(1); }
+    int sent = 0;
+    for (int i=0; i<GEOLOC_REPORT_CONFIRM+2; i++) sent += feedGGA("4717.1673547", 1); // moved 100m
+    if (1!=sent) { printf("FAIL! %d Reports for a 100m move, expected 1\r\n", sent); exit(1); }
+    ticks += GEOLOC_REPORT_HEARTBEAT_S*1000;
+    if (1!=feedGGA("4717.1673547", 1)) { printf("FAIL! no heartbeat Report\r\n"); exit(1); }
+    sent = 0;
+    for (int i=0; i<GEOLOC_REPORT_CONFIRM+2; i++) sent += feedGGA("4717.1673547", 0); // lost the lock
+    if (1!=sent) { printf("FAIL! %d Reports for losing the lock, expected 1\r\n", sent); exit(1); }
+
+#ifdef GEOLOC_TRACK_LOG
+    printf("Testing the track log:\r\n");
+    if (1!=TrackLog_Newest()) { printf("FAIL! the locked fixes above were not logged\r\n"); exit(1); }
+    memset(nvmLen, 0, sizeof(nvmLen));
+    TrackLog_Init(); // erased
+    if ((0!=TrackLog_Newest()) || (0!=TrackLog_Oldest()) || !trackCheck(0, 0)) { printf("FAIL! erased log is not empty\r\n"); exit(1); }
+    GPS_fix_t fix;
+    int points = 0;
+    for (int i=0; i<200; i++) {
+        trackPoint(i, &fix);
+        for (int s=0; s<TRACKLOG_INTERVAL_S; s++, fix.utc = (fix.utc+1000)%86400000) { // 1 Hz fixes - only one per interval is logged
+            if (TrackLog_Add(&fix)) points++;
+        }
+    }
+    if (200!=points) { printf("FAIL! %d points logged, expected 200\r\n", points); exit(1); }
+    uint32_t blocks = TrackLog_Newest();
+    printf("200 points in %u blocks with %d NVM writes\r\n", blocks, nvmWrites);
+    if ((nvmWrites != (int)blocks-1) || (blocks*TRACKLOG_BLOCK_SIZE > 200*sizeof(TrackPoint_t)/2)) { printf("FAIL! points are not batched or not compact\r\n"); exit(1); }
+    if (!trackCheck(0, 200)) exit(1);
+    TrackLog_Flush();
+    TrackLog_Init(); // reset - continues the partial block
+    if ((blocks!=TrackLog_Newest()) || !trackCheck(0, 200)) { printf("FAIL! track lost by a reset\r\n"); exit(1); }
+    for (int i=200; i<1000; i++) {
+        trackPoint(i, &fix);
+        TrackLog_Add(&fix);
+    }
+    uint32_t oldest = TrackLog_Oldest();
+    if (oldest != TrackLog_Newest()-TRACKLOG_BLOCKS+1) { printf("FAIL! oldest block %u after wrapping\r\n", oldest); exit(1); }
+    TrackBlock_t blk;
+    TrackPoint_t pt;
+    if (!TrackLog_ReadBlock(oldest, &blk) || (1!=TrackLog_Decode(&blk, 0, &pt, 1)) || TrackLog_ReadBlock(oldest-1, &blk)) { printf("FAIL! oldest block\r\n"); exit(1); }
+    int first = (pt.time - 49600)/TRACKLOG_INTERVAL_S; // the oldest block stands alone
+    if (!trackCheck(first, 1000)) exit(1);
+    TrackLog_Ack(oldest+9);
+    TrackLog_Flush();
+    TrackLog_Init();
+    if ((oldest+10 != TrackLog_Oldest()) || !TrackLog_ReadBlock(oldest+10, &blk) || (1!=TrackLog_Decode(&blk, 0, &pt, 1))) { printf("FAIL! acknowledged blocks are read again\r\n"); exit(1); }
+    if (!trackCheck((pt.time - 49600)/TRACKLOG_INTERVAL_S, 1000)) exit(1);
+
+    printf("Testing Batch Reports:\r\n");
+    if (0==batchesSent) { printf("FAIL! the logged points were not sent with the Lifeline Reports\r\n"); exit(1); }
+    TrackPoint_t in[40], outPts[40];
+    uint8_t data[255], used;
+    uint32_t x = 12345;
+    for (int round=0; round<1000; round++) { // random points including the extremes - the encoding must be exact
+        for (int i=0; i<40; i++) {
+            x ^= x<<13; x ^= x>>17; x ^= x<<5;
+            int shift = x%32;
+            in[i].time = (round&1) ? x : in[(i>0)?i-1:0].time + (x>>shift);
+            in[i].latitude = (int32_t)(x*2654435761u) >> shift;
+            in[i].longitude = (x&1) ? INT32_MIN : (int32_t)(x*40503u);
+            in[i].altitude = ((int32_t)x >> 8) >> (shift/2);
+            in[i].quality = x%16;
+        }
+        uint8_t size = (round&2) ? sizeof(data) : GEOGRAPHIC_LOCATION_BATCH_DATA_MAX;
+        uint8_t n = TrackLog_Encode(in, 40, data, size, &used);
+        if ((0==n) || (used>size) || (n!=TrackLog_DecodeData(data, used, n, 0, outPts, 40))) { printf("FAIL! round trip of %u points\r\n", n); exit(1); }
+        for (int i=0; i<n; i++) {
+            if ((in[i].time!=outPts[i].time) || (in[i].latitude!=outPts[i].latitude) || (in[i].longitude!=outPts[i].longitude) ||
+                (in[i].altitude!=outPts[i].altitude) || (in[i].quality!=outPts[i].quality)) { printf("FAIL! point %d of the round trip\r\n", i); exit(1); }
+        }
+    }
+    ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME batch;
+    TrackLog_cursor_t cur;
+    TrackPoint_t logged[7];
+    int frames = 0;
+    int drained = 0;
+    uint16_t remaining;
+    TrackLog_Open(&cur);
+    GetBatchReport(&batch, false);
+    if (GetBatchReport(&batch, false) != GetBatchReport(&batch, false)) { printf("FAIL! Batch Report not repeated without the ACK\r\n"); exit(1); }
+    do { // drain the log the way a controller would
+        uint8_t len = GetBatchReport(&batch, frames>0);
+        if ((len > sizeof(batch)) || (GEOGRAPHIC_LOCATION_BATCH_REPORT_V2!=batch.cmd)) { printf("FAIL! Batch Report frame\r\n"); exit(1); }
+        uint8_t n = TrackLog_DecodeData(batch.data, len-5, batch.count, 0, outPts, 40);
+        if (n!=batch.count) { printf("FAIL! Batch Report of %u points decodes to %u\r\n", batch.count, n); exit(1); }
+        for (int i=0; i<n; i++) {
+            if ((1!=TrackLog_Read(&cur, logged, 1)) || (logged[0].time!=outPts[i].time) || (logged[0].latitude!=outPts[i].latitude) ||
+                (logged[0].longitude!=outPts[i].longitude) || (logged[0].altitude!=outPts[i].altitude)) { printf("FAIL! point %d of the drain\r\n", drained+i); exit(1); }
+        }
+        drained += n;
+        frames++;
+        remaining = (batch.remaining1<<8) | batch.remaining2;
+    } while (remaining > 0);
+    if ((0!=TrackLog_Read(&cur, logged, 1)) || (drained < 4*frames)) { printf("FAIL! drained %d points in %d Batch Reports\r\n", drained, frames); exit(1); }
+    printf("%d points in %d Batch Reports of up to %d bytes\r\n", drained, frames, (int)sizeof(batch));
+    if ((0!=GetBatchReport(&batch, true)-5) || (TrackLog_Oldest()!=TrackLog_Newest())) { printf("FAIL! log not acknowledged\r\n"); exit(1); }
+    // a Lifeline Batch Report between a Batch Get and its ACK must not acknowledge the points it had that the Get did not
+    for (int i=1000; i<1002; i++) {
+        trackPoint(i, &fix);
+        TrackLog_Add(&fix);
+    }
+    GetBatchReport(&batch, false); // the controller gets these 2 and has not sent the ACK yet
+    if (2!=batch.count) { printf("FAIL! Batch Report of %u new points, expected 2\r\n", batch.count); exit(1); }
+    for (int i=1002; i<1008; i++) {
+        trackPoint(i, &fix);
+        TrackLog_Add(&fix);
+    }
+    int before = batchesSent;
+    ticks += GEOLOC_REPORT_HEARTBEAT_S*1000;
+    feedGGA("4717.1673547", 1); // the heartbeat Report and the Lifeline Batch Report after it
+    if (before==batchesSent) { printf("FAIL! no Lifeline Batch Report\r\n"); exit(1); }
+    uint8_t len = GetBatchReport(&batch, true);
+    TrackPoint_t want = trackPoint(1002, &fix);
+    if ((0==batch.count) || (1!=TrackLog_DecodeData(batch.data, len-5, batch.count, 0, outPts, 1)) || (outPts[0].time!=want.time)) {
+        printf("FAIL! the ACK after a Lifeline Batch Report skipped points\r\n"); exit(1);
+    }
+#endif
+
+#if defined(GEOLOC_HOT_START) && defined(GEOLOC_TRACK_LOG)
+    printf("Testing the hot start:\r\n");
+    extern const cc_registration_t cc_registration;
+    GPS_aid_t aid;
+    if ((0==GetTTFF()) || (0==aidWrites) || !GPS_GetAiding(&aid)) { printf("FAIL! the first locked fix was not saved\r\n"); exit(1); }
+    ticks += GEOLOC_HOT_START_SAVE_S*1000;
+    feedGGA("4717.1673547", 1);
+    aidWrites = 1; // saved just now
+    for (int i=0; i<20; i++) feedGGA("4717.1673547", 1); // locked fixes within GEOLOC_HOT_START_SAVE_S are kept in RAM
+    if (1!=aidWrites) { printf("FAIL! %d NVM writes for 20 fixes\r\n", aidWrites); exit(1); }
+    GeoLoc_Flush(); // going to sleep
+    GeoLoc_Flush();
+    if (2!=aidWrites) { printf("FAIL! %d NVM writes after a flush\r\n", aidWrites); exit(1); }
+    ticks += GEOLOC_HOT_START_SAVE_S*1000;
+    feedGGA("4717.2213547", 1);
+    feedGGA("4717.2213547", 0); // lost the lock - not saved
+    if (3!=aidWrites) { printf("FAIL! fix not saved after %d s\r\n", GEOLOC_HOT_START_SAVE_S); exit(1); }
+    cc_registration.init(); // reset
+    GPS_aid_t saved;
+    if ((0!=GetTTFF()) || !GPS_GetAiding(&saved) || (saved.latitude!=(int32_t)((47+17.2213547/60)*(1<<23))) ||
+        (saved.longitude!=aid.longitude) || (saved.altitude!=49960) || (saved.utc!=(9*3600+27*60+25)*1000)) {
+        printf("FAIL! saved fix %08x %08x %d %u\r\n", saved.latitude, saved.longitude, saved.altitude, saved.utc); exit(1);
+    }
+    ticks += 1234;
+    feedGGA("4717.2213547", 0);
+    feedGGA("4717.2213547", 1);
+    printf("first fix %u ms after the reset with %d NVM writes\r\n", GetTTFF(), aidWrites);
+    if ((2234!=GetTTFF()) || (4!=aidWrites)) { printf("FAIL! time to first fix\r\n"); exit(1); }
+#endif
+
+#ifdef GEOLOC_ASSIST
+    printf("Testing the assistance data transfer:\r\n");
+    {
+        extern const cc_registration_t cc_registration;
+        static uint8_t fed[sizeof(assistBlob)+100];
+        uint16_t offset;
+        if (0xE5CC!=GPS_AssistCRC(GPS_ASSIST_CRC_INIT, (const uint8_t *)"123456789", 9)) { printf("FAIL! CRC-16\r\n"); exit(1); }
+        uint16_t size = assistMake(19, 0x1234);
+        uint16_t crc = GPS_AssistCRC(GPS_ASSIST_CRC_INIT, assistBlob, size);
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_EMPTY_V2!=assistGet(&offset)) || (0!=offset) || (0!=assistFeed(fed, sizeof(fed), 0))) { printf("FAIL! assistance data before a transfer\r\n"); exit(1); }
+        if ((RECEIVED_FRAME_STATUS_FAIL!=assistSend(size, crc, 38, 38)) || (RECEIVED_FRAME_STATUS_FAIL!=assistSend(GPS_ASSIST_MAX+1, crc, 0, 38))) {
+            printf("FAIL! a transfer started in the middle or too big\r\n"); exit(1);
+        }
+        int writes = assistWrites;
+        if (0!=assistSendFrom(size, crc, 0, 38*10)) { printf("FAIL! chunks refused\r\n"); exit(1); }
+        if ((RECEIVED_FRAME_STATUS_FAIL!=assistSend(size, crc, 38*9, 38)) || (RECEIVED_FRAME_STATUS_FAIL!=assistSend(size, crc, 38*11, 38))) {
+            printf("FAIL! a repeated or skipped chunk was taken\r\n"); exit(1);
+        }
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2!=assistGet(&offset)) || (380!=offset) || (writes+1+2*2!=assistWrites)) { // the start and 2 full blocks
+            printf("FAIL! %u received with %d NVM writes\r\n", offset, assistWrites-writes); exit(1);
+        }
+        GeoLoc_Flush(); // the partial block too
+        GeoLoc_Flush();
+        cc_registration.init();
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2!=assistGet(&offset)) || (380!=offset) || (writes+1+3*2!=assistWrites)) { printf("FAIL! flushed transfer resumes at %u\r\n", offset); exit(1); }
+        assistSendFrom(size, crc, offset, 700);
+        cc_registration.init(); // reset without a flush - resumes after the last full block
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_RECEIVING_V2!=assistGet(&offset)) || (640!=offset)) { printf("FAIL! transfer resumes at %u\r\n", offset); exit(1); }
+        if (0!=assistSendFrom(size, crc, offset, size)) { printf("FAIL! chunks refused after the reset\r\n"); exit(1); }
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=assistGet(&offset)) || (size!=offset)) { printf("FAIL! transfer of %u bytes not valid\r\n", size); exit(1); }
+        printf("%u bytes in %d frames of %d bytes with %d NVM writes\r\n", size, (size+GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX-1)/GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX,
+               (int)offsetof(ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME, data) + GEOGRAPHIC_LOCATION_ASSIST_DATA_MAX, assistWrites-writes);
+        if ((RECEIVED_FRAME_STATUS_SUCCESS!=assistSend(size, crc, 0, 38)) || (GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=assistGet(&offset))) { printf("FAIL! a repeated chunk restarted the transfer\r\n"); exit(1); }
+        if ((size!=assistFeed(fed, sizeof(fed), 0)) || memcmp(fed, assistBlob, size) || (0!=assistFeed(fed, sizeof(fed), 0))) { printf("FAIL! messages fed to the receiver\r\n"); exit(1); }
+        GPS_AssistRewind();
+        if ((size!=assistFeed(fed, sizeof(fed), 5)) || memcmp(fed, assistBlob, size)) { printf("FAIL! messages fed a few bytes at a time\r\n"); exit(1); }
+        cc_registration.init(); // sent again after a reset
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=assistGet(&offset)) || (size!=assistFeed(fed, sizeof(fed), 0))) { printf("FAIL! messages not sent after a reset\r\n"); exit(1); }
+        nvm[NVM_ASSIST+1+5][17] ^= 0x40; // the flash lost a bit
+        cc_registration.init();
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_ERROR_V2!=assistGet(&offset)) || (0!=offset) || (0!=assistFeed(fed, sizeof(fed), 0))) { printf("FAIL! corrupt cache was not found\r\n"); exit(1); }
+        assistSendFrom(size, crc^1, 0, size); // the CRC does not match
+        if ((GEOGRAPHIC_LOCATION_ASSIST_STATUS_ERROR_V2!=assistGet(&offset)) || (0!=offset)) { printf("FAIL! transfer with a bad CRC\r\n"); exit(1); }
+        assistBlob[100] ^= 0x01; // a message with a bad checksum
+        assistSendFrom(size, GPS_AssistCRC(GPS_ASSIST_CRC_INIT, assistBlob, size), 0, size);
+        if (GEOGRAPHIC_LOCATION_ASSIST_STATUS_ERROR_V2!=assistGet(&offset)) { printf("FAIL! transfer of a bad message\r\n"); exit(1); }
+        size = assistMake(19, 0x5678); // the same size with a new CRC is a new transfer
+        crc = GPS_AssistCRC(GPS_ASSIST_CRC_INIT, assistBlob, size);
+        if ((0!=assistSendFrom(size, crc, 0, size)) || (GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=assistGet(&offset)) ||
+            (size!=assistFeed(fed, sizeof(fed), 0)) || memcmp(fed, assistBlob, size)) { printf("FAIL! new transfer\r\n"); exit(1); }
+    }
+#endif
+
+#if defined(GEOLOC_TRACK_LOG) && defined(GEOLOC_HOT_START) && defined(GEOLOC_ASSIST)
+    printf("Testing the factory reset:\r\n");
+    {
+        extern const cc_registration_t cc_registration;
+        ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME batch;
+        GPS_aid_t aid;
+        uint16_t offset;
+        feedGGA("4717.1673547", 1);
+        if ((0==TrackLog_Newest()) || !GPS_GetAiding(&aid) || (GEOGRAPHIC_LOCATION_ASSIST_STATUS_VALID_V2!=assistGet(&offset))) { printf("FAIL! nothing to erase\r\n"); exit(1); }
+        for (int boot=0; boot<2; boot++) { // erased in RAM then still erased after a reset
+            if (1==boot) cc_registration.init(); else cc_registration.reset();
+            GetBatchReport(&batch, false);
+            if ((0!=TrackLog_Newest()) || (0!=batch.count) || GPS_GetAiding(&aid) || (GEOGRAPHIC_LOCATION_ASSIST_STATUS_EMPTY_V2!=assistGet(&offset))) {
+                printf("FAIL! %s the factory reset\r\n", boot ? "restored after" : "kept by"); exit(1);
+            }
+        }
+    }
+#endif
+
+    printf("Testing the statistics:\r\n");
+    {
+        extern const cc_registration_t cc_registration;
+        static ZW_APPLICATION_TX_BUFFER rx, tx;
+        static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+        cc_handler_input_t in = {&rx, &rxOpt, 2};
+        cc_handler_output_t out = {&tx, 0};
+        const ZW_GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2_FRAME * f = &tx.ZW_GeographicLocationStatisticsReportV2Frame;
+        static const char noise[] = "$GPGSV,3,1,12,01,40,083,46*70\r\n"  // not a type the parser uses
+            "$GPGGA,221800.175,7750.807777,S,16640.261234,E,1,12,1.0,118,M,0.0,M,,*66\r\n"; // bad checksum
+        GPS_stats_t stats;
+        cc_registration.init();
+        GetStats(&stats);
+        if ((0!=stats.sentences) || (0!=stats.fixes) || (0xFFFFFFFF!=stats.age)) { printf("FAIL! counters not cleared by a reset\r\n"); exit(1); }
+        feedGGA("4717.1133547", 1);
+        NMEA_feed((const uint8_t *)noise, sizeof(noise)-1);
+        NMEA_feed((const uint8_t *)"$GPGGA,", 7);
+        for (int i=0; i<150; i++) NMEA_build((0==i%10) ? ',' : '1'); // longer than the sentence buffer
+        GPS_StatsBusError(true);
+        GPS_StatsBusError(false);
+        ticks += 4000;
+        rx.ZW_Common.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+        rx.ZW_Common.cmd = GEOGRAPHIC_LOCATION_STATISTICS_GET_V2;
+        if ((RECEIVED_FRAME_STATUS_SUCCESS!=cc_registration.handler(&in, &out)) || (sizeof(*f)!=out.length) ||
+            (GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2!=f->cmd)) { printf("FAIL! Statistics Report\r\n"); exit(1); }
+        #define STAT32(field) ((uint32_t)f->field##1<<24 | (uint32_t)f->field##2<<16 | (uint32_t)f->field##3<<8 | f->field##4)
+        printf("%u sentences %u accepted %u rejected %u checksum %u overruns %u fixes %u bus errors %u NACKs, last fix %u s ago in %d bytes\r\n",
+               STAT32(sentences), STAT32(accepted), STAT32(rejected), STAT32(checksum), STAT32(overruns), STAT32(fixes), STAT32(busErrors),
+               STAT32(nacks), (f->age1<<8) | f->age2, out.length);
+        if ((4!=STAT32(sentences)) || (1!=STAT32(accepted)) || (1!=STAT32(rejected)) || (1!=STAT32(checksum)) || (1!=STAT32(overruns)) ||
+            (1!=STAT32(fixes)) || (2!=STAT32(busErrors)) || (1!=STAT32(nacks)) || (0!=STAT32(drops)) || (5!=((f->age1<<8) | f->age2))) {
+            printf("FAIL! statistics\r\n"); exit(1);
+        }
+    }
+
+    printf("Testing the age of the fix:\r\n");
+    {
+        extern const cc_registration_t cc_registration;
+        static ZW_APPLICATION_TX_BUFFER rx, tx;
+        static RECEIVE_OPTIONS_TYPE_EX rxOpt;
+        cc_handler_input_t in = {&rx, &rxOpt, 2};
+        cc_handler_output_t out = {&tx, 0};
+        const ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME * r = &tx.ZW_GeographicLocationAgeReportV2Frame;
+        static const uint32_t wait[] = {0, GEOLOC_FIX_MAX_AGE_S*1000-1000, 1001, 0}; // fresh, the oldest that is still good, stale, bad checksum
+        static const uint16_t wantAge[] = {1, GEOLOC_FIX_MAX_AGE_S, GEOLOC_FIX_MAX_AGE_S+1, 0xFFFF};
+        static const uint8_t wantQual[] = {12, 12, 0, 1};
+        rx.ZW_Common.cmdClass = COMMAND_CLASS_GEOGRAPHIC_LOCATION;
+        feedGGA("4717.1133547", 1); // 09:27:25 UTC - a second passes after it
+        for (int i=0; i<4; i++) {
+            ticks += wait[i];
+            if (3==i) NMEA_feed((const uint8_t *)"$GPGGA,221800.175,7750.807777,S,16640.261234,E,1,12,1.0,118,M,0.0,M,,*66\r\n", 76);
+            rx.ZW_Common.cmd = GEOGRAPHIC_LOCATION_GET_V2; // the Report stays 14 bytes - only its Qual goes to 0 when the fix is stale
+            cc_registration.handler(&in, &out);
+            if ((14!=out.length) || (GEOGRAPHIC_LOCATION_REPORT_V2!=tx.ZW_Common.cmd) || (wantQual[i]!=(tx.ZW_GeographicLocationReportV2Frame.status>>4))) {
+                printf("FAIL! Report of a fix %u ms old\r\n", wait[i]); exit(1);
+            }
+            rx.ZW_Common.cmd = GEOGRAPHIC_LOCATION_AGE_GET_V2;
+            cc_registration.handler(&in, &out);
+            uint16_t age = (r->age1<<8) | r->age2;
+            uint32_t utc = (uint32_t)r->time1<<16 | r->time2<<8 | r->time3;
+            printf("Age Report after %u ms: age %u s, UTC %u s, Qual %u in %d bytes\r\n", wait[i], age, utc, r->status>>4, out.length);
+            if ((19!=out.length) || (GEOGRAPHIC_LOCATION_AGE_REPORT_V2!=r->cmd) || (wantAge[i]!=age) || (wantQual[i]!=(r->status>>4)) ||
+                (((3==i) ? 0xFFFFFF : 9*3600+27*60+25) != utc) || ((i<2) && !checkOK(0x17a4822c, 0x04485a83, 0x00c328)) ||
+                ((2==i) && ((0x17!=r->latitude1) || (0x83!=r->longitude4)))) { // a stale fix keeps its coordinates
+                printf("FAIL! age of the fix\r\n"); exit(1);
+            }
+        }
+    }
+
     printf("Tests PASS\r\n");
     exit(0);
 }
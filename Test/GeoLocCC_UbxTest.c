@@ -0,0 +1,99 @@
+/* Test of the UBX framer of SAM-M8Q.c (SAM_M8Q_UBX) - a header with a length no message the driver reads can have
+ * (a corrupted length byte or a false B5 62 sync) is dropped at once so the NAV-PVT right after it is still parsed.
+ * Build and run with make test in this folder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ZAF_types.h"
+#include "CC_GeographicLoc.h"
+#include <ZW_TransportMulticast.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include "SAM-M8Q.h"
+
+#ifndef SAM_M8Q_UBX
+#error "build with -DSAM_M8Q_UBX"
+#endif
+
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt) { // not testing multicast
+    return(false);
+}
+TickType_t xTaskGetTickCount(void) {
+    return(0);
+}
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult)) {
+    return(JOB_STATUS_SUCCESS);
+}
+I2C_TransferReturn_TypeDef GPS_I2CTransfer(I2C_TransferSeq_TypeDef * seq) { // the driver is not polled - only the framer and the decoder are used
+    return(i2cTransferNack);
+}
+
+uint8_t * NMEA_sentence;
+void NMEA_Init( uint8_t * ptr) {
+    NMEA_sentence=ptr;
+}
+
+extern const cc_registration_t cc_registration;
+
+// a NAV-PVT frame with a 3D fix of 8 satellites at 47.2852395N 8.5652537E 499.6m - returns the length
+static int buildPVT(uint8_t * f) {
+    uint8_t * pl = &f[6];
+    uint8_t a = 0, b = 0;
+    memset(f, 0, 8+UBX_NAV_PVT_LEN);
+    f[0] = UBX_SYNC1;
+    f[1] = UBX_SYNC2;
+    f[2] = UBX_CLASS_NAV;
+    f[3] = UBX_NAV_PVT;
+    f[4] = UBX_NAV_PVT_LEN;
+    pl[20] = 3;     // fixType 3D
+    pl[21] = 0x01;  // gnssFixOK
+    pl[23] = 8;     // numSV
+    int32_t lon = 85652537, lat = 472852395, hmsl = 499600;
+    memcpy(&pl[24], &lon, 4); // little endian like the host
+    memcpy(&pl[28], &lat, 4);
+    memcpy(&pl[36], &hmsl, 4);
+    for (int i=2; i<6+UBX_NAV_PVT_LEN; i++) {
+        a += f[i];
+        b += a;
+    }
+    f[6+UBX_NAV_PVT_LEN] = a;
+    f[7+UBX_NAV_PVT_LEN] = b;
+    return(8+UBX_NAV_PVT_LEN);
+}
+
+// feed the bytes to the framer and decode each NAV-PVT it completes - returns the number completed
+static int feed(const uint8_t * buf, int len) {
+    int n = 0;
+    for (int i=0; i<len; i++) {
+        if (UBX_build(buf[i])) {
+            UBX_parsePVT();
+            n++;
+        }
+    }
+    return(n);
+}
+
+int main(void) {
+    static const uint8_t bogus[] = {UBX_SYNC1, UBX_SYNC2, UBX_CLASS_NAV, UBX_NAV_PVT, 0xFF, 0xFF}; // 65535 byte payload
+    static const uint8_t ack[] = {UBX_SYNC1, UBX_SYNC2, 0x05, 0x01, 0x02, 0x00, 0x06, 0x00, 0x0E, 0x37}; // UBX-ACK-ACK of CFG-PRT
+    uint8_t pvt[8+UBX_NAV_PVT_LEN];
+    GPS_stats_t stats;
+    int len = buildPVT(pvt);
+    printf("Testing the UBX framer:\r\n");
+    cc_registration.init();
+    if ((0!=feed(ack, sizeof(ack))) || (1!=feed(pvt, len)) || (1!=GetFixCount()) || (0x17a482ba!=GetLatitude())) {
+        printf("FAIL! NAV-PVT after an ACK\r\n"); exit(1);
+    }
+    GetStats(&stats);
+    if (0!=stats.checksum) { printf("FAIL! %u checksum errors on good frames\r\n", stats.checksum); exit(1); }
+    if ((0!=feed(bogus, sizeof(bogus))) || (1!=feed(pvt, len)) || (2!=GetFixCount())) {
+        printf("FAIL! NAV-PVT after a header with a length of 0xFFFF\r\n"); exit(1);
+    }
+    GetStats(&stats);
+    if (1!=stats.checksum) { printf("FAIL! %u checksum errors for the bad length, expected 1\r\n", stats.checksum); exit(1); }
+    printf("Tests PASS\r\n");
+    return(0);
+}
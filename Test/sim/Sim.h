@@ -0,0 +1,78 @@
+/* Host simulation of the GPS receivers and the EUSART so the real drivers run on Linux - see GeoLocCC_Sim.c
+ * The headers in this folder stand in for the SDK ones the drivers include. Time is simulated in microseconds
+ * and only moves when the simulation loop says so: the I2C transfers take their bus time, the CPU takes none.
+ *
+ * The receiver replays a corpus file one epoch at a time. An epoch is measured every period, its output starts
+ * delayMs later and the bytes come out at baud/10 per second in a continuous stream so a slow line falls behind.
+ * The fix latency is the time from the start of the output of an epoch to the fix of that epoch being published.
+ * A receiver put to sleep outputs nothing until it wakes and then for ttffMs while it reacquires. After power up it is
+ * silent for coldMs while it searches the sky, or for ttffMs from the aiding (UBX-MGA-INI or PMTK741) if that is sooner.
+ * Assistance data (UBX-MGA-ANO or PMTK721) with a good checksum cuts the search the same way - a bad one is counted and ignored.
+ * From lostMs on the receiver has no lock (it is taken indoors) - every epoch has a GGA with quality 0 or a NAV-PVT with no fix.
+ */
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_NEVER UINT64_MAX
+
+extern uint64_t sim_now;    // simulated time in microseconds
+
+typedef struct SimConfig
+{
+    uint32_t periodMs;      // measurement period of the receiver until the driver configures it
+    uint32_t baud;          // serial line of the EUSART, or the rate the I2C buffer of the receiver fills at
+    uint32_t delayMs;       // time from the measurement to the first byte of the epoch
+    uint32_t phaseMs;       // time of the first measurement
+    uint32_t bufSize;       // I2C buffer of the receiver - bytes that don't fit are dropped
+    uint32_t i2cHz;         // I2C clock
+    uint32_t maskUs;        // EUSART interrupts are blocked this long ...
+    uint32_t maskPeriodMs;  // ... every this many ms (radio or flash critical sections)
+    uint32_t appUs;         // time from an event being queued to the application task handling it
+    uint32_t ttffMs;        // time from waking the receiver to its first output - it reacquires the satellites
+    uint32_t getMs;         // a GET is received this often (0 = none)
+    uint32_t coldMs;        // time from power up to the first output without aiding - cut to ttffMs by aiding
+    uint32_t lostMs;        // time the lock is lost for good (0 = never)
+} SimConfig_t;
+extern SimConfig_t sim_cfg;
+
+typedef struct SimStats
+{
+    uint32_t epochs;        // epochs the receiver sent
+    uint32_t fixes;         // fixes published by the command class
+    uint32_t matched;       // fixes matched to their epoch by the UTC time - these have a latency
+    uint32_t latency[1024]; // us of each matched fix
+    uint32_t transfers;     // I2C transactions
+    uint32_t busBytes;      // bytes on the I2C bus including the addresses
+    uint32_t padBytes;      // filler bytes read when the receiver had no data
+    uint32_t dropped;       // bytes lost in the receiver because its I2C buffer was full
+    uint32_t hwOverruns;    // bytes lost in the EUSART hardware FIFO
+    uint32_t irqs;          // EUSART interrupts
+    uint32_t sleeps;        // times the receiver was put to sleep
+    uint32_t lostSleeps;    // ... after the lock was lost
+    uint64_t sleptUs;       // time it slept
+    uint32_t gets;          // GETs received
+    uint32_t aids;          // aiding messages received
+    uint32_t assists;       // assistance data messages received with a good checksum
+    uint32_t assistBad;     // ... and with a bad one
+} SimStats_t;
+extern SimStats_t sim_stats;
+
+// SimGPS.c - the receiver
+bool SimGPS_Load(const char * file);    // split the corpus into epochs - false if it can't be read
+uint64_t SimGPS_Next(void);             // time the next output byte is ready - SIM_NEVER after the last epoch
+uint8_t SimGPS_Pop(void);               // the next output byte
+uint32_t SimGPS_PeriodMs(void);         // measurement period - set by the configuration the driver sends
+uint64_t SimGPS_LastEpoch(void);        // start of the output of the latest epoch
+void SimGPS_CheckFix(void);             // record the latency if a new fix was published
+uint32_t SimGPS_Buffered(void);         // bytes waiting in the I2C buffer of the receiver
+bool SimGPS_FirstFix(int32_t * lat, int32_t * lon, int32_t * alt, uint32_t * utc, uint32_t * date); // the first locked GGA, the time of the first epoch and the RMC date
+
+// SimEUSART.c - EUSART1 and its receive interrupt
+void SimEUSART_Init(void);
+uint64_t SimEUSART_Next(void);          // time of the next byte, idle timeout or deferred interrupt - SIM_NEVER when done
+void SimEUSART_Step(void);              // do what is due at sim_now
+
+#endif
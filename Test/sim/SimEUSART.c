@@ -0,0 +1,123 @@
+/* Simulated EUSART1 receiver - the bytes of the simulated GPS arrive on the line at the baud rate and go into the
+ * 16 byte hardware FIFO. RXFL is flagged for each byte and RXOF when the FIFO is full. RXTO is flagged once the line
+ * has been idle for the frames set in CFG1. The interrupt handler of UART_DRZ.c runs as soon as an enabled flag is set
+ * unless interrupts are blocked (sim_cfg.maskUs every sim_cfg.maskPeriodMs) in which case it runs when they are unblocked.
+ */
+
+#include "Sim.h"
+#include <em_eusart.h>
+#include <em_gpio.h>
+#include <em_cmu.h>
+
+#define HW_FIFO_DEPTH 16
+
+void EUSART1_RX_IRQHandler(void);
+
+EUSART_TypeDef sim_eusart[3];
+GPIO_TypeDef sim_gpio;
+
+static uint8_t fifo[HW_FIFO_DEPTH];
+static uint8_t fifoHead;
+static uint8_t fifoCount;
+static uint64_t lastByte;   // time the last byte was received
+static bool idleArmed;      // RXTO is flagged once the line has been idle long enough after lastByte
+
+// RXDATA - pop the hardware FIFO
+static uint32_t rxdata(void) {
+    uint8_t c = 0;
+    if (fifoCount>0) {
+        c = fifo[(fifoHead + HW_FIFO_DEPTH - fifoCount) % HW_FIFO_DEPTH];
+        fifoCount--;
+    }
+    if (0==fifoCount) EUSART1->STATUS &= ~EUSART_STATUS_RXFL;
+    return(c);
+}
+
+void SimEUSART_Init(void) {
+    EUSART1->RXDATA_read = rxdata;
+    EUSART1->STATUS = EUSART_STATUS_TXFL;
+}
+
+// idle time that flags RXTO in us - SIM_NEVER if disabled
+static uint64_t idleTimeout(void) {
+    static const uint8_t frames[8] = {0, 1, 2, 3, 5, 7, 7, 7};
+    uint32_t n = frames[(EUSART1->CFG1 & _EUSART_CFG1_RXTIMEOUT_MASK) >> _EUSART_CFG1_RXTIMEOUT_SHIFT];
+    return(n ? (uint64_t)n*10000000/sim_cfg.baud : SIM_NEVER);
+}
+
+static bool masked(uint64_t t) {
+    return(sim_cfg.maskUs && sim_cfg.maskPeriodMs && ((t % (sim_cfg.maskPeriodMs*1000ull)) < sim_cfg.maskUs));
+}
+
+static bool irqPending(void) {
+    return(0 != (EUSART1->IF & (EUSART1->IEN | EUSART1->IEN_SET)));
+}
+
+uint64_t SimEUSART_Next(void) {
+    uint64_t next = SimGPS_Next();
+    if (idleArmed && (SIM_NEVER!=idleTimeout()) && (lastByte + idleTimeout() < next)) {
+        next = lastByte + idleTimeout();
+    }
+    if (irqPending() && masked(sim_now)) { // blocked - runs when the critical section ends
+        uint64_t end = sim_now - sim_now % (sim_cfg.maskPeriodMs*1000ull) + sim_cfg.maskUs;
+        if (end < next) next = end;
+    }
+    return(next);
+}
+
+void SimEUSART_Step(void) {
+    if (SimGPS_Next() <= sim_now) {
+        uint8_t c = SimGPS_Pop();
+        if (fifoCount < HW_FIFO_DEPTH) {
+            fifo[fifoHead] = c;
+            fifoHead = (fifoHead+1) % HW_FIFO_DEPTH;
+            fifoCount++;
+            EUSART1->STATUS |= EUSART_STATUS_RXFL;
+            EUSART1->IF |= EUSART_IF_RXFL;
+        } else {
+            EUSART1->IF |= EUSART_IF_RXOF;
+            sim_stats.hwOverruns++;
+        }
+        lastByte = sim_now;
+        idleArmed = true;
+    } else if (idleArmed && (sim_now >= lastByte + idleTimeout())) {
+        EUSART1->IF |= EUSART_IF_RXTO;
+        idleArmed = false;
+    }
+    if (irqPending() && !masked(sim_now)) {
+        sim_stats.irqs++;
+        EUSART1_RX_IRQHandler();
+        EUSART1->IF &= ~EUSART1->IF_CLR;
+        EUSART1->IF_CLR = 0;
+    }
+}
+
+// emlib functions used by UART_Init()
+void EUSART_Enable(EUSART_TypeDef *eusart, EUSART_Enable_TypeDef enable) {
+    (void)eusart;
+    (void)enable;
+}
+void EUSART_BaudrateSet(EUSART_TypeDef *eusart, uint32_t refFreq, uint32_t baudrate) {
+    (void)refFreq;
+    if ((EUSART1==eusart) && baudrate) sim_cfg.baud = baudrate; // the receiver is set to the same rate
+}
+void NVIC_EnableIRQ(IRQn_Type irq) {
+    (void)irq;
+}
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+    (void)irq;
+}
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref) {
+    (void)clock;
+    (void)ref;
+}
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) {
+    (void)clock;
+    (void)enable;
+}
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) {
+    (void)port;
+    (void)pin;
+    (void)mode;
+    (void)out;
+}
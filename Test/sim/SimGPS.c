@@ -0,0 +1,477 @@
+/* Simulated GPS receivers - the corpus replayed as the output of a receiver, and the I2C side of the u-blox and MTK modules.
+ * u-blox DDC (address 0x42): registers 0xFD/0xFE hold the number of bytes waiting, latched when the read starts,
+ *   0xFF is the data stream which reads 0xFF when empty. A one byte write sets the register address,
+ *   longer writes are messages to the receiver. UBX-CFG-RATE sets the period and UBX-CFG-PRT with UBX only output
+ *   switches each epoch to one NAV-PVT message built from the GGA sentence of the epoch.
+ *   UBX-RXM-PMREQ puts it in backup for the duration - it NACKs and outputs nothing, and wakes up with the default configuration.
+ * MTK XA1110 (address 0x10): reads return the waiting bytes padded with 0x0A, PMTK220 sets the period.
+ *   PMTK161 puts it in standby until the next write.
+ * UBX-MGA-INI and PMTK741 aiding cut the cold start to sim_cfg.ttffMs. So does assistance data (UBX-MGA-ANO, PMTK721) if its checksum is good.
+ * Both buffer bytes up to sim_cfg.bufSize and drop the rest.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Sim.h"
+#include <sl_i2cspm.h>
+#include "CC_GeographicLoc.h"
+
+#define SIM_MAX_EPOCHS 4096
+#define SIM_BUF_MAX 65536
+#define UBLOX_ADDR 0x42
+#define MTK_ADDR 0x10
+
+I2C_TypeDef sim_i2c;
+
+typedef struct SimEpoch
+{
+    uint32_t start;         // offset in the corpus
+    uint32_t len;
+    uint32_t utc;           // ms since midnight of the first sentence with a time, GPS_UTC_INVALID if none
+} SimEpoch_t;
+
+static uint8_t * corpus;
+static SimEpoch_t epochs[SIM_MAX_EPOCHS];
+static uint32_t epochCount;
+static uint64_t epochOut[SIM_MAX_EPOCHS]; // start of the output of each epoch
+
+// the output stream of the receiver
+static uint32_t periodMs;           // sim_cfg.periodMs until the driver configures the receiver
+static bool ubxOut;                 // NAV-PVT instead of NMEA
+static uint32_t epochNext;          // next epoch to send
+static uint64_t measure;            // time of the next measurement
+static const uint8_t * out;         // bytes of the epoch being sent
+static uint32_t outLen;
+static uint32_t outPos;
+static uint8_t pvt[100];            // UBX NAV-PVT frame
+static uint8_t noLock[8192];        // the NMEA epoch with the GGA of a receiver that lost the lock
+static uint64_t runStart;           // the line has been busy since this time ...
+static uint32_t runBytes;           // ... sending this many bytes
+
+// I2C buffer of the receiver
+static uint8_t devBuf[SIM_BUF_MAX];
+static uint32_t devHead;
+static uint32_t devTail;
+static uint8_t ubloxReg = 0xFF;
+
+// sleep of the receiver - no output from sleepFrom until quietUntil, the end of the sleep plus sim_cfg.ttffMs
+static uint64_t sleepFrom = SIM_NEVER;
+static uint64_t wakeAt;             // SIM_NEVER until an MTK receiver is written to
+static uint64_t quietUntil;
+
+// return the NMEA time hhmmss.sss at p in ms since midnight
+static uint32_t utcOf(const char * p) {
+    if ((p[0]<'0') || (p[0]>'9')) return(GPS_UTC_INVALID);
+    uint32_t hms = 0;
+    for (int i=0; i<6; i++) hms = hms*10 + (p[i]-'0');
+    uint32_t ms = 0;
+    if ('.'==p[6]) {
+        uint32_t scale = 100;
+        for (int i=7; (p[i]>='0') && (p[i]<='9'); i++, scale/=10) ms += (p[i]-'0')*scale;
+    }
+    return(((hms/10000)*3600 + ((hms/100)%100)*60 + hms%100)*1000 + ms);
+}
+
+// address of field n (0 is the sentence type) of the sentence at s
+static const char * field(const char * s, int n) {
+    while (n>0 && ('\n'!=*s) && ('\0'!=*s)) {
+        if (','==*s++) n--;
+    }
+    return(s);
+}
+
+bool SimGPS_Load(const char * file) {
+    FILE * f = fopen(file, "rb");
+    if (NULL==f) return(false);
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    corpus = malloc(len+1);
+    if ((NULL==corpus) || (fread(corpus, 1, len, f) != (size_t)len)) {
+        fclose(f);
+        return(false);
+    }
+    fclose(f);
+    corpus[len] = '\0';
+
+    // an epoch starts with each sentence of the same type as the first one
+    char first[4] = "";
+    epochCount = 0;
+    for (long i=0; i<len; ) {
+        const char * line = (const char *)&corpus[i];
+        const char * end = strchr(line, '\n');
+        long next = end ? (end - (const char *)corpus) + 1 : len;
+        if ('$'==line[0] && (next-i > 6)) {
+            if ('\0'==first[0]) memcpy(first, &line[3], 3);
+            if ((0==memcmp(first, &line[3], 3)) && (epochCount<SIM_MAX_EPOCHS)) {
+                epochs[epochCount].start = i;
+                epochs[epochCount].utc = GPS_UTC_INVALID;
+                epochCount++;
+            }
+            if ((epochCount>0) && (GPS_UTC_INVALID==epochs[epochCount-1].utc) &&
+                ((0==memcmp(&line[3], "GGA", 3)) || (0==memcmp(&line[3], "RMC", 3)))) {
+                epochs[epochCount-1].utc = utcOf(field(line, 1));
+            }
+        }
+        if (epochCount>0) epochs[epochCount-1].len = next - epochs[epochCount-1].start;
+        i = next;
+    }
+    measure = (uint64_t)sim_cfg.phaseMs*1000;
+    periodMs = sim_cfg.periodMs;
+    if (sim_cfg.coldMs) { // searching the sky from power up
+        sleepFrom = 0;
+        wakeAt = 0;
+        quietUntil = (uint64_t)sim_cfg.coldMs*1000;
+    }
+    return(epochCount>0);
+}
+
+bool SimGPS_FirstFix(int32_t * lat, int32_t * lon, int32_t * alt, uint32_t * utc, uint32_t * date) {
+    bool found = false;
+    *utc = epochCount ? epochs[0].utc : GPS_UTC_INVALID;
+    *date = 0;
+    for (const char * line = (const char *)corpus; line && *line; line = strchr(line, '\n'), line = line ? line+1 : NULL) {
+        if ((0==*date) && (0==memcmp(&line[3], "RMC", 3))) {
+            const char * d = field(line, 9);
+            if ((d[0]>='0') && (d[0]<='9')) *date = atoi(d);
+        }
+        if (!found && (0==memcmp(&line[3], "GGA", 3)) && (atoi(field(line, 6)) > 0)) {
+            double la = atof(field(line, 2));
+            double lo = atof(field(line, 4));
+            la = (int)(la/100) + (la - 100*(int)(la/100))/60;
+            lo = (int)(lo/100) + (lo - 100*(int)(lo/100))/60;
+            if ('S'==*field(line, 3)) la = -la;
+            if ('W'==*field(line, 5)) lo = -lo;
+            *lat = (int32_t)(la*(1<<23));
+            *lon = (int32_t)(lo*(1<<23));
+            *alt = (int32_t)(atof(field(line, 9))*100);
+            found = true;
+        }
+        if (found && *date) break;
+    }
+    return(found);
+}
+
+static void put32(uint8_t * p, uint32_t v) {
+    p[0] = v;
+    p[1] = v>>8;
+    p[2] = v>>16;
+    p[3] = v>>24;
+}
+
+// build the NAV-PVT frame of the epoch from its GGA sentence - returns the length. With no lock there is no fix
+static uint32_t buildPVT(const SimEpoch_t * e, bool lock) {
+    uint8_t * pl = &pvt[6];
+    memset(pvt, 0, sizeof(pvt));
+    pvt[0] = 0xB5;
+    pvt[1] = 0x62;
+    pvt[2] = 0x01;  // NAV
+    pvt[3] = 0x07;  // PVT
+    pvt[4] = 92;
+    const char * gga = (const char *)&corpus[e->start];
+    const char * end = gga + e->len;
+    while ((gga<end) && (0!=memcmp(&gga[3], "GGA", 3))) {
+        gga = strchr(gga, '\n');
+        gga = gga ? gga+1 : end;
+    }
+    if (gga<end) {
+        uint32_t utc = utcOf(field(gga, 1));
+        int qual = lock ? atoi(field(gga, 6)) : 0;
+        int sats = atoi(field(gga, 7));
+        double lat = atof(field(gga, 2));
+        double lon = atof(field(gga, 4));
+        lat = (int)(lat/100) + (lat - 100*(int)(lat/100))/60;
+        lon = (int)(lon/100) + (lon - 100*(int)(lon/100))/60;
+        if ('S'==*field(gga, 3)) lat = -lat;
+        if ('W'==*field(gga, 5)) lon = -lon;
+        if (GPS_UTC_INVALID!=utc) {
+            put32(&pl[0], utc);     // iTOW - only the ms are used
+            pl[8] = utc/3600000;
+            pl[9] = (utc/60000)%60;
+            pl[10] = (utc/1000)%60;
+            pl[11] = 0x02;          // validTime
+        }
+        pl[20] = qual ? 3 : 0;      // fixType 3D
+        pl[21] = qual ? 1 : 0;      // gnssFixOK
+        pl[23] = sats;
+        put32(&pl[24], (int32_t)(lon*1e7));
+        put32(&pl[28], (int32_t)(lat*1e7));
+        put32(&pl[36], (int32_t)(atof(field(gga, 9))*1000));
+        pl[76] = (uint8_t)(atof(field(gga, 8))*100);
+        pl[77] = (uint16_t)(atof(field(gga, 8))*100)>>8;
+    }
+    uint8_t a = 0, b = 0;
+    for (int i=2; i<98; i++) {
+        a += pvt[i];
+        b += a;
+    }
+    pvt[98] = a;
+    pvt[99] = b;
+    return(sizeof(pvt));
+}
+
+// copy the NMEA epoch with each GGA replaced by one without a fix at the same time - returns the length
+static uint32_t buildNoLock(const SimEpoch_t * e) {
+    const char * line = (const char *)&corpus[e->start];
+    const char * end = line + e->len;
+    uint32_t len = 0;
+    while (line<end) {
+        const char * next = strchr(line, '\n');
+        next = (next && (next<end)) ? next+1 : end;
+        if ((next-line > 17) && (0==memcmp(&line[3], "GGA,", 4))) {
+            char s[64];
+            uint8_t sum = 0;
+            int n = snprintf(s, sizeof(s), "%.*s,,,,,0,00,99.99,,,,,,", (int)(strchr(&line[7], ',') - &line[1]), &line[1]);
+            for (int i=0; i<n; i++) sum ^= s[i];
+            if (len + n + 6 <= sizeof(noLock)) len += sprintf((char *)&noLock[len], "$%s*%02X\r\n", s, sum);
+        } else if (len + (next-line) <= sizeof(noLock)) {
+            memcpy(&noLock[len], line, next-line);
+            len += next-line;
+        }
+        line = next;
+    }
+    return(len);
+}
+
+uint64_t SimGPS_Next(void) {
+    while (outPos>=outLen) { // start the next epoch
+        if (epochNext>=epochCount) return(SIM_NEVER);
+        const SimEpoch_t * e = &epochs[epochNext];
+        uint64_t start = measure + (uint64_t)sim_cfg.delayMs*1000;
+        bool lock = (0==sim_cfg.lostMs) || (start < (uint64_t)sim_cfg.lostMs*1000);
+        if (ubxOut) {
+            out = pvt;
+            outLen = buildPVT(e, lock);
+        } else if (!lock) {
+            out = noLock;
+            outLen = buildNoLock(e);
+        } else {
+            out = &corpus[e->start];
+            outLen = e->len;
+        }
+        outPos = 0;
+        if (start > runStart + (uint64_t)runBytes*10000000/sim_cfg.baud) { // the line is idle - a new run of bytes
+            runStart = start;
+            runBytes = 0;
+        }
+        epochOut[epochNext++] = start;
+        measure += (uint64_t)periodMs*1000;
+        sim_stats.epochs++;
+    }
+    return(runStart + (uint64_t)(runBytes+1)*10000000/sim_cfg.baud);
+}
+
+uint8_t SimGPS_Pop(void) {
+    if (SIM_NEVER==SimGPS_Next()) return(0);
+    runBytes++;
+    return(out[outPos++]);
+}
+
+uint32_t SimGPS_PeriodMs(void) {
+    return(periodMs);
+}
+
+uint64_t SimGPS_LastEpoch(void) {
+    return(epochNext ? epochOut[epochNext-1] : 0);
+}
+
+uint32_t SimGPS_Buffered(void) {
+    return(devHead - devTail);
+}
+
+void SimGPS_CheckFix(void) {
+    static uint32_t fixCount;
+    static uint32_t matchFrom;
+    GPS_fix_t fix;
+    if (GetFixCount()==fixCount) return;
+    sim_stats.fixes += GetFixCount() - fixCount;
+    fixCount = GetFixCount();
+    GetFix(&fix);
+    if (GPS_UTC_INVALID==fix.utc) return;
+    for (uint32_t k=matchFrom; k<epochNext; k++) {
+        if (epochs[k].utc==fix.utc) {
+            if (sim_stats.matched < sizeof(sim_stats.latency)/sizeof(sim_stats.latency[0])) {
+                sim_stats.latency[sim_stats.matched++] = sim_now - epochOut[k];
+            }
+            matchFrom = k+1;
+            break;
+        }
+    }
+}
+
+static bool asleep(void) {
+    return((sim_now >= sleepFrom) && (sim_now < wakeAt));
+}
+
+static void rxSleep(uint64_t until) {
+    sleepFrom = sim_now;
+    wakeAt = until;
+    quietUntil = (SIM_NEVER==until) ? SIM_NEVER : until + (uint64_t)sim_cfg.ttffMs*1000;
+    sim_stats.sleeps++;
+    if (sim_cfg.lostMs && (sim_now >= (uint64_t)sim_cfg.lostMs*1000)) sim_stats.lostSleeps++;
+    if (SIM_NEVER!=until) sim_stats.sleptUs += until - sim_now;
+}
+
+static void rxWake(void) {
+    sim_stats.sleptUs += sim_now - sleepFrom;
+    wakeAt = sim_now;
+    quietUntil = sim_now + (uint64_t)sim_cfg.ttffMs*1000;
+}
+
+// move the bytes the receiver has output by now into its I2C buffer
+static void fill(void) {
+    uint64_t t;
+    while ((t = SimGPS_Next()) <= sim_now) {
+        uint8_t c = SimGPS_Pop();
+        if ((t >= sleepFrom) && (t < quietUntil)) continue; // asleep or still acquiring
+        if (devHead - devTail < sim_cfg.bufSize) {
+            devBuf[devHead++ % SIM_BUF_MAX] = c;
+        } else {
+            sim_stats.dropped++;
+        }
+    }
+}
+
+// the checksum of a UBX frame or an NMEA sentence written to the receiver is good
+static bool checksumOK(const uint8_t * msg, uint16_t len) {
+    if ((len>=8) && (0xB5==msg[0])) {
+        uint8_t a = 0, b = 0;
+        if ((uint32_t)(msg[4] | (msg[5]<<8)) + 8 != len) return(false);
+        for (uint16_t i=2; i<len-2; i++) {
+            a += msg[i];
+            b += a;
+        }
+        return((a==msg[len-2]) && (b==msg[len-1]));
+    }
+    if ((len>=7) && ('$'==msg[0]) && ('*'==msg[len-5])) {
+        uint8_t sum = 0;
+        char hex[3];
+        for (uint16_t i=1; i<len-5; i++) sum ^= msg[i];
+        snprintf(hex, sizeof(hex), "%02X", sum);
+        return(0==memcmp(hex, &msg[len-4], 2));
+    }
+    return(false);
+}
+
+// a message written to the receiver - only the rate, output protocol, sleep, aiding and assistance data are acted on
+static void command(const uint8_t * msg, uint16_t len) {
+    if ((len>=16) && (0xB5==msg[0]) && (0x62==msg[1]) && (0x02==msg[2]) && (0x41==msg[3]) && (msg[10] & 0x02)) { // UBX-RXM-PMREQ backup
+        uint32_t ms = msg[6] | (msg[7]<<8) | (msg[8]<<16) | ((uint32_t)msg[9]<<24);
+        rxSleep(ms ? sim_now + (uint64_t)ms*1000 : SIM_NEVER);
+        periodMs = sim_cfg.periodMs; // restarts with the defaults
+        ubxOut = false;
+    }
+    if ((len>=10) && (0==memcmp(msg, "$PMTK161,0", 10))) {
+        rxSleep(SIM_NEVER);
+    }
+    if (((len>=8) && (0xB5==msg[0]) && (0x62==msg[1]) && (0x13==msg[2]) && (0x40==msg[3])) || ((len>=9) && (0==memcmp(msg, "$PMTK741,", 9)))) {
+        if (quietUntil > sim_now + (uint64_t)sim_cfg.ttffMs*1000) quietUntil = sim_now + (uint64_t)sim_cfg.ttffMs*1000; // aided start
+        sim_stats.aids++;
+    }
+    if (((len>=8) && (0xB5==msg[0]) && (0x62==msg[1]) && (0x13==msg[2]) && (0x20==msg[3])) || ((len>=9) && (0==memcmp(msg, "$PMTK721,", 9)))) {
+        if (checksumOK(msg, len)) {
+            if (quietUntil > sim_now + (uint64_t)sim_cfg.ttffMs*1000) quietUntil = sim_now + (uint64_t)sim_cfg.ttffMs*1000; // has the orbits
+            sim_stats.assists++;
+        } else {
+            sim_stats.assistBad++;
+        }
+    }
+    if ((len>=14) && (0xB5==msg[0]) && (0x62==msg[1]) && (0x06==msg[2]) && (0x08==msg[3])) { // UBX-CFG-RATE
+        uint32_t rate = msg[6] | (msg[7]<<8);
+        if (rate) periodMs = rate;
+    }
+    if ((len>=28) && (0xB5==msg[0]) && (0x62==msg[1]) && (0x06==msg[2]) && (0x00==msg[3]) && (0==msg[6])) { // UBX-CFG-PRT of the DDC port
+        uint16_t outProto = msg[20] | (msg[21]<<8);
+        ubxOut = (outProto & 0x01) && !(outProto & 0x02);
+    }
+    if ((len>=10) && (0==memcmp(msg, "$PMTK220,", 9))) {
+        uint32_t rate = atoi((const char *)&msg[9]);
+        if (rate) periodMs = rate;
+    }
+}
+
+static I2C_TransferReturn_TypeDef ublox(I2C_TransferSeq_TypeDef * seq) {
+    uint8_t * rd = NULL;
+    uint16_t rdLen = 0;
+    if (asleep()) return(i2cTransferNack); // the DDC port does not wake it
+    switch (seq->flags) {
+        case I2C_FLAG_WRITE:
+            if (1==seq->buf[0].len) ubloxReg = seq->buf[0].data[0];
+            else command(seq->buf[0].data, seq->buf[0].len);
+            return(i2cTransferDone);
+        case I2C_FLAG_WRITE_READ:
+            ubloxReg = seq->buf[0].data[0];
+            rd = seq->buf[1].data;
+            rdLen = seq->buf[1].len;
+            break;
+        case I2C_FLAG_READ:
+            rd = seq->buf[0].data;
+            rdLen = seq->buf[0].len;
+            break;
+        default:
+            return(i2cTransferUsageFault);
+    }
+    uint16_t count = SimGPS_Buffered() > 0xFFFF ? 0xFFFF : SimGPS_Buffered(); // latched at the start of the read
+    for (uint16_t i=0; i<rdLen; i++) {
+        switch (ubloxReg) {
+            case 0xFD: rd[i] = count>>8; ubloxReg++; break;
+            case 0xFE: rd[i] = count; ubloxReg++; break;
+            case 0xFF:
+                if (devHead!=devTail) {
+                    rd[i] = devBuf[devTail++ % SIM_BUF_MAX];
+                } else {
+                    rd[i] = 0xFF;
+                    sim_stats.padBytes++;
+                }
+                break;
+            default: rd[i] = 0; ubloxReg++; break;
+        }
+    }
+    return(i2cTransferDone);
+}
+
+static I2C_TransferReturn_TypeDef mtk(I2C_TransferSeq_TypeDef * seq) {
+    switch (seq->flags) {
+        case I2C_FLAG_WRITE:
+            if (asleep()) rxWake(); // any byte wakes it from standby
+            command(seq->buf[0].data, seq->buf[0].len);
+            return(i2cTransferDone);
+        case I2C_FLAG_READ:
+            for (uint16_t i=0; i<seq->buf[0].len; i++) {
+                if (devHead!=devTail) {
+                    seq->buf[0].data[i] = devBuf[devTail++ % SIM_BUF_MAX];
+                } else {
+                    seq->buf[0].data[i] = 0x0A;
+                    sim_stats.padBytes++;
+                }
+            }
+            return(i2cTransferDone);
+        default:
+            return(i2cTransferUsageFault);
+    }
+}
+
+/* I2CSPM_Transfer - answered by the receiver at the address, the bus time is added to sim_now
+ */
+I2C_TransferReturn_TypeDef I2CSPM_Transfer(I2C_TypeDef * i2c, I2C_TransferSeq_TypeDef * seq) {
+    I2C_TransferReturn_TypeDef rtn;
+    uint32_t bytes = 1 + seq->buf[0].len;   // address and data
+    uint32_t bits = 2;                      // start and stop
+    (void)i2c;
+    if (I2C_FLAG_WRITE_READ==seq->flags) {
+        bytes += 1 + seq->buf[1].len;       // repeated start and the address again
+        bits++;
+    }
+    SimGPS_CheckFix(); // the bytes of the last transfer have been parsed by now
+    fill();
+    switch (seq->addr>>1) {
+        case UBLOX_ADDR: rtn = ublox(seq); break;
+        case MTK_ADDR: rtn = mtk(seq); break;
+        default: rtn = i2cTransferNack; bytes = 1; break;
+    }
+    sim_stats.transfers++;
+    sim_stats.busBytes += bytes;
+    sim_now += ((uint64_t)(bits + 9*bytes)*1000000 + sim_cfg.i2cHz-1) / sim_cfg.i2cHz;
+    return(rtn);
+}
@@ -0,0 +1,9 @@
+/* Host simulation stand-in - see Sim.h */
+#ifndef EM_CMU_H
+#define EM_CMU_H
+#include <stdbool.h>
+typedef enum { cmuClock_EUSART0, cmuClock_EUSART1, cmuClock_EUSART2, cmuClock_GPIO } CMU_Clock_TypeDef;
+typedef enum { cmuSelect_EM01GRPCCLK } CMU_Select_TypeDef;
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+#endif
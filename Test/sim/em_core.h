@@ -0,0 +1,7 @@
+/* Host simulation stand-in - see Sim.h. Interrupts are run by the simulation loop so there is nothing to mask. */
+#ifndef EM_CORE_H
+#define EM_CORE_H
+#define CORE_DECLARE_IRQ_STATE
+#define CORE_ENTER_ATOMIC()
+#define CORE_EXIT_ATOMIC()
+#endif
@@ -0,0 +1,66 @@
+/* Host simulation stand-in - see Sim.h. The registers UART_DRZ.c uses, modeled by SimEUSART.c.
+ * A read of RXDATA pops the modeled hardware FIFO - the macro turns uart->RXDATA into a call through the instance.
+ * Only the byte per interrupt receiver is modeled, not EUSART1_RX_LDMA.
+ */
+#ifndef EM_EUSART_H
+#define EM_EUSART_H
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct EUSART_TypeDef {
+    uint32_t FRAMECFG;
+    uint32_t CFG0;
+    uint32_t CFG1;
+    uint32_t IF;
+    uint32_t IF_CLR;    // the simulation clears the IF bits written here when the ISR returns
+    uint32_t IEN;
+    uint32_t IEN_SET;
+    uint32_t STATUS;
+    uint32_t TXDATA;
+    uint32_t (*RXDATA_read)(void);
+} EUSART_TypeDef;
+#define RXDATA RXDATA_read()
+
+extern EUSART_TypeDef sim_eusart[3];
+#define EUSART0 (&sim_eusart[0])
+#define EUSART1 (&sim_eusart[1])
+#define EUSART2 (&sim_eusart[2])
+
+typedef enum { eusartDataBits8 = 0x5 } EUSART_Databits_TypeDef;
+typedef enum { eusartStopbits1 = 0x3000 } EUSART_Stopbits_TypeDef;
+typedef enum { eusartNoParity = 0x0 } EUSART_Parity_TypeDef;
+typedef enum { eusartDisable = 0, eusartEnable = 3 } EUSART_Enable_TypeDef;
+
+#define _EUSART_FRAMECFG_DATABITS_MASK      0xF
+#define _EUSART_FRAMECFG_PARITY_MASK        0x300
+#define _EUSART_FRAMECFG_STOPBITS_MASK      0x3000
+#define _EUSART_CFG1_RXTIMEOUT_SHIFT        4
+#define _EUSART_CFG1_RXTIMEOUT_MASK         0x70
+#define EUSART_CFG1_RXTIMEOUT_DISABLED      (0x0 << 4)
+#define EUSART_CFG1_RXTIMEOUT_ONEFRAME      (0x1 << 4)
+#define EUSART_CFG1_RXTIMEOUT_TWOFRAMES     (0x2 << 4)
+#define EUSART_CFG1_RXTIMEOUT_THREEFRAMES   (0x3 << 4)
+#define EUSART_CFG1_RXTIMEOUT_FIVEFRAMES    (0x4 << 4)
+#define EUSART_CFG1_RXTIMEOUT_SEVENFRAMES   (0x5 << 4)
+#define EUSART_CFG0_AUTOBAUDEN              0x8000
+
+#define EUSART_IF_RXFL      0x4
+#define EUSART_IF_RXOF      0x10
+#define EUSART_IF_FERR      0x80
+#define EUSART_IF_RXTO      0x40000
+#define EUSART_IEN_RXFL     EUSART_IF_RXFL
+#define EUSART_IEN_RXOF     EUSART_IF_RXOF
+#define EUSART_IEN_FERR     EUSART_IF_FERR
+#define EUSART_IEN_RXTO     EUSART_IF_RXTO
+#define EUSART_STATUS_RXFL  0x4
+#define EUSART_STATUS_TXFL  0x8
+
+#define EFM_ASSERT(expr) ((void)(expr))
+
+typedef enum { EUSART0_RX_IRQn, EUSART1_RX_IRQn, EUSART2_RX_IRQn } IRQn_Type;
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+void EUSART_Enable(EUSART_TypeDef *eusart, EUSART_Enable_TypeDef enable);
+void EUSART_BaudrateSet(EUSART_TypeDef *eusart, uint32_t refFreq, uint32_t baudrate);
+#endif
@@ -0,0 +1,18 @@
+/* Host simulation stand-in - see Sim.h */
+#ifndef EM_GPIO_H
+#define EM_GPIO_H
+#include <stdint.h>
+typedef enum { gpioPortA, gpioPortB, gpioPortC, gpioPortD } GPIO_Port_TypeDef;
+typedef enum { gpioModeInputPull, gpioModePushPull } GPIO_Mode_TypeDef;
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+
+typedef struct { uint32_t ROUTEEN, TXROUTE, RXROUTE; } GPIO_EUSARTROUTE_TypeDef;
+typedef struct { GPIO_EUSARTROUTE_TypeDef EUSARTROUTE[3]; } GPIO_TypeDef;
+extern GPIO_TypeDef sim_gpio;
+#define GPIO (&sim_gpio)
+#define GPIO_EUSART_ROUTEEN_TXPEN           0x2
+#define _GPIO_EUSART_TXROUTE_PORT_SHIFT     0
+#define _GPIO_EUSART_TXROUTE_PIN_SHIFT      16
+#define _GPIO_EUSART_RXROUTE_PORT_SHIFT     0
+#define _GPIO_EUSART_RXROUTE_PIN_SHIFT      16
+#endif
@@ -0,0 +1,31 @@
+/* Host simulation stand-in - see Sim.h. Only what the GPS drivers use, with the emlib names and values. */
+#ifndef EM_I2C_H
+#define EM_I2C_H
+#include <stdint.h>
+
+typedef struct I2C_TypeDef { uint32_t dummy; } I2C_TypeDef;
+
+#define I2C_FLAG_WRITE          0x0001
+#define I2C_FLAG_READ           0x0002
+#define I2C_FLAG_WRITE_READ     0x0004
+#define I2C_FLAG_WRITE_WRITE    0x0008
+
+typedef enum {
+    i2cTransferInProgress = 1,
+    i2cTransferDone = 0,
+    i2cTransferNack = -1,
+    i2cTransferBusErr = -2,
+    i2cTransferArbLost = -3,
+    i2cTransferUsageFault = -4,
+    i2cTransferSwFault = -5
+} I2C_TransferReturn_TypeDef;
+
+typedef struct {
+    uint16_t addr;
+    uint16_t flags;
+    struct {
+        uint8_t *data;
+        uint16_t len;
+    } buf[2];
+} I2C_TransferSeq_TypeDef;
+#endif
@@ -0,0 +1,9 @@
+/* Host simulation stand-in - see Sim.h. The application events used by the drivers. */
+#ifndef EVENTS_H_
+#define EVENTS_H_
+typedef enum {
+    EVENT_APP_I2CTIMER_TIMEOUT = 16,
+    EVENT_APP_NMEA_READY,
+    EVENT_EUSART1_CHARACTER_RECEIVED
+} EVENT_APP;
+#endif
@@ -0,0 +1,6 @@
+/* Host simulation stand-in - see Sim.h. I2CSPM_Transfer() is answered by the receiver models in SimGPS.c */
+#ifndef SL_I2CSPM_H
+#define SL_I2CSPM_H
+#include "em_i2c.h"
+I2C_TransferReturn_TypeDef I2CSPM_Transfer(I2C_TypeDef *i2c, I2C_TransferSeq_TypeDef *seq);
+#endif
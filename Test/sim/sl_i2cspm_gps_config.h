@@ -0,0 +1,7 @@
+/* Host simulation stand-in - see Sim.h */
+#ifndef SL_I2CSPM_GPS_CONFIG_H
+#define SL_I2CSPM_GPS_CONFIG_H
+#include "em_i2c.h"
+extern I2C_TypeDef sim_i2c;
+#define SL_I2CSPM_GPS_PERIPHERAL (&sim_i2c)
+#endif
@@ -0,0 +1,9 @@
+/* Host simulation stand-in - see Sim.h. Events are queued to the simulated application task. */
+#ifndef ZAF_EVENT_DISTRIBUTOR_SOC_H_
+#define ZAF_EVENT_DISTRIBUTOR_SOC_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <AppTimer.h>
+bool zaf_event_distributor_enqueue_app_event(const uint8_t event);
+bool zaf_event_distributor_enqueue_app_event_from_isr(const uint8_t event);
+#endif
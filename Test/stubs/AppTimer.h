@@ -0,0 +1,17 @@
+/* Host stand-in for the AppTimer of the ZAF - the simulation (sim/Sim.h) and GeoLocCC_SetTest.c run the callback when their time reaches the timeout. */
+#ifndef _APP_TIMER_H_
+#define _APP_TIMER_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum { ESWTIMER_STATUS_SUCCESS, ESWTIMER_STATUS_FAILED } ESwTimerStatus;
+
+typedef struct SSwTimer {
+    uint64_t expiry;    // time the callback runs at - us in the simulation
+    bool running;
+    void (*pCallback)(struct SSwTimer *pTimer);
+} SSwTimer;
+
+bool AppTimerRegister(SSwTimer *pTimer, bool bAutoReload, void (*pCallback)(SSwTimer *pTimer));
+ESwTimerStatus TimerStart(SSwTimer *pTimer, uint32_t iTimeout);
+#endif
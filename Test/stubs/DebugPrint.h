@@ -0,0 +1,3 @@
+/* Host build stand-in - see ZAF_types.h */
+#define DPRINT(...) do {} while(0)
+#define DPRINTF(...) do {} while(0)
@@ -0,0 +1,7 @@
+/* Host build stand-in - see ZAF_types.h */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+#include <stdint.h>
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS 1
+#endif
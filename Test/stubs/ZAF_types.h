@@ -0,0 +1,56 @@
+/* Minimal stand-in for the ZAF headers so the command class builds and runs on a Linux host (make test/bench in Test/).
+ * Only what CC_GeographicLoc.c uses is here - the real SDK headers are used by RunTest.sh when the SDK is installed.
+ */
+#ifndef ZAF_TYPES_H_
+#define ZAF_TYPES_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define COMMAND_CLASS_GEOGRAPHIC_LOCATION 0x8C
+#include "CC_GeographicLoc2.h"
+#include "CC_GeographicLoc3.h"
+
+typedef struct { uint8_t rxStatus; } RECEIVE_OPTIONS_TYPE_EX;
+typedef struct { uint8_t cmdClass; uint8_t cmd; } ZW_COMMON_FRAME;
+typedef union {
+    ZW_COMMON_FRAME ZW_Common;
+    ZW_GEOGRAPHIC_LOCATION_GET_V2_FRAME ZW_GeographicLocationGetV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_REPORT_V2_FRAME ZW_GeographicLocationReportV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_SET_V2_FRAME ZW_GeographicLocationSetV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_BATCH_GET_V2_FRAME ZW_GeographicLocationBatchGetV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_BATCH_REPORT_V2_FRAME ZW_GeographicLocationBatchReportV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_ASSIST_GET_V2_FRAME ZW_GeographicLocationAssistGetV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_ASSIST_REPORT_V2_FRAME ZW_GeographicLocationAssistReportV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_ASSIST_DATA_V2_FRAME ZW_GeographicLocationAssistDataV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_STATISTICS_GET_V2_FRAME ZW_GeographicLocationStatisticsGetV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_STATISTICS_REPORT_V2_FRAME ZW_GeographicLocationStatisticsReportV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_AGE_GET_V2_FRAME ZW_GeographicLocationAgeGetV2Frame;
+    ZW_GEOGRAPHIC_LOCATION_AGE_REPORT_V2_FRAME ZW_GeographicLocationAgeReportV2Frame;
+    uint8_t raw[64];
+} ZW_APPLICATION_TX_BUFFER;
+typedef enum { RECEIVED_FRAME_STATUS_SUCCESS, RECEIVED_FRAME_STATUS_FAIL, RECEIVED_FRAME_STATUS_NO_SUPPORT } received_frame_status_t;
+typedef struct { ZW_APPLICATION_TX_BUFFER *frame; RECEIVE_OPTIONS_TYPE_EX *rx_options; uint8_t length; } cc_handler_input_t;
+typedef struct { ZW_APPLICATION_TX_BUFFER *frame; uint8_t length; } cc_handler_output_t;
+typedef struct { uint8_t cmdClass; uint8_t cmd; } ccc_pair_t;
+bool Check_not_legal_response_job(RECEIVE_OPTIONS_TYPE_EX *rxOpt);
+// the tests call the handler, init and reset through cc_registration
+typedef struct {
+    received_frame_status_t (*handler)(cc_handler_input_t *input, cc_handler_output_t *output);
+    void (*init)(void);
+    void (*reset)(void);
+} cc_registration_t;
+#define REGISTER_CC_V5(cc, version, handler, basic_set, basic_get, lifeline, flags, init_fn, reset_fn) \
+    const cc_registration_t cc_registration = {handler, init_fn, reset_fn}
+
+// NVM
+typedef enum { ZPAL_STATUS_OK = 0, ZPAL_STATUS_FAIL } zpal_status_t;
+zpal_status_t ZAF_nvm_app_read(uint16_t id, void *data, size_t len);
+zpal_status_t ZAF_nvm_app_write(uint16_t id, const void *data, size_t len);
+
+// TIMER0 is used to beep on each Report
+typedef struct { volatile uint32_t CMD; } TIMER_TypeDef;
+static TIMER_TypeDef timer0_stub __attribute__((unused));
+#define TIMER0 (&timer0_stub)
+#endif
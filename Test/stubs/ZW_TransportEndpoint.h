@@ -0,0 +1 @@
+/* Host build stand-in - see ZAF_types.h */
@@ -0,0 +1,14 @@
+/* Host build stand-in - see ZAF_types.h */
+#ifndef ZW_TRANSPORTMULTICAST_H_
+#define ZW_TRANSPORTMULTICAST_H_
+#include <stdint.h>
+#include <stdbool.h>
+typedef struct { uint8_t profile_MS; uint8_t profile_LS; } agi_profile_t;
+typedef struct { uint8_t cmdClass; uint8_t cmd; } cc_group_t;
+typedef struct { uint8_t nodeId; } transmission_result_t;
+typedef enum { JOB_STATUS_SUCCESS = 0, JOB_STATUS_BUSY, JOB_STATUS_NO_DESTINATIONS } JOB_STATUS;
+#define ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL 0x00
+#define ASSOCIATION_GROUP_INFO_REPORT_PROFILE_GENERAL_LIFELINE 0x01
+JOB_STATUS cc_engine_multicast_request(const agi_profile_t * const p_profile, uint8_t source_endpoint, const cc_group_t * const p_cc_group,
+    uint8_t * p_frame, uint8_t frame_size, bool fSupervisionEnable, void (*p_callback)(transmission_result_t * pTxResult));
+#endif
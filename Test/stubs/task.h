@@ -0,0 +1,6 @@
+/* Host build stand-in - see ZAF_types.h */
+#ifndef INC_TASK_H
+#define INC_TASK_H
+#include "FreeRTOS.h"
+TickType_t xTaskGetTickCount(void);
+#endif
@@ -0,0 +1,329 @@
+/**
+ * @file TrackLog.c
+ * @brief Circular log of GPS fixes in NVM so a tracker out of Z-Wave range keeps its track
+ *
+ * Only the latest fix is kept in RAM so a tracker that is out of range loses its track. This logs a locked fix every
+ * TRACKLOG_INTERVAL_S into a circular log of TRACKLOG_BLOCKS NVM files which can be drained when the node is back in range.
+ *  - The points are delta encoded in blocks of TRACKLOG_BLOCK_SIZE bytes. Each block starts with a keyframe so a block
+ *    stands alone: once the log is full the oldest block is overwritten and the ones after it can still be decoded.
+ *  - Values are zigzag varints - the changes of a slow tracker are small so a point is typically 5 to 8 bytes.
+ *  - The block being filled is kept in RAM and written to its file when the next point does not fit. Batching the points keeps the
+ *    flash writes (wear and the ms the write blocks the application) to one per block instead of one per point.
+ *    TrackLog_Flush() writes a partial block - only the points since the last write are lost on a reset.
+ *  - The blocks can be read raw with TrackLog_ReadBlock() to be sent as is or decoded with TrackLog_Read().
+ *    TrackLog_Ack() marks the blocks that were received so they are not read again after a reset.
+ */
+
+#include "TrackLog.h"
+#include <ZAF_types.h>
+#include "DebugPrint.h"
+#include <string.h>
+
+static TrackBlock_t block;      // block being filled
+static TrackBlock_t readBuf;    // block being read by TrackLog_Read()
+static TrackPoint_t last;       // last point logged - the next one is encoded as the change from this
+static bool haveLast;
+static uint32_t acked;          // blocks up to this seq were received
+static uint32_t midnights;      // days since the first point when the date is unknown
+static uint32_t lastTod;        // UTC seconds since midnight of the last fix - the day changes when it goes backwards
+static uint32_t written;        // used of the block the last time it was written - nothing to do if it has not changed
+static uint32_t writtenSeq;
+
+static uint16_t fileID(uint32_t seq) {
+    return(FILE_ID_TRACKLOG + (seq % TRACKLOG_BLOCKS));
+}
+
+/* @brief days since 2000-01-01 of a ddmmyy date (2000-2099)
+ */
+static uint32_t daysSince2000(uint32_t ddmmyy) {
+    static const uint16_t daysBefore[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    uint32_t dd = ddmmyy/10000;
+    uint32_t mm = (ddmmyy/100)%100;
+    uint32_t yy = ddmmyy%100;
+    if ((mm<1) || (mm>12) || (dd<1)) return(0);
+    uint32_t days = yy*365 + (yy+3)/4 + daysBefore[mm-1] + dd-1;
+    if ((mm>2) && (0==(yy%4))) days++; // Feb 29 of this year
+    return(days);
+}
+
+/* @brief the time of a point - UTC seconds since 2000 if the date is known, otherwise the time of day counting the midnights
+ */
+static uint32_t trackTime(const GPS_fix_t * fix) {
+    uint32_t tod = fix->utc/1000;
+    if (0!=fix->date) return(daysSince2000(fix->date)*86400 + tod);
+    if (tod<lastTod) midnights++;
+    lastTod = tod;
+    return(midnights*86400 + tod);
+}
+
+static uint8_t putVarint(uint8_t * p, uint32_t v) {
+    uint8_t n = 0;
+    while (v>=0x80) {
+        p[n++] = (uint8_t)(v|0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return(n);
+}
+
+static uint8_t putSigned(uint8_t * p, int32_t v) { // zigzag - small negative numbers are small too
+    return(putVarint(p, ((uint32_t)v<<1) ^ (uint32_t)(v>>31)));
+}
+
+/* @brief read a varint from p up to end - returns the bytes used or 0 if it runs past end or is too long
+ */
+static uint8_t getVarint(const uint8_t * p, const uint8_t * end, uint32_t * v) {
+    uint32_t r = 0;
+    for (uint8_t n=0; (n<5) && (p+n<end); n++) {
+        r |= (uint32_t)(p[n]&0x7F) << (7*n);
+        if (0==(p[n]&0x80)) {
+            *v = r;
+            return(n+1);
+        }
+    }
+    return(0);
+}
+
+static int32_t unzigzag(uint32_t u) {
+    return((int32_t)((u>>1) ^ (0-(u&1))));
+}
+
+// header byte of each point
+#define POINT_KEYFRAME 0x80
+#define POINT_QUALITY  0x0F
+
+/* @brief encode pt into p - a keyframe if prev is NULL otherwise the change from prev - returns the bytes used
+ * The changes are computed modulo 2^32 so they decode exactly even across the date line.
+ */
+static uint8_t encode(uint8_t * p, const TrackPoint_t * pt, const TrackPoint_t * prev) {
+    uint8_t n = 1;
+    p[0] = (pt->quality & POINT_QUALITY) | (prev ? 0 : POINT_KEYFRAME);
+    if (NULL==prev) {
+        n += putVarint(&p[n], pt->time);
+        n += putSigned(&p[n], pt->latitude);
+        n += putSigned(&p[n], pt->longitude);
+        n += putSigned(&p[n], pt->altitude);
+    } else {
+        n += putVarint(&p[n], pt->time - prev->time);
+        n += putSigned(&p[n], (int32_t)((uint32_t)pt->latitude - (uint32_t)prev->latitude));
+        n += putSigned(&p[n], (int32_t)((uint32_t)pt->longitude - (uint32_t)prev->longitude));
+        n += putSigned(&p[n], (int32_t)((uint32_t)pt->altitude - (uint32_t)prev->altitude));
+    }
+    return(n);
+}
+
+/* @brief encode as many of the n points as fit in size bytes of buf, the first as a keyframe - returns the points encoded
+ * used is set to the bytes used. This is the encoding of the blocks so a batch of points can be sent in the same format.
+ */
+uint8_t TrackLog_Encode(const TrackPoint_t * pts, uint8_t n, uint8_t * buf, uint8_t size, uint8_t * used) {
+    uint8_t enc[TRACKLOG_POINT_MAX];
+    uint8_t i;
+    *used = 0;
+    for (i=0; i<n; i++) {
+        uint8_t len = encode(enc, &pts[i], (0==i) ? NULL : &pts[i-1]);
+        if (*used + len > size) break;
+        memcpy(&buf[*used], enc, len);
+        *used += len;
+    }
+    return(i);
+}
+
+/* @brief decode count points from used bytes of data - points before skip are decoded but not returned
+ * Returns the number of points put in pts. Corrupt data stops at the last good point.
+ */
+uint8_t TrackLog_DecodeData(const uint8_t * data, uint8_t used, uint8_t count, uint8_t skip, TrackPoint_t * pts, uint8_t max) {
+    const uint8_t * p = data;
+    const uint8_t * end = &data[used];
+    TrackPoint_t pt = {0};
+    uint8_t n = 0;
+    for (uint8_t i=0; (i<count) && (n<max); i++) {
+        uint32_t v[4];
+        uint8_t len;
+        if (p>=end) break;
+        uint8_t hdr = *p++;
+        for (uint8_t f=0; f<4; f++) {
+            len = getVarint(p, end, &v[f]);
+            if (0==len) return(n);
+            p += len;
+        }
+        if (hdr & POINT_KEYFRAME) {
+            pt.time      = v[0];
+            pt.latitude  = unzigzag(v[1]);
+            pt.longitude = unzigzag(v[2]);
+            pt.altitude  = unzigzag(v[3]);
+        } else if (0==i) { // the first point must be a keyframe
+            return(n);
+        } else {
+            pt.time     += v[0];
+            pt.latitude  = (int32_t)((uint32_t)pt.latitude + (uint32_t)unzigzag(v[1]));
+            pt.longitude = (int32_t)((uint32_t)pt.longitude + (uint32_t)unzigzag(v[2]));
+            pt.altitude  = (int32_t)((uint32_t)pt.altitude + (uint32_t)unzigzag(v[3]));
+        }
+        pt.quality = hdr & POINT_QUALITY;
+        if (i>=skip) pts[n++] = pt;
+    }
+    return(n);
+}
+
+uint8_t TrackLog_Decode(const TrackBlock_t * blk, uint8_t skip, TrackPoint_t * pts, uint8_t max) {
+    return(TrackLog_DecodeData(blk->data, (blk->used<=TRACKLOG_DATA_SIZE) ? blk->used : TRACKLOG_DATA_SIZE, blk->count, skip, pts, max));
+}
+
+/* @brief write the block and start the next one - it starts with a keyframe
+ */
+static void closeBlock(void) {
+    TrackLog_Flush();
+    block.seq++;
+    block.count = 0;
+    block.used = 0;
+}
+
+/* @brief find the newest block in NVM and continue filling it
+ */
+void TrackLog_Init(void) {
+    uint32_t seq = 0;
+    memset(&block, 0, sizeof(block));
+    memset(&last, 0, sizeof(last));
+    for (uint32_t i=0; i<TRACKLOG_BLOCKS; i++) {
+        if ((ZPAL_STATUS_OK == ZAF_nvm_app_read(FILE_ID_TRACKLOG+i, &readBuf, sizeof(readBuf))) && (readBuf.seq > seq)) {
+            seq = readBuf.seq;
+            block = readBuf;
+        }
+    }
+    if (0==block.seq) block.seq = 1;
+    haveLast = (block.count > 0) && (1 == TrackLog_Decode(&block, block.count-1, &last, 1));
+    if ((block.count > 0) && !haveLast) { // corrupt - start a new block
+        block.seq++;
+        block.count = 0;
+        block.used = 0;
+    }
+    midnights = last.time/86400;
+    lastTod = last.time%86400;
+    if (ZPAL_STATUS_OK != ZAF_nvm_app_read(FILE_ID_TRACKLOG_ACK, &acked, sizeof(acked))) acked = 0;
+}
+
+/* @brief log the fix if it is locked and TRACKLOG_INTERVAL_S has passed since the last point - returns true if it was logged
+ */
+bool TrackLog_Add(const GPS_fix_t * fix) {
+    uint8_t enc[TRACKLOG_POINT_MAX];
+    if ((fix->quality <= 1) || (LAT_DEFAULT == fix->latitude) || (GPS_UTC_INVALID == fix->utc)) return(false);
+    TrackPoint_t pt = {trackTime(fix), fix->latitude, fix->longitude, fix->altitude, fix->quality};
+    bool backwards = (pt.time < last.time); // a reset without the date - start over with a keyframe
+    if (haveLast && !backwards && ((pt.time - last.time) < TRACKLOG_INTERVAL_S)) return(false);
+    if (0==block.seq) block.seq = 1;
+    uint8_t n = encode(enc, &pt, ((0==block.count) || backwards) ? NULL : &last);
+    if (block.used + n > TRACKLOG_DATA_SIZE) { // full - write it and start the next one with a keyframe
+        closeBlock();
+        n = encode(enc, &pt, NULL);
+    }
+    memcpy(&block.data[block.used], enc, n);
+    block.used += n;
+    block.count++;
+    last = pt;
+    haveLast = true;
+    return(true);
+}
+
+/* @brief write the block being filled to NVM
+ */
+void TrackLog_Flush(void) {
+    if ((0==block.count) || ((writtenSeq==block.seq) && (written==block.used))) return;
+    zpal_status_t tmp = ZAF_nvm_app_write(fileID(block.seq), &block, sizeof(block));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITE TRACK LOG %X", tmp);
+        return;
+    }
+    writtenSeq = block.seq;
+    written = block.used;
+}
+
+uint32_t TrackLog_Newest(void) {
+    return((block.count > 0) ? block.seq : block.seq-1); // block.seq-1 if this one was started after a corrupt one
+}
+
+uint32_t TrackLog_Oldest(void) {
+    uint32_t first = (block.seq > TRACKLOG_BLOCKS) ? block.seq - TRACKLOG_BLOCKS + 1 : 1;
+    if (acked >= first) first = acked+1;
+    if (first > TrackLog_Newest()) return(0);
+    return(first);
+}
+
+/* @brief copy block seq into blk - false if it is not in the log any more
+ */
+bool TrackLog_ReadBlock(uint32_t seq, TrackBlock_t * blk) {
+    if ((0==seq) || (seq > block.seq)) return(false);
+    if (seq==block.seq) {
+        *blk = block;
+        return(block.count > 0);
+    }
+    if (seq + TRACKLOG_BLOCKS <= block.seq) return(false); // overwritten
+    return((ZPAL_STATUS_OK == ZAF_nvm_app_read(fileID(seq), blk, sizeof(*blk))) && (blk->seq == seq));
+}
+
+void TrackLog_Open(TrackLog_cursor_t * cur) {
+    cur->seq = TrackLog_Oldest();
+    if (0==cur->seq) cur->seq = block.seq;
+    cur->index = 0;
+}
+
+/* @brief read up to max points from the cursor - returns the number read, 0 once all of the log has been read
+ * The cursor stays at the end of the block being filled so the points logged later are read by the next call.
+ */
+uint8_t TrackLog_Read(TrackLog_cursor_t * cur, TrackPoint_t * pts, uint8_t max) {
+    uint8_t n = 0;
+    uint32_t oldest = (block.seq > TRACKLOG_BLOCKS) ? block.seq - TRACKLOG_BLOCKS + 1 : 1;
+    if (acked >= oldest) oldest = (acked < block.seq) ? acked+1 : block.seq;
+    if (cur->seq < oldest) { // the log wrapped past the cursor or those blocks were acknowledged
+        cur->seq = oldest;
+        cur->index = 0;
+    }
+    while ((n<max) && (cur->seq <= block.seq)) {
+        if (!TrackLog_ReadBlock(cur->seq, &readBuf)) { // lost - a failed write
+            if (cur->seq == block.seq) break;
+            cur->seq++;
+            cur->index = 0;
+            continue;
+        }
+        uint8_t got = TrackLog_Decode(&readBuf, cur->index, &pts[n], max-n);
+        n += got;
+        cur->index += got;
+        if ((cur->index < readBuf.count) || (cur->seq == block.seq)) break; // pts is full or this is the block being filled
+        cur->seq++;
+        cur->index = 0;
+    }
+    return(n);
+}
+
+/* @brief the blocks up to seq were received - the block being filled is never acknowledged so its new points are read again
+ */
+void TrackLog_Ack(uint32_t seq) {
+    if (seq >= block.seq) seq = block.seq-1;
+    if (seq <= acked) return;
+    acked = seq;
+    zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_TRACKLOG_ACK, &acked, sizeof(acked));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITE TRACK LOG ACK %X", tmp);
+    }
+}
+
+/* @brief forget the whole log - a factory reset. The files that hold a block are overwritten with an empty one so TrackLog_Init() starts over
+ */
+void TrackLog_Erase(void) {
+    static const TrackBlock_t empty;
+    for (uint32_t i=0; i<TRACKLOG_BLOCKS; i++) {
+        if ((ZPAL_STATUS_OK == ZAF_nvm_app_read(FILE_ID_TRACKLOG+i, &readBuf, sizeof(readBuf))) && (0!=readBuf.seq)) {
+            zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_TRACKLOG+i, &empty, sizeof(empty));
+            if (ZPAL_STATUS_OK != tmp) {
+                DPRINTF("FAILED TO ERASE TRACK LOG %X", tmp);
+            }
+        }
+    }
+    acked = 0;
+    zpal_status_t tmp = ZAF_nvm_app_write(FILE_ID_TRACKLOG_ACK, &acked, sizeof(acked));
+    if (ZPAL_STATUS_OK != tmp) {
+        DPRINTF("FAILED TO WRITE TRACK LOG ACK %X", tmp);
+    }
+    written = 0;
+    writtenSeq = 0;
+    TrackLog_Init();
+}
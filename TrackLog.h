@@ -0,0 +1,71 @@
+/**
+ * @file TrackLog.h
+ * @brief Circular log of GPS fixes in NVM so a tracker out of Z-Wave range keeps its track
+ */
+
+#ifndef TRACK_LOG_H_
+#define TRACK_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "CC_GeographicLoc.h"
+
+// A locked fix is logged at most this often
+#ifndef TRACKLOG_INTERVAL_S
+#define TRACKLOG_INTERVAL_S 60
+#endif
+// Number of NVM files the log rotates through - the oldest block is overwritten when they are all full
+#ifndef TRACKLOG_BLOCKS
+#define TRACKLOG_BLOCKS 32
+#endif
+// Size of each NVM file - each holds about 15 points of a slow tracker and is written once when it is full
+#define TRACKLOG_BLOCK_SIZE 128
+#define TRACKLOG_DATA_SIZE (TRACKLOG_BLOCK_SIZE-6)
+#define TRACKLOG_POINT_MAX 21   // bytes of the largest encoded point - a keyframe of 5 byte varints
+
+// NVM file IDs - block n of the log is in FILE_ID_TRACKLOG+(seq%TRACKLOG_BLOCKS)
+#define FILE_ID_TRACKLOG_ACK (4201)
+#define FILE_ID_TRACKLOG     (4300)
+
+typedef struct TrackPoint
+{
+    uint32_t time;      // UTC seconds since 2000-01-01 when the date is known (RMC), otherwise seconds since the midnight before the first point
+    int32_t latitude;   // signed fixed point decimal degrees with 23 bits of fraction - the same as the Report
+    int32_t longitude;
+    int32_t altitude;   // centimeters
+    uint8_t quality;    // satellites in use clipped to 15
+} TrackPoint_t;
+
+/* Each block starts with a keyframe - the point in full - so it can be decoded without the blocks before it.
+ * Each point after that is the change from the previous one. Every value is a zigzag varint so the small changes of a
+ * slow tracker take one or two bytes: a point is typically 5 to 8 bytes instead of the 17 of a TrackPoint_t.
+ */
+typedef struct TrackBlock
+{
+    uint32_t seq;       // 1 for the first block ever written then one more for each - 0 is an empty file
+    uint8_t count;      // points in data
+    uint8_t used;       // bytes of data used
+    uint8_t data[TRACKLOG_DATA_SIZE];
+} TrackBlock_t;
+
+typedef struct TrackLog_cursor
+{
+    uint32_t seq;       // block
+    uint8_t index;      // next point in the block
+} TrackLog_cursor_t;
+
+void TrackLog_Init(void); // find the newest block in NVM and continue it
+bool TrackLog_Add(const GPS_fix_t * fix); // log the fix if it is locked and TRACKLOG_INTERVAL_S has passed - true if it was logged
+void TrackLog_Flush(void); // write the partial block to NVM - points not flushed are lost on a reset
+uint32_t TrackLog_Oldest(void); // seq of the oldest block not acknowledged - 0 if there is none
+uint32_t TrackLog_Newest(void); // seq of the block being filled - 0 if nothing was logged
+bool TrackLog_ReadBlock(uint32_t seq, TrackBlock_t * block); // the encoded block to send as is - false if it was overwritten
+uint8_t TrackLog_Decode(const TrackBlock_t * block, uint8_t skip, TrackPoint_t * pts, uint8_t max); // points skip and up of a block
+uint8_t TrackLog_Encode(const TrackPoint_t * pts, uint8_t n, uint8_t * buf, uint8_t size, uint8_t * used); // as many points as fit
+uint8_t TrackLog_DecodeData(const uint8_t * data, uint8_t used, uint8_t count, uint8_t skip, TrackPoint_t * pts, uint8_t max);
+void TrackLog_Open(TrackLog_cursor_t * cur); // start reading at the oldest point not acknowledged
+uint8_t TrackLog_Read(TrackLog_cursor_t * cur, TrackPoint_t * pts, uint8_t max); // the next points - 0 at the end of the log
+void TrackLog_Ack(uint32_t seq); // blocks up to seq were received - they are skipped by TrackLog_Open() and TrackLog_Oldest()
+void TrackLog_Erase(void); // empty the log in NVM and RAM - a factory reset
+
+#endif
@@ -8,24 +8,103 @@
  * Minimal drivers to initialize and setup the xG23 UARTs efficiently and provide simple functions for sending/receiving data.
  * Assumes using the EUSARTs and not the USART which has limited functionality and only a 2 byte buffer vs 16 in the EUSART.
  * Assumes high frequency mode (not operating in low-power modes with a low-frequency clock)
- * This example just implements a set of drivers for EUSART1. The code is tiny so make copies for the others as needed.
+ * Each EUSART enabled with EUSARTn_RX_ENABLE in UART_DRZ.h gets its own RxFIFO, interrupt handler and error counters.
  * EUSART1 is the most flexible as the IOs can be assigned to any GPIO. EUSART0/2 have limited routing to GPIOs.
  * Normally the SDK uses EUSART0 for DEBUGPRINT so leave it for that purpose.
- * 
+ *
  * See https://drzwave.blog/2023/07/25/installing-uart-drivers-in-a-z-wave-project/ for details on the development of this driver.
- * 
+ *
  */
 
 #include <em_cmu.h>
 #include <zaf_event_distributor_soc.h>
 #include "UART_DRZ.h"
+#include "RingBuffer.h"
 #include "events.h"
+#include <em_core.h>
+#ifdef EUSART1_RX_LDMA
+#include <dmadrv.h>
+#endif
+
+#if !RING_IS_POW2(RX_FIFO_DEPTH) || (RX_FIFO_DEPTH > 32768)
+#error "RX_FIFO_DEPTH must be a power of 2"
+#endif
+
+typedef struct EUSART_Rx    // receive side of one EUSART
+{
+    Ring_t ring;            // RxFIFO - the ISR (or LDMA) is the producer, the application is the consumer
+    EUSART_RxStats_t stats;
+    volatile bool eventPending; // an event is queued and the RxFIFO has not been drained yet
+    uint8_t event;          // EVENT_EUSARTn_CHARACTER_RECEIVED
+} EUSART_Rx_t;
 
-// Rx Buffer and pointers for EUSART1. Make copies for other EUSARTs.
+static EUSART_Rx_t EUSART_Rx[3];
+
+// Rx Buffers
+#if EUSART0_RX_ENABLE
+static uint8_t RxFIFO0[RX_FIFO_DEPTH];
+#endif
+#if EUSART1_RX_ENABLE
 static uint8_t RxFIFO1[RX_FIFO_DEPTH];
-static int RxFifoReadIndx1;
-static int RxFifoWriteIndx1;
-//static uint32_t EUSART1_Status;
+#endif
+#if EUSART2_RX_ENABLE
+static uint8_t RxFIFO2[RX_FIFO_DEPTH];
+#endif
+
+// Return the receive side of uart
+static EUSART_Rx_t * EUSART_RxOf(EUSART_TypeDef *uart) {
+    int uartnum = EUSART0 == uart ? 0 :
+        EUSART1 == uart ? 1 : 2;
+    return(&EUSART_Rx[uartnum]);
+}
+
+/* Tell the application there is data in RxFIFO - called by the ISRs when one of the RX_EVENT triggers happens
+ * Only one event is queued at a time. The application drains the whole RxFIFO when it gets the event
+ * which clears eventPending once EUSART_RxSpan() or EUSART_RxDepth() returns 0.
+ */
+static void EUSART_RxEvent(EUSART_Rx_t *rx) {
+  if (!rx->eventPending) {
+      rx->eventPending = zaf_event_distributor_enqueue_app_event_from_isr(rx->event); // try again on the next trigger if the queue is full
+  }
+}
+
+#if defined(EUSART1_RX_LDMA) && EUSART1_RX_ENABLE
+/* The LDMA fills the 2 halves of RxFIFO1 in turn (ping-pong) - the descriptors link to each other so reception never stops.
+ * The ISRs commit the received bytes to the ring when a half is full or when the line goes idle so the RxFIFO is used the same way as without the LDMA.
+ * The LDMA can't tell when the ring is full so if the application falls more than RX_FIFO_DEPTH bytes behind it is counted as an overrun.
+ * The LDMA write index runs freely like the ring head so a full wrap of RxFIFO1 since the last commit is still seen as RX_FIFO_DEPTH bytes.
+ */
+static unsigned int RxDmaChannel1;
+static volatile uint16_t RxDmaHalves1; // halves filled since UART_Init() - free running, the LDMA is filling half RxDmaHalves1&1
+static LDMA_TransferCfg_t RxDmaCfg1 = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_EUSART1_RXFL);
+static LDMA_Descriptor_t RxDmaDesc1[2] = { // interrupt when each half is full
+    LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(&EUSART1->RXDATA, &RxFIFO1[0], RX_DMA_BUF_SIZE, 1),               // ping links to pong
+    LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(&EUSART1->RXDATA, &RxFIFO1[RX_DMA_BUF_SIZE], RX_DMA_BUF_SIZE, -1) // pong links back to ping
+};
+
+// Commit the bytes the LDMA has written up to the free running index written - the ring head is the number committed so far
+static void EUSART1_RxDmaCommit(uint16_t written) {
+    Ring_t *ring = &EUSART_Rx[1].ring;
+    uint16_t len = (uint16_t)(written - ring->head); // not masked - a full wrap is RX_FIFO_DEPTH bytes, not 0
+    if (len > Ring_Free(ring)) { // the LDMA has overwritten bytes that were not read yet
+        EUSART_Rx[1].stats.overruns++;
+        len = Ring_Free(ring);  // the rest is committed once there is room so the ring stays aligned with the LDMA
+    }
+    Ring_Commit(ring, len);
+}
+
+/* EUSART1_RxDmaDone is called by DMADRV from the LDMA interrupt each time a half of RxFIFO1 is full
+ */
+static bool EUSART1_RxDmaDone(unsigned int channel, unsigned int sequenceNo, void *userParam) {
+    (void)channel;
+    (void)sequenceNo;
+    (void)userParam;
+    RxDmaHalves1++;
+    EUSART1_RxDmaCommit(RxDmaHalves1 * RX_DMA_BUF_SIZE); // the end of the half just filled
+    EUSART_RxEvent(&EUSART_Rx[1]);
+    return(true);
+}
+#endif
 
 /* UART_Init - basic initialization for the most common cases - works for all EUSARTs
  * Write to the appropriate UART registers to enable special modes after calling this function to enable fancy features.
@@ -36,9 +115,9 @@ void UART_Init( EUSART_TypeDef *uart,   // EUSART1 - Pointer to one of the EUSAR
     EUSART_Stopbits_TypeDef stopbits,   // eusartStopbits1=1 bit - follow the typdef for other settings
     EUSART_Parity_TypeDef parity,       // eusartNoParity
     GPIO_Port_TypeDef TxPort,           // gpioPortA thru D - Note that EUSART0 & 2 have GPIO port limitations
-    unsigned int TxPin, 
-    GPIO_Port_TypeDef RxPort, 
-    unsigned int RxPin) 
+    unsigned int TxPin,
+    GPIO_Port_TypeDef RxPort,
+    unsigned int RxPin)
 {
 
     // Check for valid uart and assign uartnum
@@ -63,6 +142,9 @@ void UART_Init( EUSART_TypeDef *uart,   // EUSART1 - Pointer to one of the EUSAR
                 | (uint32_t) (parity)
                 | (uint32_t) (stopbits));
 
+        // CFG1 can only be written while the EUSART is disabled
+        uart->CFG1 = (uart->CFG1 & ~_EUSART_CFG1_RXTIMEOUT_MASK) | RX_IDLE_TIMEOUT; // RXTO flag once the line is idle after a burst
+
         EUSART_Enable(uart, eusartEnable);
 
         if (baudrate == 0) {
@@ -83,71 +165,208 @@ void UART_Init( EUSART_TypeDef *uart,   // EUSART1 - Pointer to one of the EUSAR
             | (RxPin << _GPIO_EUSART_RXROUTE_PIN_SHIFT);
     }
 
-    RxFifoReadIndx1 = 0; // TODO - expand to other EUSARTs as needed
-    RxFifoWriteIndx1 = 0;
+    // Receive side - only for the EUSARTs enabled in UART_DRZ.h
+    EUSART_Rx_t *rx = EUSART_RxOf(uart);
+    uint8_t *buf = NULL;
+    IRQn_Type irq = EUSART1_RX_IRQn;
+    switch (uartnum) {
+#if EUSART0_RX_ENABLE
+        case 0: buf = RxFIFO0; irq = EUSART0_RX_IRQn; rx->event = EVENT_EUSART0_CHARACTER_RECEIVED; break;
+#endif
+#if EUSART1_RX_ENABLE
+        case 1: buf = RxFIFO1; irq = EUSART1_RX_IRQn; rx->event = EVENT_EUSART1_CHARACTER_RECEIVED; break;
+#endif
+#if EUSART2_RX_ENABLE
+        case 2: buf = RxFIFO2; irq = EUSART2_RX_IRQn; rx->event = EVENT_EUSART2_CHARACTER_RECEIVED; break;
+#endif
+        default: break; // transmit only
+    }
+    if (NULL==buf) return;
+
+    Ring_Init(&rx->ring, buf, RX_FIFO_DEPTH);
+    memset(&rx->stats, 0, sizeof(rx->stats));
+    rx->eventPending = false;
+
+#if defined(EUSART1_RX_LDMA) && EUSART1_RX_ENABLE
+    if (1==uartnum) { // The LDMA moves every byte, the EUSART only interrupts when the line goes idle or on errors
+        RxDmaHalves1 = 0;
+        DMADRV_Init();
+        DMADRV_AllocateChannel(&RxDmaChannel1, NULL);
+        DMADRV_LdmaStartTransfer(RxDmaChannel1, &RxDmaCfg1, RxDmaDesc1, EUSART1_RxDmaDone, NULL);
+        uart->IEN_SET = EUSART_IEN_RXTO | EUSART_IEN_RXOF | EUSART_IEN_FERR;
+        NVIC_EnableIRQ(irq);
+        return;
+    }
+#endif
+    // Enable Rx Interrupts - RXTO flushes the tail of a burst that did not reach a trigger
+    uart->IEN_SET = EUSART_IEN_RXFL | EUSART_IEN_RXTO | EUSART_IEN_RXOF | EUSART_IEN_FERR;
+    NVIC_EnableIRQ(irq);
+}
+
+#if EUSART0_RX_ENABLE || EUSART2_RX_ENABLE || (EUSART1_RX_ENABLE && !defined(EUSART1_RX_LDMA))
+/* EUSART_RxIRQ is the receive side interrupt handler common to all EUSARTs.
+ * This ISR pulls each byte out of the EUSART FIFO and places it into the software RxFIFO.
+ * If the RxFIFO is full the hardware FIFO is still emptied so the drop count is exact and the receiver keeps running.
+ */
+static void EUSART_RxIRQ(EUSART_TypeDef *uart, EUSART_Rx_t *rx, IRQn_Type irq) {
+  uint8_t dat;
+  bool newline = false;
+  uint32_t flags = uart->IF;
+  uart->IF_CLR = flags;                // clear all interrupt flags
+  NVIC_ClearPendingIRQ(irq);           // clear the NVIC Interrupt
+
+  if (flags & EUSART_IF_RXOF) rx->stats.overruns++;
+  if (flags & EUSART_IF_FERR) rx->stats.framing++;
 
-    // Enable Rx Interrupts
-    EUSART1->IEN_SET = EUSART_IEN_RXFL;
-    NVIC_EnableIRQ(EUSART1_RX_IRQn);
+  for (int i=0; (EUSART_STATUS_RXFL & uart->STATUS) && (i<16); i++) { // Pull all bytes out of EUSART
+      dat = uart->RXDATA;                  // read 1 byte out of the hardware FIFO in the EUSART
+      if (Ring_Put(&rx->ring, dat)) {
+          newline |= ('\n'==dat);
+      } else {  // No room in the RxFIFO, drop the data
+          rx->stats.drops++;
+      }
+  }
+  if ((flags & EUSART_IF_RXTO) || (RX_EVENT_ON_NEWLINE && newline) || (Ring_Depth(&rx->ring) >= RX_EVENT_THRESHOLD)) {
+      EUSART_RxEvent(rx);
+  }
 }
+#endif
 
-/* EUSART1_RX_IRQHandler is the receive side interrupt handler for EUSART1.
+/* EUSARTn_RX_IRQHandler are the receive side interrupt handlers.
  * startup_efr32zg23.c defines each of the IRQs as a WEAK function to Default_Handler which is then placed in the interrupt vector table.
  * By defining a function of the same name it overrides the WEAK function and places this one in the vector table.
- * Change this function name to match the EUSART you are using.
- *
- * This ISR pulls each byte out of the EUSART FIFO and places it into the software RxFIFO.
+ * With EUSART1_RX_LDMA the LDMA has already placed the bytes in the RxFIFO and the EUSART1 ISR only runs when the line goes idle.
  */
+#if EUSART0_RX_ENABLE
+void EUSART0_RX_IRQHandler(void){
+  EUSART_RxIRQ(EUSART0, &EUSART_Rx[0], EUSART0_RX_IRQn);
+}
+#endif
+
+#if EUSART1_RX_ENABLE
+#ifdef EUSART1_RX_LDMA
 void EUSART1_RX_IRQHandler(void){
-  uint8_t dat;
+  int remaining;
+  EUSART_Rx_t *rx = &EUSART_Rx[1];
   uint32_t flags = EUSART1->IF;
   EUSART1->IF_CLR = flags;                // clear all interrupt flags
   NVIC_ClearPendingIRQ(EUSART1_RX_IRQn);  // clear the NVIC Interrupt
 
-  for (int i=0; (EUSART_STATUS_RXFL & EUSART1->STATUS) && (i<16); i++) { // Pull all bytes out of EUSART
-      dat = EUSART1->RXDATA;                  // read 1 byte out of the hardware FIFO in the EUSART
-      if (EUSART1_RxDepth()<RX_FIFO_DEPTH) { // is there room in the RxFifo?
-          RxFIFO1[RxFifoWriteIndx1++] = dat;
-          if (RxFifoWriteIndx1 >= RX_FIFO_DEPTH) {
-              RxFifoWriteIndx1 = 0;
-          }
-      } else {  // No room in the RxFIFO, drop the data
-          // TODO - report underflow
-          break;
+  if (flags & EUSART_IF_RXOF) rx->stats.overruns++;
+  if (flags & EUSART_IF_FERR) rx->stats.framing++;
+
+  if (flags & EUSART_IF_RXTO) { // end of a burst - make the partly filled half available
+      CORE_DECLARE_IRQ_STATE;
+      CORE_ENTER_ATOMIC();    // the LDMA interrupt must not switch halves while computing the write index
+      if (0==(LDMA->IF & (1UL<<RxDmaChannel1))) { // if the half just filled, EUSART1_RxDmaDone() will commit it
+          DMADRV_TransferRemainingCount(RxDmaChannel1, &remaining);
+          EUSART1_RxDmaCommit(RxDmaHalves1 * RX_DMA_BUF_SIZE + RX_DMA_BUF_SIZE - remaining);
       }
-      // TODO - add testing for error conditions here - like the FIFO is full... Set a bit and call an event
+      CORE_EXIT_ATOMIC();
+      EUSART_RxEvent(rx);
   }
-  // TODO - check for error conditions
-  zaf_event_distributor_enqueue_app_event(EVENT_EUSART1_CHARACTER_RECEIVED); // Tell the application there is data in RxFIFO
 }
+#else
+void EUSART1_RX_IRQHandler(void){
+  EUSART_RxIRQ(EUSART1, &EUSART_Rx[1], EUSART1_RX_IRQn);
+}
+#endif
+#endif
 
-// Return a byte from the RxFIFO - be sure there is one available by calling RxDepth first
-uint8_t EUSART1_GetChar(void) {
-  uint8_t rtn;
-  rtn = RxFIFO1[RxFifoReadIndx1++]; // read the byte and increment the pointer
-  if (RxFifoReadIndx1>=RX_FIFO_DEPTH) { // correct the pointer to the circular buffer when it wraps past end
-    RxFifoReadIndx1 = 0;
-  }
-  return(rtn);
+#if EUSART2_RX_ENABLE
+void EUSART2_RX_IRQHandler(void){
+  EUSART_RxIRQ(EUSART2, &EUSART_Rx[2], EUSART2_RX_IRQn);
+}
+#endif
+
+// Remove a byte from the RxFIFO into *dat - returns false if the RxFIFO is empty
+bool EUSART_GetChar(EUSART_TypeDef *uart, uint8_t * dat) {
+  return(Ring_Get(&EUSART_RxOf(uart)->ring, dat));
 }
 
-// Put 1 character into the EUSART1 hardware Tx FIFO - returns True if FIFO is not full and False if FIFO is full and the byte was not added - nonblocking
+// Copy up to len bytes out of the RxFIFO - returns the number copied
+uint16_t EUSART_Read(EUSART_TypeDef *uart, uint8_t * dst, uint16_t len) {
+  return(Ring_Read(&EUSART_RxOf(uart)->ring, dst, len));
+}
+
+// Put 1 character into the EUSART hardware Tx FIFO - returns True if FIFO is not full and False if FIFO is full and the byte was not added - nonblocking
 // Rely on the 16 byte hardware FIFO for data buffering.
-bool EUSART1_PutChar(uint8_t dat) {
+bool EUSART_PutChar(EUSART_TypeDef *uart, uint8_t dat) {
   bool rtn = false;
-  if (EUSART1->STATUS & EUSART_STATUS_TXFL) {
-      EUSART1->TXDATA = dat;
+  if (uart->STATUS & EUSART_STATUS_TXFL) {
+      uart->TXDATA = dat;
       rtn = true;
   }
   return(rtn);
 }
 
+// Put up to len bytes into the EUSART hardware Tx FIFO - returns the number added, nonblocking
+// Pass the span of GPS_AssistSpan() and GPS_AssistConsume() the count to send the assistance data a FIFO full at a time.
+uint16_t EUSART_Write(EUSART_TypeDef *uart, const uint8_t * src, uint16_t len) {
+  uint16_t n = 0;
+  while ((n<len) && EUSART_PutChar(uart, src[n])) n++;
+  return(n);
+}
+
 // Number of valid data bytes in the RxFIFO - use this to avoid blocking GetChar
-int EUSART1_RxDepth(void) {
-  int rtn;
-  rtn = RxFifoReadIndx1 - RxFifoWriteIndx1;
-  if (rtn<0) {  // unroll the circular buffer 
-      rtn +=RX_FIFO_DEPTH;
+// Returning 0 means the RxFIFO has been drained so the next trigger queues another event.
+int EUSART_RxDepth(EUSART_TypeDef *uart) {
+  EUSART_Rx_t *rx = EUSART_RxOf(uart);
+  int rtn = Ring_Depth(&rx->ring);
+  if (0==rtn) {
+      rx->eventPending = false;
+      rtn = Ring_Depth(&rx->ring); // data that arrived just before the flag was cleared did not queue an event
+  }
+  return(rtn);
+}
+
+/* Return the number of contiguous bytes in the RxFIFO starting at *data - 0 if empty
+ * The data may wrap around the end of the RxFIFO so call again after EUSART_RxConsume() until it returns 0.
+ * Passing the whole span to NMEA_feed() avoids a function call per byte.
+ */
+uint16_t EUSART_RxSpan(EUSART_TypeDef *uart, const uint8_t ** data) {
+  EUSART_Rx_t *rx = EUSART_RxOf(uart);
+  uint16_t len = Ring_Peek(&rx->ring, data);
+  if (0==len) { // drained - the next trigger queues another event
+      rx->eventPending = false;
+      len = Ring_Peek(&rx->ring, data); // data that arrived just before the flag was cleared did not queue an event
   }
+  return(len);
+}
+
+// Release len bytes returned by EUSART_RxSpan()
+void EUSART_RxConsume(EUSART_TypeDef *uart, uint16_t len) {
+  Ring_Consume(&EUSART_RxOf(uart)->ring, len);
+}
+
+// Copy of the receive error counters - they are only cleared by UART_Init()
+void EUSART_GetRxStats(EUSART_TypeDef *uart, EUSART_RxStats_t * stats) {
+  *stats = EUSART_RxOf(uart)->stats;
+}
+
+// EUSART1 versions - GetChar returns 0 if the RxFIFO is empty so call RxDepth first
+uint8_t EUSART1_GetChar(void) {
+  uint8_t rtn = 0;
+  EUSART_GetChar(EUSART1, &rtn);
   return(rtn);
 }
+
+bool EUSART1_PutChar(uint8_t dat) {
+  return(EUSART_PutChar(EUSART1, dat));
+}
+
+uint16_t EUSART1_Write(const uint8_t * src, uint16_t len) {
+  return(EUSART_Write(EUSART1, src, len));
+}
+
+int EUSART1_RxDepth(void) {
+  return(EUSART_RxDepth(EUSART1));
+}
+
+uint16_t EUSART1_RxSpan(const uint8_t ** data) {
+  return(EUSART_RxSpan(EUSART1, data));
+}
+
+void EUSART1_RxConsume(uint16_t len) {
+  EUSART_RxConsume(EUSART1, len);
+}
@@ -3,9 +3,13 @@
  *
  *  Created on: Jul 10, 2023
  *      Author: eric
- * in events.h, add the following line:
+ * in events.h, add the following line (and EVENT_EUSART0/2_CHARACTER_RECEIVED for the other EUSARTs enabled below):
  * EVENT_EUSART1_CHARACTER_RECEIVED
  * Then in the event_handler in the command class/app add a switch for this event which will indicate data is in the RX FIFO.
+ * Only one event is queued at a time so drain the whole RX FIFO each time - the next event is queued once RxSpan or RxDepth has returned 0.
+ * For example:
+ *   case EVENT_EUSART1_CHARACTER_RECEIVED:
+ *     while ((len = EUSART1_RxSpan(&data))) { NMEA_feed(data, len); EUSART1_RxConsume(len); }
  */
 
 #ifndef UART_DRZ_H_
@@ -13,6 +17,7 @@
 
 #include <em_eusart.h>
 #include <em_gpio.h>
+#include <stdbool.h>
 
 void UART_Init( EUSART_TypeDef *uart,        // Pointer to one of the EUSARTs
     uint32_t baudrate,                  // 0=enable Autobaud, 1-1,000,000 bits/sec
@@ -24,10 +29,56 @@ void UART_Init( EUSART_TypeDef *uart,        // Pointer to one of the EUSARTs
     GPIO_Port_TypeDef RxPort,
     unsigned int RxPin);
 
+// Set to 1 for each EUSART that receives data - each one gets its own RxFIFO, interrupt handler and counters.
+// EUSART0 is normally used by DEBUGPRINT which installs its own interrupt handler so leave it at 0 in that case.
+#define EUSART0_RX_ENABLE 0
+#define EUSART1_RX_ENABLE 1
+#define EUSART2_RX_ENABLE 0
+
+typedef struct EUSART_RxStats   // receive error counters of one EUSART - they only count up
+{
+    uint32_t drops;     // bytes dropped because the RxFIFO was full - the application is not draining it fast enough
+    uint32_t overruns;  // the hardware FIFO (or the LDMA) overwrote data before it was read - interrupts were blocked too long
+    uint32_t framing;   // interrupts with a framing error - usually a wrong baud rate or noise on the line
+} EUSART_RxStats_t;
+
+int EUSART_RxDepth(EUSART_TypeDef *uart);                                 // number of bytes in the RxFIFO
+bool EUSART_GetChar(EUSART_TypeDef *uart, uint8_t * dat);                 // false if the RxFIFO is empty
+uint16_t EUSART_Read(EUSART_TypeDef *uart, uint8_t * dst, uint16_t len);  // copy up to len bytes out of the RxFIFO
+uint16_t EUSART_RxSpan(EUSART_TypeDef *uart, const uint8_t ** data);      // number of contiguous received bytes at *data - call again after RxConsume to get the rest
+void EUSART_RxConsume(EUSART_TypeDef *uart, uint16_t len);                // release len bytes returned by RxSpan
+void EUSART_GetRxStats(EUSART_TypeDef *uart, EUSART_RxStats_t * stats);   // copy of the error counters
+bool EUSART_PutChar(EUSART_TypeDef *uart, uint8_t dat);
+uint16_t EUSART_Write(EUSART_TypeDef *uart, const uint8_t * src, uint16_t len); // as many bytes as fit in the Tx FIFO - returns the number sent
+
+// EUSART1 versions of the above
 int EUSART1_RxDepth(void);
 uint8_t EUSART1_GetChar(void);
+uint16_t EUSART1_RxSpan(const uint8_t ** data);
+void EUSART1_RxConsume(uint16_t len);
+bool EUSART1_PutChar(uint8_t dat);
+uint16_t EUSART1_Write(const uint8_t * src, uint16_t len);
 
-// Rx FIFO depth in bytes - make it long enough to hold the longest expected message
+// Uncomment to receive EUSART1 with the LDMA into ping-pong buffers instead of an interrupt per FIFO level.
+// The CPU is only interrupted when a buffer fills or the RX line goes idle at the end of a burst of sentences.
+// Requires the DMADRV component (Platform->Driver->DMADRV) in the .slcp file.
+//#define EUSART1_RX_LDMA
+
+#ifdef EUSART1_RX_LDMA
+// Size of each of the 2 ping-pong buffers - together they form the RxFIFO
+#define RX_DMA_BUF_SIZE 64
+#define RX_FIFO_DEPTH (2*RX_DMA_BUF_SIZE)
+#else
+// Rx FIFO depth in bytes of each EUSART - make it long enough to hold the longest expected message, must be a power of 2
 #define RX_FIFO_DEPTH 32
+#endif
+
+// EVENT_EUSART1_CHARACTER_RECEIVED triggers - the event is queued when any of them happens and no event is already pending
+// Idle time after the last byte that ends a burst - see _EUSART_CFG1_RXTIMEOUT_xxx in em_eusart.h
+#define RX_IDLE_TIMEOUT EUSART_CFG1_RXTIMEOUT_SEVENFRAMES
+// 1 to queue the event at the end of each NMEA sentence - not used with EUSART1_RX_LDMA since the CPU does not see each byte
+#define RX_EVENT_ON_NEWLINE 1
+// Queue the event once this many bytes are waiting - a full half of the ping-pong buffer always queues it with EUSART1_RX_LDMA
+#define RX_EVENT_THRESHOLD (RX_FIFO_DEPTH*3/4)
 
 #endif /* UART_DRZ_H_ */
@@ -4,30 +4,12 @@
  * 
  * This code will extract the GPS NMEA Sentence from a SparkFun XA1110 GPS receiver board.
  * The XA1110 is easy to use since it has a QWIIC connector so it can be easily added to any Silabs Devkit with a QWIIC connector (DK2603)
- * The tricky part is that the XA1110 has to be polled every 900ms to pull the GPS data via I2C.
+ * The tricky part is that the XA1110 has to be polled to pull the GPS data via I2C. GPS_Scheduler.c times the polls to land just after each fix.
  * The data comes across in pieces which must then be reassembled into a single string.
  * Then the Geographic Location Command Class code can then extract the coordinates from the NMEA string and report them via Z-Wave.
  *
- * Setup to add support to the Z-Wave SwitchOnOff sample app GSDK 4.4.1
- * Add the following to the beginning of ApplicationTask after app_hw_init().
-m_AppTaskHandle = xTaskGetCurrentTaskHandle();
-AppTimerSetReceiverTask(m_AppTaskHandle);
-AppTimerRegister(&I2CTimer, false, ZCB_I2CTimerCallBack);
-TimerStart( &I2CTimer, XA1110_POLLING_INTERVAL);
-
- * add the following lines near the top of app.c 
-#include <AppTimer.h>            // GeoLocCC
-#include "xa1110.h"
-static SSwTimer I2CTimer;
-static TaskHandle_t m_AppTaskHandle;
-
-Add the following line to ApplicationInit just before the user task creation
-  AppTimerInit(EAPPLICATIONEVENT_TIMER,NULL); // XA1110 support
-
-add the following lines to the EVENT_APP_SWITCH_ON_OFF enum in events.h
-  EVENT_APP_I2CTIMER_TIMEOUT,
-  EVENT_APP_NMEA_READY,
-
+ * This is the GEOLOC_GPS_MTK_I2C backend of GPS_Driver.c - see GPS_Driver.c for the setup in app.c.
+ *
 If the XA1110 GPS module is connected and debugprint is enabled there should be NMEA sentences printed out the debug port.
 Note that it may take a minute or two for the GPS to lock onto satelites or move to a more open location.
 
@@ -37,27 +19,151 @@ $GNGGA,192925.000,4310.250847,N,07052.274013,W,1,14,0.72,42.543,M,-32.898,M,,*7C
  */
 
 
-#include <sl_i2cspm.h> // I2C stuff
-#include <sl_i2cspm_gps_config.h> // "gps" or whatever you named the I2C component
-#include <AppTimer.h>
-#include "xa1110.h"
-#include "events.h"
-#define DEBUGPRINT
-#ifdef DEBUGPRINT
+#include "CC_GeographicLoc.h"
+#if GEOLOC_GPS_BACKEND == GEOLOC_GPS_MTK_I2C
+#include "GPS_Driver.h"
+#include <string.h>
+// uncomment to enable debugging info
+//#define DEBUGPRINT
 #include <DebugPrint.h>
+
+/* @brief send a PMTK command to the XA1110 - body is the text between the $ and the *, the checksum and CR LF are added here
+ */
+static I2C_TransferReturn_TypeDef MTK_send(const char * body) {
+    static const char hex[] = "0123456789ABCDEF";
+    I2C_TransferSeq_TypeDef seq;
+    uint8_t frame[XA1110_CMD_MAX];
+    uint8_t sum=0;
+    uint8_t i=0;
+    frame[i++]='$';
+    while (('\0'!=*body) && (i<sizeof(frame)-5)) {
+        sum ^= (uint8_t)*body;
+        frame[i++]=(uint8_t)*body++;
+    }
+    frame[i++]='*';
+    frame[i++]=hex[sum>>4];
+    frame[i++]=hex[sum&0x0F];
+    frame[i++]='\r';
+    frame[i++]='\n';
+    seq.addr = XA1110_I2C_ADDR<<1;
+    seq.flags = I2C_FLAG_WRITE;
+    seq.buf[0].data = frame;
+    seq.buf[0].len = i;
+    seq.buf[1].data = frame;
+    seq.buf[1].len = 0;
+    return(GPS_I2CTransfer(&seq));
+}
+
+/* @brief set the fix rate of the XA1110 to GPS_FIX_RATE_HZ - not saved in the receiver so this is sent after every reset
+ */
+static I2C_TransferReturn_TypeDef MTK_configure(void) {
+#if GPS_FIX_RATE_HZ == 10
+    return(MTK_send("PMTK220,100"));
+#elif GPS_FIX_RATE_HZ == 5
+    return(MTK_send("PMTK220,200"));
+#else
+    return(MTK_send("PMTK220,1000"));
+#endif
+}
+
+#if defined(GEOLOC_HOT_START) && defined(GEOLOC_HOT_START_TIME_ACC_S) // PMTK741 needs the time now as well as the position
+// write v with at least digits digits at p - returns the end
+static char * MTK_int(char * p, uint32_t v, uint8_t digits) {
+    char tmp[10];
+    uint8_t n=0;
+    do {
+        tmp[n++] = '0' + v%10;
+        v /= 10;
+    } while ((v>0) || (n<digits));
+    while (n>0) *p++ = tmp[--n];
+    return(p);
+}
+
+// write 23 bit fixed point degrees as decimal degrees with 6 decimals at p - returns the end
+static char * MTK_deg(char * p, int32_t deg) {
+    uint32_t a = (deg<0) ? -(uint32_t)deg : (uint32_t)deg;
+    uint32_t frac = (uint32_t)((((uint64_t)(a & 0x7FFFFF))*1000000 + (1<<22))>>23);
+    uint32_t whole = a>>23;
+    if (frac>=1000000) {
+        whole++;
+        frac -= 1000000;
+    }
+    if (deg<0) *p++ = '-';
+    p = MTK_int(p, whole, 1);
+    *p++ = '.';
+    return(MTK_int(p, frac, 6));
+}
+
+/* @brief send the fix saved before the reset with PMTK741 so the XA1110 starts hot
+ * Nothing is sent before GPS_GetTime() is set - the time of the saved fix is not the time now.
+ */
+static I2C_TransferReturn_TypeDef MTK_aid(void) {
+    GPS_aid_t aid;
+    uint32_t utc, date;
+    char body[XA1110_CMD_MAX];
+    char * p = body;
+    if (!GPS_GetAiding(&aid) || !GPS_GetTime(&utc, &date) || (GPS_UTC_INVALID==utc) || (0==date)) return(i2cTransferDone);
+    memcpy(p, "PMTK741,", 8);
+    p += 8;
+    p = MTK_deg(p, aid.latitude);
+    *p++ = ',';
+    p = MTK_deg(p, aid.longitude);
+    *p++ = ',';
+    if (aid.altitude<0) *p++ = '-';
+    p = MTK_int(p, ((aid.altitude<0) ? -aid.altitude : aid.altitude)/100, 1); // meters
+    *p++ = ',';
+    p = MTK_int(p, 2000 + date%100, 4);
+    *p++ = ',';
+    p = MTK_int(p, (date/100)%100, 2);
+    *p++ = ',';
+    p = MTK_int(p, date/10000, 2);
+    *p++ = ',';
+    p = MTK_int(p, utc/3600000, 2);
+    *p++ = ',';
+    p = MTK_int(p, (utc/60000)%60, 2);
+    *p++ = ',';
+    p = MTK_int(p, (utc/1000)%60, 2);
+    *p = '\0';
+    return(MTK_send(body));
+}
+#endif
+
+bool GPS_BackendConfigure(void) {
+    return(i2cTransferDone==MTK_configure());
+}
+
+bool GPS_BackendAid(void) {
+#if defined(GEOLOC_HOT_START) && defined(GEOLOC_HOT_START_TIME_ACC_S)
+    return(i2cTransferDone==MTK_aid());
+#else
+    return(true);
 #endif
+}
 
-static uint8_t * NMEA_sentence; // Build the GPS NMEA sentence with the string needed - "$G.GGA..."
-static bool NMEA_valid = false;
+#ifdef GEOLOC_GPS_POWER
+bool GPS_BackendSleep(uint32_t ms) { // standby until the next command - the timer of GPS_Driver.c wakes it
+    return(i2cTransferDone==MTK_send("PMTK161,0"));
+}
 
-void NMEA_Init(uint8_t * ptr) { // Initialize the pointer to the NMEA buffer
-    NMEA_sentence=ptr;
+bool GPS_BackendWake(void) { // the PMTK220 wakes it and sets the rate again
+    return(i2cTransferDone==MTK_configure());
 }
-bool is_NMEA_Valid(void) { // Is the NEMA sentence in the buffer valid?
-    return(NMEA_valid);
+#endif
+
+/* @brief write the bytes to the XA1110 in one I2C write - assistance data goes straight to the input of the receiver
+ */
+uint16_t GPS_BackendWrite(const uint8_t * data, uint16_t len) {
+    I2C_TransferSeq_TypeDef seq;
+    seq.addr = XA1110_I2C_ADDR<<1;
+    seq.flags = I2C_FLAG_WRITE;
+    seq.buf[0].data = (uint8_t *)data;
+    seq.buf[0].len = len;
+    seq.buf[1].data = (uint8_t *)data;
+    seq.buf[1].len = 0;
+    return((i2cTransferDone==GPS_I2CTransfer(&seq)) ? len : 0);
 }
 
-I2C_TransferReturn_TypeDef Fetch_GPS(void) { // fetch the GPS NMEA sentence from the XA1110 GPS module over I2C and store it in the NMEA_sentence buffer
+bool GPS_BackendRead(void) { // fetch the GPS NMEA sentences from the XA1110 GPS module over I2C and feed them to the parser
     static I2C_TransferSeq_TypeDef i2c_dat;
     I2C_TransferReturn_TypeDef i2c_rtn;
     static uint8_t i2c_txBuf[I2C_BUF_SIZE];
@@ -65,9 +171,10 @@ I2C_TransferReturn_TypeDef Fetch_GPS(void) { // fetch the GPS NMEA sentence from
     int i2c_read=0; // index into the Rx buffer
     bool i2c_done;
     int blankcount=0;
+    uint32_t fixes = GetFixCount();
 
     // Setup the struct for I2CSPM to read data out of XA1110
-    i2c_dat.addr = 0x10<<1; // XA1110 I2C address=0x01 (7-bit)
+    i2c_dat.addr = XA1110_I2C_ADDR<<1; // XA1110 I2C address=0x10 (7-bit)
     i2c_dat.flags = I2C_FLAG_READ;
     i2c_dat.buf[0].data= &i2c_rxBuf[0];
     i2c_dat.buf[0].len= sizeof(i2c_rxBuf);
@@ -76,11 +183,11 @@ I2C_TransferReturn_TypeDef Fetch_GPS(void) { // fetch the GPS NMEA sentence from
     i2c_dat.buf[1].len= 0;
     i2c_done=false;
     while (!i2c_done) {
-        i2c_rtn=I2CSPM_Transfer(SL_I2CSPM_GPS_PERIPHERAL, &i2c_dat);
+        i2c_rtn=GPS_I2CTransfer(&i2c_dat);
         if (i2cTransferDone!=i2c_rtn) {
             if (i2cTransferNack==i2c_rtn) DPRINT("I2C NACK ");
             else DPRINTF("I2C ERR=%x\n\r",i2c_rtn);
-            return(i2c_rtn); // failed
+            return(false); // failed
         }
         for (i2c_read=0; (i2c_read<I2C_BUF_SIZE) && !i2c_done; i2c_read++) {
             if (0x0A==i2c_rxBuf[i2c_read]) {
@@ -92,24 +199,12 @@ I2C_TransferReturn_TypeDef Fetch_GPS(void) { // fetch the GPS NMEA sentence from
                 blankcount=0;
                 if (NMEA_build(i2c_rxBuf[i2c_read])) { // Add each character to the Sentence, once the desired sentence is found, return TRUE
                     NMEA_parse();   // parse the NMEA sentence and update coordinates
-                    i2c_done=true;
+                    i2c_done = (fixes!=GetFixCount()); // keep reading until the sentences of the epoch have made a fix
                 } 
             }
         }
     }
-    return(i2cTransferDone);
+    return(true);
 }
 
-// This callback fetches the GPS coordinates every XA1110_POLLING_INTERVAL milliseconds
-void ZCB_I2CTimerCallBack(SSwTimer *pTimer) {
-  static uint8_t FailCount;
-  zaf_event_distributor_enqueue_app_event(EVENT_APP_I2CTIMER_TIMEOUT); // TODO don't need this...
-//  DPRINT("\n+");
-  if (i2cTransferDone==Fetch_GPS()) {// fetch the GPS NMEA Sentence from the XA1110
-    // sometimes it fails to fetch the sentence in which case we just wait for the next interval
-      FailCount=0;
-  } else {
-      FailCount++;
-  }
-  if (FailCount<10) TimerRestart(pTimer); // If failed 10 times then the GPS is probably dead so give up
-}
+#endif // GEOLOC_GPS_MTK_I2C
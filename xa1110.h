@@ -7,10 +7,14 @@
 
 #define I2C_BUF_SIZE 32
 #define NMEA_BUF_SIZE 80
-// The polling interval should typically be under 1s to avoid overruns which would require even more error handling
-#define XA1110_POLLING_INTERVAL 933
+// Time of the first poll - after that GPS_Scheduler.c picks the time of each poll
+#define GPS_POLLING_INTERVAL 933
+// Any byte written wakes it from standby so a GET can wake it early
+#define GPS_WAKE_ANYTIME true
 
-I2C_TransferReturn_TypeDef Fetch_GPS(void);
-void ZCB_I2CTimerCallBack(SSwTimer *pTimer);
+// I2C address of the XA1110 (7-bit)
+#define XA1110_I2C_ADDR 0x10
+// Longest PMTK command sent including the $, checksum and CR LF - PMTK741
+#define XA1110_CMD_MAX 72
 
 #endif